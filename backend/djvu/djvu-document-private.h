@@ -40,6 +40,11 @@ struct _DjvuDocument {
 	ddjvu_fileinfo_t *fileinfo_pages;
 	gint		  n_pages;
 	GHashTable	 *file_ids;
+
+	/* Decoded pages and page texts, most recently used first */
+	GQueue            cache;
+	gsize             cache_size;
+	gsize             cache_budget;
 };
 
 int  djvu_document_get_n_pages (EvDocument   *document);
@@ -35,6 +35,7 @@
 #include <glib.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <glib/gi18n-lib.h>
+#include <errno.h>
 #include <string.h>
 
 enum {
@@ -145,6 +146,269 @@ djvu_wait_for_message (DjvuDocument *djvu_document, ddjvu_message_tag_t message,
 		ddjvu_message_pop (ctx);
 }
 
+/* Decoded pages and page texts are kept in a LRU cache, so that going
+ * back to a page, rendering it at another scale or for a thumbnail, or
+ * searching it again doesn't decode it again. The budget is in MiB and
+ * can be changed with the EV_DJVU_CACHE_SIZE environment variable.
+ */
+#define DJVU_CACHE_DEFAULT_BUDGET 64
+/* Pages are only cached when they take less than this part of it */
+#define DJVU_CACHE_MAX_PAGE_FRACTION 4
+
+typedef enum {
+	DJVU_CACHE_PAGE,
+	DJVU_CACHE_TEXT
+} DjvuCacheKind;
+
+typedef struct {
+	DjvuCacheKind kind;
+	gint          index;
+	gsize         size;
+
+	/* DJVU_CACHE_PAGE */
+	ddjvu_page_t *d_page;
+
+	/* DJVU_CACHE_TEXT, the text pages are indexed for searching,
+	 * case insensitive and case sensitive */
+	miniexp_t     page_text;
+	DjvuTextPage *text_pages[2];
+} DjvuCacheEntry;
+
+static void
+djvu_cache_entry_free (DjvuDocument   *djvu_document,
+		       DjvuCacheEntry *entry)
+{
+	switch (entry->kind) {
+	case DJVU_CACHE_PAGE:
+		ddjvu_page_release (entry->d_page);
+		break;
+	case DJVU_CACHE_TEXT:
+		g_clear_pointer (&entry->text_pages[0], djvu_text_page_free);
+		g_clear_pointer (&entry->text_pages[1], djvu_text_page_free);
+		if (entry->page_text != miniexp_nil)
+			ddjvu_miniexp_release (djvu_document->d_document, entry->page_text);
+		break;
+	}
+
+	djvu_document->cache_size -= entry->size;
+	g_free (entry);
+}
+
+static void
+djvu_document_clear_cache (DjvuDocument *djvu_document)
+{
+	DjvuCacheEntry *entry;
+
+	while ((entry = g_queue_pop_head (&djvu_document->cache)))
+		djvu_cache_entry_free (djvu_document, entry);
+}
+
+static gsize
+djvu_document_get_cache_budget (void)
+{
+	const gchar *env;
+	guint64      budget = DJVU_CACHE_DEFAULT_BUDGET;
+
+	env = g_getenv ("EV_DJVU_CACHE_SIZE");
+	if (env) {
+		gchar   *end = NULL;
+		guint64  value = 0;
+
+		/* g_ascii_strtoull() skips spaces and takes signs */
+		if (g_ascii_isdigit (env[0])) {
+			errno = 0;
+			value = g_ascii_strtoull (env, &end, 10);
+			if (errno != 0 || *end != '\0')
+				value = 0;
+		}
+
+		if (value > 0)
+			budget = value;
+		else
+			g_warning ("Invalid EV_DJVU_CACHE_SIZE “%s”, it must be a positive size in MiB", env);
+	}
+
+	return MIN (budget, G_MAXSIZE >> 20) << 20;
+}
+
+/* Drops the least recently used entries until the cache fits in the
+ * budget, always keeping the most recent one */
+static void
+djvu_document_trim_cache (DjvuDocument *djvu_document)
+{
+	while (djvu_document->cache_size > djvu_document->cache_budget &&
+	       djvu_document->cache.length > 1)
+		djvu_cache_entry_free (djvu_document, g_queue_pop_tail (&djvu_document->cache));
+}
+
+static DjvuCacheEntry *
+djvu_document_lookup_cache (DjvuDocument *djvu_document,
+			    DjvuCacheKind kind,
+			    gint          index)
+{
+	GList *l;
+
+	for (l = djvu_document->cache.head; l; l = l->next) {
+		DjvuCacheEntry *entry = l->data;
+
+		if (entry->kind != kind || entry->index != index)
+			continue;
+
+		g_queue_unlink (&djvu_document->cache, l);
+		g_queue_push_head_link (&djvu_document->cache, l);
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+static void
+djvu_document_add_to_cache (DjvuDocument   *djvu_document,
+			    DjvuCacheEntry *entry)
+{
+	g_queue_push_head (&djvu_document->cache, entry);
+	djvu_document->cache_size += entry->size;
+	djvu_document_trim_cache (djvu_document);
+}
+
+/* A rough estimate of the memory used by djvulibre for a decoded page:
+ * a bit per pixel for the bitonal mask, and the wavelet coefficients of
+ * the (usually subsampled) background for the other page types */
+static gsize
+djvu_page_estimate_size (ddjvu_page_t *d_page)
+{
+	gsize n_pixels;
+
+	n_pixels = (gsize) ddjvu_page_get_width (d_page) * ddjvu_page_get_height (d_page);
+
+	if (ddjvu_page_get_type (d_page) == DDJVU_PAGETYPE_BITONAL)
+		return n_pixels / 8;
+
+	return n_pixels * 2;
+}
+
+/* Blocks until the decoding thread of djvulibre is done with @d_page.
+ * ddjvu_message_wait() sleeps until that thread posts a message, the
+ * messages about other pages are handled on the way. */
+static void
+djvu_document_wait_for_page (DjvuDocument *djvu_document,
+			     ddjvu_page_t *d_page)
+{
+	while (ddjvu_page_decoding_status (d_page) < DDJVU_JOB_OK)
+		djvu_handle_events (djvu_document, TRUE, NULL);
+}
+
+/* Returns the decoded page @index. It's owned by the cache when @cached
+ * is set to %TRUE, otherwise the caller must release it: pages taking
+ * more than a fraction of the budget would evict all the others, so
+ * they are not cached. */
+static ddjvu_page_t *
+djvu_document_get_decoded_page (DjvuDocument *djvu_document,
+				gint          index,
+				gboolean     *cached)
+{
+	DjvuCacheEntry *entry;
+	ddjvu_page_t   *d_page;
+	gsize           size;
+
+	entry = djvu_document_lookup_cache (djvu_document, DJVU_CACHE_PAGE, index);
+	if (entry) {
+		*cached = TRUE;
+		return entry->d_page;
+	}
+
+	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, index);
+
+	/* A page that failed to decode is kept too, decoding
+	 * it again would fail the same way */
+	djvu_document_wait_for_page (djvu_document, d_page);
+
+	size = djvu_page_estimate_size (d_page);
+	if (size > djvu_document->cache_budget / DJVU_CACHE_MAX_PAGE_FRACTION) {
+		*cached = FALSE;
+		return d_page;
+	}
+
+	entry = g_new0 (DjvuCacheEntry, 1);
+	entry->kind = DJVU_CACHE_PAGE;
+	entry->index = index;
+	entry->d_page = d_page;
+	entry->size = size;
+	djvu_document_add_to_cache (djvu_document, entry);
+
+	*cached = TRUE;
+	return d_page;
+}
+
+static DjvuCacheEntry *
+djvu_document_get_text_entry (DjvuDocument *djvu_document,
+			      gint          index)
+{
+	DjvuCacheEntry *entry;
+	miniexp_t       page_text;
+
+	entry = djvu_document_lookup_cache (djvu_document, DJVU_CACHE_TEXT, index);
+	if (entry)
+		return entry;
+
+	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
+							 index, "char")) == miniexp_dummy)
+		djvu_handle_events (djvu_document, TRUE, NULL);
+
+	entry = g_new0 (DjvuCacheEntry, 1);
+	entry->kind = DJVU_CACHE_TEXT;
+	entry->index = index;
+	entry->page_text = page_text;
+	/* Updated once the text is indexed */
+	entry->size = sizeof (DjvuCacheEntry);
+	djvu_document_add_to_cache (djvu_document, entry);
+
+	return entry;
+}
+
+/* Returns the text of page @index, owned by the cache, or miniexp_nil */
+static miniexp_t
+djvu_document_get_page_text (DjvuDocument *djvu_document,
+			     gint          index)
+{
+	return djvu_document_get_text_entry (djvu_document, index)->page_text;
+}
+
+/* Returns the text page @index indexed for searching, owned by the
+ * cache, or %NULL when the page has no text */
+static DjvuTextPage *
+djvu_document_get_text_page (DjvuDocument *djvu_document,
+			     gint          index,
+			     gboolean      case_sensitive)
+{
+	DjvuCacheEntry *entry;
+	DjvuTextPage   *tpage;
+	gsize           size;
+
+	entry = djvu_document_get_text_entry (djvu_document, index);
+	if (entry->page_text == miniexp_nil)
+		return NULL;
+
+	tpage = entry->text_pages[case_sensitive ? 1 : 0];
+	if (tpage)
+		return tpage;
+
+	tpage = djvu_text_page_new (entry->page_text);
+	djvu_text_page_index_text (tpage, case_sensitive);
+	entry->text_pages[case_sensitive ? 1 : 0] = tpage;
+
+	/* Every link points to a node of the text structure, which is
+	 * what takes most of the memory */
+	size = (tpage->text ? strlen (tpage->text) : 0) +
+		tpage->links->len * (sizeof (DjvuTextLink) + 128);
+	entry->size += size;
+	djvu_document->cache_size += size;
+	djvu_document_trim_cache (djvu_document);
+
+	return tpage;
+}
+
 static gboolean
 djvu_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -180,6 +444,7 @@ djvu_document_load (EvDocument  *document,
 		return FALSE;
 	}
 
+	djvu_document_clear_cache (djvu_document);
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
@@ -331,11 +596,13 @@ djvu_document_get_page_size (EvDocument   *document,
 				width, height, NULL);
 }
 
+/* Renders @area of the page scaled and rotated as requested by @rc, or
+ * the whole page when @area is %NULL */
 static cairo_surface_t *
-djvu_document_render (EvDocument      *document,
-		      EvRenderContext *rc)
+djvu_document_render_area (DjvuDocument                *djvu_document,
+			   EvRenderContext             *rc,
+			   const cairo_rectangle_int_t *area)
 {
-	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
 	cairo_surface_t *surface;
 	gchar *pixels;
 	gint   rowstride;
@@ -346,11 +613,9 @@ djvu_document_render (EvDocument      *document,
 	gint buffer_modified;
 	double page_width, page_height;
 	gint transformed_width, transformed_height;
+	gboolean cached;
 
-	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, rc->page->index);
-
-	while (!ddjvu_page_decoding_done (d_page))
-		djvu_handle_events(djvu_document, TRUE, NULL);
+	d_page = djvu_document_get_decoded_page (djvu_document, rc->page->index, &cached);
 
 	document_get_page_size (djvu_document, rc->page->index, &page_width, &page_height, NULL);
 	rotation = ddjvu_page_get_initial_rotation (d_page);
@@ -380,18 +645,27 @@ djvu_document_render (EvDocument      *document,
 	}
 	rotation = rotation % 4;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-					      transformed_width, transformed_height);
-
-	rowstride = cairo_image_surface_get_stride (surface);
-	pixels = (gchar *)cairo_image_surface_get_data (surface);
-
 	prect.x = 0;
 	prect.y = 0;
 	prect.w = transformed_width;
 	prect.h = transformed_height;
 	rrect = prect;
 
+	/* djvulibre only scales and converts the part of the page
+	 * inside rrect, the rest of the page isn't touched */
+	if (area) {
+		rrect.x = CLAMP (area->x, 0, transformed_width - 1);
+		rrect.y = CLAMP (area->y, 0, transformed_height - 1);
+		rrect.w = CLAMP (area->width, 1, transformed_width - (gint) rrect.x);
+		rrect.h = CLAMP (area->height, 1, transformed_height - (gint) rrect.y);
+	}
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					      rrect.w, rrect.h);
+
+	rowstride = cairo_image_surface_get_stride (surface);
+	pixels = (gchar *)cairo_image_surface_get_data (surface);
+
 	ddjvu_page_set_rotation (d_page, rotation);
 
 	buffer_modified = ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
@@ -411,9 +685,27 @@ djvu_document_render (EvDocument      *document,
 		cairo_surface_mark_dirty (surface);
 	}
 
+	if (!cached)
+		ddjvu_page_release (d_page);
+
 	return surface;
 }
 
+static cairo_surface_t *
+djvu_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	return djvu_document_render_area (DJVU_DOCUMENT (document), rc, NULL);
+}
+
+static cairo_surface_t *
+djvu_document_render_region (EvDocument                  *document,
+			     EvRenderContext             *rc,
+			     const cairo_rectangle_int_t *area)
+{
+	return djvu_document_render_area (DJVU_DOCUMENT (document), rc, area);
+}
+
 static char *
 djvu_document_get_page_label (EvDocument *document,
                               EvPage     *page)
@@ -552,6 +844,7 @@ djvu_document_finalize (GObject *object)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (object);
 
+	djvu_document_clear_cache (djvu_document);
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
@@ -589,6 +882,7 @@ djvu_document_class_init (DjvuDocumentClass *klass)
 	ev_document_class->get_page_label = djvu_document_get_page_label;
 	ev_document_class->get_page_size = djvu_document_get_page_size;
 	ev_document_class->render = djvu_document_render;
+	ev_document_class->render_region = djvu_document_render_region;
 	ev_document_class->get_thumbnail = djvu_document_get_thumbnail;
 	ev_document_class->get_thumbnail_surface = djvu_document_get_thumbnail_surface;
 	ev_document_class->get_info = djvu_document_get_info;
@@ -602,17 +896,12 @@ djvu_text_copy (DjvuDocument *djvu_document,
 	miniexp_t page_text;
 	gchar    *text = NULL;
 
-	while ((page_text =
-		ddjvu_document_get_pagetext (djvu_document->d_document,
-					     page_num, "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
+	page_text = djvu_document_get_page_text (djvu_document, page_num);
 	if (page_text != miniexp_nil) {
 		DjvuTextPage *page = djvu_text_page_new (page_text);
 
 		text = djvu_text_page_copy (page, rectangle);
 		djvu_text_page_free (page);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
 	}
 
 	return text;
@@ -643,16 +932,12 @@ djvu_selection_get_selection_rects (DjvuDocument    *djvu_document,
 
 	djvu_convert_to_doc_rect (&rectangle, points, height, dpi);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page, "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
+	page_text = djvu_document_get_page_text (djvu_document, page);
 	if (page_text != miniexp_nil) {
 		DjvuTextPage *tpage = djvu_text_page_new (page_text);
 
 		rects = djvu_text_page_get_selection_region (tpage, &rectangle);
 		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
 	}
 
 	return rects;
@@ -763,24 +1048,11 @@ djvu_document_text_get_text (EvDocumentText  *selection,
                              EvPage          *page)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (selection);
-	miniexp_t     page_text;
-	gchar        *text = NULL;
+	DjvuTextPage *tpage;
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
+	tpage = djvu_document_get_text_page (djvu_document, page->index, TRUE);
 
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-
-		djvu_text_page_index_text (tpage, TRUE);
-		text = tpage->text;
-		tpage->text = NULL;
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
-	}
-	return text;
+	return tpage ? g_strdup (tpage->text) : NULL;
 }
 
 static void
@@ -873,6 +1145,8 @@ djvu_document_init (DjvuDocument *djvu_document)
 	djvu_document->opts = g_string_new ("");
 
 	djvu_document->d_document = NULL;
+	g_queue_init (&djvu_document->cache);
+	djvu_document->cache_budget = djvu_document_get_cache_budget ();
 }
 
 static GList *
@@ -882,34 +1156,25 @@ djvu_document_find_find_text (EvDocumentFind   *document,
 			      gboolean          case_sensitive)
 {
         DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
-	miniexp_t page_text;
+	DjvuTextPage *tpage;
 	gdouble width, height, dpi;
 	GList *matches = NULL, *l;
 	char *search_text = NULL;
 
 	g_return_val_if_fail (text != NULL, NULL);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-
-		djvu_text_page_index_text (tpage, case_sensitive);
-		if (tpage->links->len > 0) {
-			if (!case_sensitive) {
-				search_text = g_utf8_casefold (text, -1);
-				djvu_text_page_search (tpage, search_text);
-				g_free (search_text);
-			} else {
-				djvu_text_page_search (tpage, text);
-			}
-			matches = tpage->results;
+	tpage = djvu_document_get_text_page (djvu_document, page->index, case_sensitive);
+	if (tpage && tpage->links->len > 0) {
+		if (!case_sensitive) {
+			search_text = g_utf8_casefold (text, -1);
+			djvu_text_page_search (tpage, search_text);
+			g_free (search_text);
+		} else {
+			djvu_text_page_search (tpage, text);
 		}
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
+		/* The results belong to the caller */
+		matches = tpage->results;
+		tpage->results = NULL;
 	}
 	if (!matches)
 		return NULL;
@@ -937,7 +1202,7 @@ djvu_document_find_find_text_extended (EvDocumentFind *document,
 				       EvFindOptions options)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
-	miniexp_t page_text;
+	DjvuTextPage *tpage;
 	gdouble width, height, dpi;
 	GList *matches = NULL, *l;
 	char *search_text = NULL;
@@ -945,27 +1210,18 @@ djvu_document_find_find_text_extended (EvDocumentFind *document,
 
 	g_return_val_if_fail (text != NULL, NULL);
 
-	while ((page_text = ddjvu_document_get_pagetext (djvu_document->d_document,
-							 page->index,
-							 "char")) == miniexp_dummy)
-		djvu_handle_events (djvu_document, TRUE, NULL);
-
-	if (page_text != miniexp_nil) {
-		DjvuTextPage *tpage = djvu_text_page_new (page_text);
-
-		djvu_text_page_index_text (tpage, case_sensitive);
-		if (tpage->links->len > 0) {
-			if (!case_sensitive) {
-				search_text = g_utf8_casefold (text, -1);
-				djvu_text_page_search (tpage, search_text);
-				g_free (search_text);
-			} else {
-				djvu_text_page_search (tpage, text);
-			}
-			matches = tpage->results;
+	tpage = djvu_document_get_text_page (djvu_document, page->index, case_sensitive);
+	if (tpage && tpage->links->len > 0) {
+		if (!case_sensitive) {
+			search_text = g_utf8_casefold (text, -1);
+			djvu_text_page_search (tpage, search_text);
+			g_free (search_text);
+		} else {
+			djvu_text_page_search (tpage, text);
 		}
-		djvu_text_page_free (tpage);
-		ddjvu_miniexp_release (djvu_document->d_document, page_text);
+		/* The results belong to the caller */
+		matches = tpage->results;
+		tpage->results = NULL;
 	}
 	if (!matches)
 		return NULL;
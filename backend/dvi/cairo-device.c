@@ -32,6 +32,10 @@ typedef struct {
 	gint xmargin;
 	gint ymargin;
 
+	/* Size of the page being rendered, in pixels */
+	gint width;
+	gint height;
+
 	gdouble xscale;
 	gdouble yscale;
 
@@ -50,7 +54,6 @@ dvi_cairo_draw_glyph (DviContext  *dvi,
 	int              x, y, w, h;
 	gboolean         isbox;
 	DviGlyph        *glyph;
-	cairo_surface_t *surface;
 
 	cairo_device = (DviCairoDevice *) dvi->device.device_data;
 
@@ -65,10 +68,9 @@ dvi_cairo_draw_glyph (DviContext  *dvi,
 	w = glyph->w;
 	h = glyph->h;
 
-	surface = cairo_get_target (cairo_device->cr);
 	if (x < 0 || y < 0
-	    || x + w > cairo_image_surface_get_width (surface)
-	    || y + h > cairo_image_surface_get_height (surface))
+	    || x + w > cairo_device->width
+	    || y + h > cairo_device->height)
 		return;
 
 	cairo_save (cairo_device->cr);
@@ -234,7 +236,14 @@ dvi_cairo_create_image (void *device_data,
 			Uint  height,
 			Uint  bpp)
 {
-	return cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	cairo_surface_t *surface;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	/* per cairo docs, must flush before modifying outside of cairo,
+	 * mdvi writes the pixels and then calls image_done */
+	cairo_surface_flush (surface);
+
+	return surface;
 }
 
 static void
@@ -255,11 +264,27 @@ dvi_cairo_put_pixel (void *image, int x, int y, Ulong color)
 	rowstride = cairo_image_surface_get_stride (surface);
 	p = (guint32*) (cairo_image_surface_get_data (surface) + y * rowstride + x * 4);
 
-        /* per cairo docs, must flush before modifying outside of cairo */
-        cairo_surface_flush(surface);
 	*p = color;
 }
 
+static void
+dvi_cairo_put_row (void        *image,
+		   int          y,
+		   const Ulong *colors,
+		   int          npixels)
+{
+	cairo_surface_t *surface;
+	guint32         *p;
+	gint             i;
+
+	surface = (cairo_surface_t *) image;
+
+	p = (guint32 *) (cairo_image_surface_get_data (surface) +
+			 y * cairo_image_surface_get_stride (surface));
+	for (i = 0; i < npixels; i++)
+		p[i] = colors[i];
+}
+
 static void
 dvi_cairo_image_done (void *ptr)
 {
@@ -287,6 +312,7 @@ mdvi_cairo_device_init (DviDevice *device)
 	device->create_image = dvi_cairo_create_image;
 	device->free_image = dvi_cairo_free_image;
 	device->put_pixel = dvi_cairo_put_pixel;
+	device->put_row = dvi_cairo_put_row;
         device->image_done = dvi_cairo_image_done;
 	device->set_color = dvi_cairo_set_color;
 #ifdef HAVE_SPECTRE
@@ -341,6 +367,8 @@ mdvi_cairo_device_render (DviContext* dvi)
 
 	cairo_device->cr = cairo_create (surface);
         cairo_surface_destroy (surface);
+	cairo_device->width = page_width;
+	cairo_device->height = page_height;
 
         cairo_set_source_rgb (cairo_device->cr, 1., 1., 1.);
         cairo_paint (cairo_device->cr);
@@ -348,6 +376,34 @@ mdvi_cairo_device_render (DviContext* dvi)
 	mdvi_dopage (dvi, dvi->currpage);
 }
 
+/* Draws the current page on @cr, one unit per pixel, without margins
+ * nor background. Used to export pages to vector surfaces. */
+void
+mdvi_cairo_device_render_to (DviContext *dvi,
+			     cairo_t    *cr)
+{
+	DviCairoDevice *cairo_device;
+
+	cairo_device = (DviCairoDevice *) dvi->device.device_data;
+
+	if (cairo_device->cr)
+		cairo_destroy (cairo_device->cr);
+
+	cairo_device->cr = cairo_reference (cr);
+	cairo_device->xmargin = 0;
+	cairo_device->ymargin = 0;
+	cairo_device->xscale = 1.;
+	cairo_device->yscale = 1.;
+	cairo_device->width = dvi->dvi_page_w * dvi->params.conv;
+	cairo_device->height = dvi->dvi_page_h * dvi->params.vconv;
+
+	mdvi_dopage (dvi, dvi->currpage);
+
+	/* Don't keep the target alive, the caller finishes it */
+	cairo_destroy (cairo_device->cr);
+	cairo_device->cr = NULL;
+}
+
 void
 mdvi_cairo_device_set_margins (DviDevice *device,
 			       gint       xmargin,
@@ -39,8 +39,19 @@
 # include <sys/wait.h>
 #endif
 #include <stdlib.h>
+#ifdef CAIRO_HAS_PDF_SURFACE
+#include <cairo-pdf.h>
+#endif
+#ifdef CAIRO_HAS_PS_SURFACE
+#include <cairo-ps.h>
+#endif
+
+/* Resolution of the glyph images in documents exported without the
+ * external tools */
+#define DVI_EXPORT_DPI 300
 
-static GMutex dvi_context_mutex;
+/* Protects the fonts and glyphs that mdvi shares between contexts */
+static GRecMutex dvi_font_mutex;
 
 enum {
 	PROP_0,
@@ -58,6 +69,13 @@ struct _DviDocument
 
 	DviContext *context;
 	DviPageSpec *spec;
+
+	/* Idle contexts on the same file, so that pages can be
+	 * rendered independently. The main context is one of them.
+	 */
+	GMutex render_contexts_lock;
+	GQueue render_contexts;
+
 	DviParams *params;
 
 	/* To let document scale we should remember width and height */
@@ -66,14 +84,21 @@ struct _DviDocument
 
 	gchar *uri;
 
-	/* PDF exporter */
-	gchar		 *exporter_filename;
-	GString 	 *exporter_opts;
+	/* PDF/PS exporter, running dvipdfm or dvips when installed */
+	EvFileExporterFormat exporter_format;
+	gchar            *exporter_tool;
+	gchar            *exporter_filename;
+	GString          *exporter_pages;
+	cairo_t          *exporter_cr;
+	DviContext       *exporter_context;
+	gdouble           exporter_paper_width;
+	gdouble           exporter_paper_height;
 };
 
 typedef struct _DviDocumentClass DviDocumentClass;
 
 static void dvi_document_file_exporter_iface_init (EvFileExporterInterface       *iface);
+static void dvi_document_exporter_clear           (DviDocument                   *dvi_document);
 static void dvi_document_do_color_special         (DviContext                    *dvi,
 						   const char                    *prefix,
 						   const char                    *arg);
@@ -83,6 +108,77 @@ EV_BACKEND_REGISTER_WITH_CODE (DviDocument, dvi_document,
       EV_BACKEND_IMPLEMENT_INTERFACE (EV_TYPE_FILE_EXPORTER, dvi_document_file_exporter_iface_init);
      });
 
+static void
+dvi_document_font_lock (void)
+{
+	g_rec_mutex_lock (&dvi_font_mutex);
+}
+
+static void
+dvi_document_font_unlock (void)
+{
+	g_rec_mutex_unlock (&dvi_font_mutex);
+}
+
+static void
+dvi_document_destroy_context (DviContext *context)
+{
+	mdvi_cairo_device_free (&context->device);
+	mdvi_destroy_context (context);
+}
+
+static void
+dvi_document_clear_render_contexts (DviDocument *dvi_document)
+{
+	DviContext *context;
+
+	while ((context = g_queue_pop_head (&dvi_document->render_contexts))) {
+		if (context != dvi_document->context)
+			dvi_document_destroy_context (context);
+	}
+}
+
+/* Returns a context that no other render is using, opening the
+ * file again when all of them are busy. Contexts only share fonts.
+ */
+static DviContext *
+dvi_document_acquire_render_context (DviDocument *dvi_document)
+{
+	DviContext *context;
+
+	g_mutex_lock (&dvi_document->render_contexts_lock);
+	context = g_queue_pop_head (&dvi_document->render_contexts);
+	g_mutex_unlock (&dvi_document->render_contexts_lock);
+
+	if (context)
+		return context;
+
+	context = mdvi_init_context (dvi_document->params, dvi_document->spec,
+				     dvi_document->context->filename);
+	if (!context)
+		return NULL;
+
+	mdvi_cairo_device_init (&context->device);
+
+	return context;
+}
+
+static void
+dvi_document_release_render_context (DviDocument *dvi_document,
+				     DviContext  *context)
+{
+	g_mutex_lock (&dvi_document->render_contexts_lock);
+	if (context == dvi_document->context ||
+	    g_queue_get_length (&dvi_document->render_contexts) < g_get_num_processors ()) {
+		g_queue_push_head (&dvi_document->render_contexts, context);
+		context = NULL;
+	}
+	g_mutex_unlock (&dvi_document->render_contexts_lock);
+
+	if (context)
+		dvi_document_destroy_context (context);
+}
+
 static gboolean
 dvi_document_load (EvDocument  *document,
 		   const char  *uri,
@@ -95,12 +191,11 @@ dvi_document_load (EvDocument  *document,
 	if (!filename)
         	return FALSE;
 
-	g_mutex_lock (&dvi_context_mutex);
+	dvi_document_clear_render_contexts (dvi_document);
 	if (dvi_document->context)
-		mdvi_destroy_context (dvi_document->context);
+		dvi_document_destroy_context (dvi_document->context);
 
 	dvi_document->context = mdvi_init_context(dvi_document->params, dvi_document->spec, filename);
-	g_mutex_unlock (&dvi_context_mutex);
 	g_free (filename);
 
 	if (!dvi_document->context) {
@@ -112,7 +207,7 @@ dvi_document_load (EvDocument  *document,
 	}
 
 	mdvi_cairo_device_init (&dvi_document->context->device);
-
+	g_queue_push_head (&dvi_document->render_contexts, dvi_document->context);
 
 	dvi_document->base_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv
 		+ 2 * unit2pix(dvi_document->params->dpi, MDVI_HMARGIN) / dvi_document->params->hshrink;
@@ -164,41 +259,43 @@ dvi_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
 	DviDocument *dvi_document = DVI_DOCUMENT(document);
+	DviContext *context;
 	gdouble xscale, yscale;
 	gint required_width, required_height;
 	gint proposed_width, proposed_height;
 	gint xmargin = 0, ymargin = 0;
 
-	/* We should protect our context since it's not
-	 * thread safe. The work to the future -
-	 * let context render page independently
+	/* Page state lives in the context, so every render
+	 * uses its own; only the fonts are shared.
 	 */
-	g_mutex_lock (&dvi_context_mutex);
+	context = dvi_document_acquire_render_context (dvi_document);
+	if (!context)
+		return NULL;
 
-	mdvi_setpage (dvi_document->context, rc->page->index);
+	mdvi_setpage (context, rc->page->index);
 
 	ev_render_context_compute_scales (rc, dvi_document->base_width, dvi_document->base_height,
 					  &xscale, &yscale);
-	mdvi_set_shrink (dvi_document->context,
+	mdvi_set_shrink (context,
 			 (int)((dvi_document->params->hshrink - 1) / xscale) + 1,
 			 (int)((dvi_document->params->vshrink - 1) / yscale) + 1);
 
 	ev_render_context_compute_scaled_size (rc, dvi_document->base_width, dvi_document->base_height,
 					       &required_width, &required_height);
-	proposed_width = dvi_document->context->dvi_page_w * dvi_document->context->params.conv;
-	proposed_height = dvi_document->context->dvi_page_h * dvi_document->context->params.vconv;
+	proposed_width = context->dvi_page_w * context->params.conv;
+	proposed_height = context->dvi_page_h * context->params.vconv;
 
 	if (required_width >= proposed_width)
 	    xmargin = (required_width - proposed_width) / 2;
 	if (required_height >= proposed_height)
 	    ymargin = (required_height - proposed_height) / 2;
 
-	mdvi_cairo_device_set_margins (&dvi_document->context->device, xmargin, ymargin);
-	mdvi_cairo_device_set_scale (&dvi_document->context->device, xscale, yscale);
-	mdvi_cairo_device_render (dvi_document->context);
-	surface = mdvi_cairo_device_get_surface (&dvi_document->context->device);
+	mdvi_cairo_device_set_margins (&context->device, xmargin, ymargin);
+	mdvi_cairo_device_set_scale (&context->device, xscale, yscale);
+	mdvi_cairo_device_render (context);
+	surface = mdvi_cairo_device_get_surface (&context->device);
 
-	g_mutex_unlock (&dvi_context_mutex);
+	dvi_document_release_render_context (dvi_document, context);
 
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     required_width,
@@ -214,22 +311,15 @@ dvi_document_finalize (GObject *object)
 {
 	DviDocument *dvi_document = DVI_DOCUMENT(object);
 
-	g_mutex_lock (&dvi_context_mutex);
-	if (dvi_document->context) {
-		mdvi_cairo_device_free (&dvi_document->context->device);
-		mdvi_destroy_context (dvi_document->context);
-	}
-	g_mutex_unlock (&dvi_context_mutex);
+	dvi_document_exporter_clear (dvi_document);
+	dvi_document_clear_render_contexts (dvi_document);
+	if (dvi_document->context)
+		dvi_document_destroy_context (dvi_document->context);
+	g_mutex_clear (&dvi_document->render_contexts_lock);
 
 	if (dvi_document->params)
 		g_free (dvi_document->params);
 
-	if (dvi_document->exporter_filename)
-		g_free (dvi_document->exporter_filename);
-
-	if (dvi_document->exporter_opts)
-		g_string_free (dvi_document->exporter_opts, TRUE);
-
         g_free (dvi_document->uri);
 
 	G_OBJECT_CLASS (dvi_document_parent_class)->finalize (object);
@@ -256,6 +346,7 @@ dvi_document_class_init (DviDocumentClass *klass)
 
 	mdvi_register_special ("Color", "color", NULL, dvi_document_do_color_special, 1);
 	mdvi_register_fonts ();
+	mdvi_set_font_lock (dvi_document_font_lock, dvi_document_font_unlock);
 
 	ev_document_class->load = dvi_document_load;
 	ev_document_class->save = dvi_document_save;
@@ -271,61 +362,191 @@ dvi_document_file_exporter_begin (EvFileExporter        *exporter,
 				  EvFileExporterContext *fc)
 {
 	DviDocument *dvi_document = DVI_DOCUMENT(exporter);
+	cairo_surface_t *surface = NULL;
+	DviContext *context;
+
+	dvi_document_exporter_clear (dvi_document);
+
+	/* The external tools embed the fonts as vectors, and they are
+	 * what the document was written for. Without them, pages are
+	 * drawn with glyph images, which is all mdvi gives us.
+	 */
+	dvi_document->exporter_tool =
+		g_find_program_in_path (fc->format == EV_FILE_FORMAT_PS ? "dvips" : "dvipdfm");
+	if (dvi_document->exporter_tool) {
+		dvi_document->exporter_format = fc->format;
+		dvi_document->exporter_filename = g_strdup (fc->filename);
+		dvi_document->exporter_pages = g_string_new (NULL);
+		return;
+	}
+
+	switch (fc->format) {
+	case EV_FILE_FORMAT_PS:
+#ifdef CAIRO_HAS_PS_SURFACE
+		surface = cairo_ps_surface_create (fc->filename, fc->paper_width, fc->paper_height);
+#endif
+		break;
+	case EV_FILE_FORMAT_PDF:
+#ifdef CAIRO_HAS_PDF_SURFACE
+		surface = cairo_pdf_surface_create (fc->filename, fc->paper_width, fc->paper_height);
+#endif
+		break;
+	default:
+		g_assert_not_reached ();
+	}
 
-	if (dvi_document->exporter_filename)
-		g_free (dvi_document->exporter_filename);
-	dvi_document->exporter_filename = g_strdup (fc->filename);
+	if (!surface)
+		return;
 
-	if (dvi_document->exporter_opts) {
-		g_string_free (dvi_document->exporter_opts, TRUE);
+	/* Pages are replayed in a context of their own, shrunk
+	 * to get the glyph images at the export resolution.
+	 */
+	context = dvi_document_acquire_render_context (dvi_document);
+	if (!context) {
+		cairo_surface_destroy (surface);
+		return;
 	}
-	dvi_document->exporter_opts = g_string_new ("-s ");
+
+	mdvi_set_shrink (context,
+			 MAX (2, dvi_document->params->dpi / DVI_EXPORT_DPI),
+			 MAX (2, dvi_document->params->vdpi / DVI_EXPORT_DPI));
+
+	dvi_document->exporter_cr = cairo_create (surface);
+	cairo_surface_destroy (surface);
+	dvi_document->exporter_context = context;
+	dvi_document->exporter_paper_width = fc->paper_width;
+	dvi_document->exporter_paper_height = fc->paper_height;
 }
 
 static void
 dvi_document_file_exporter_do_page (EvFileExporter  *exporter,
 				    EvRenderContext *rc)
 {
-       DviDocument *dvi_document = DVI_DOCUMENT(exporter);
+	DviDocument *dvi_document = DVI_DOCUMENT(exporter);
+	DviContext *context = dvi_document->exporter_context;
+	cairo_t *cr = dvi_document->exporter_cr;
+	gdouble xunit, yunit;
+	gdouble width, height;
+	gdouble scale;
+
+	if (dvi_document->exporter_pages) {
+		if (dvi_document->exporter_pages->len > 0)
+			g_string_append_c (dvi_document->exporter_pages, ',');
+		g_string_append_printf (dvi_document->exporter_pages, "%d", rc->page->index + 1);
+		return;
+	}
 
-       g_string_append_printf (dvi_document->exporter_opts, "%d,", (rc->page->index) + 1);
+	if (!cr)
+		return;
+
+	mdvi_setpage (context, rc->page->index);
+
+	/* Size of a shrunk pixel in points */
+	xunit = 72.0 * context->params.hshrink / context->params.dpi;
+	yunit = 72.0 * context->params.vshrink / context->params.vdpi;
+	width = context->dvi_page_w * context->params.conv * xunit;
+	height = context->dvi_page_h * context->params.vconv * yunit;
+
+	/* Center the page on the paper, shrinking it when it doesn't fit */
+	scale = MIN (dvi_document->exporter_paper_width / width,
+		     dvi_document->exporter_paper_height / height);
+	scale = MIN (scale, 1.0);
+
+	cairo_save (cr);
+	cairo_translate (cr,
+			 (dvi_document->exporter_paper_width - width * scale) / 2,
+			 (dvi_document->exporter_paper_height - height * scale) / 2);
+	cairo_scale (cr, xunit * scale, yunit * scale);
+	mdvi_cairo_device_render_to (context, cr);
+	cairo_restore (cr);
 }
 
 static void
-dvi_document_file_exporter_end (EvFileExporter *exporter)
+dvi_document_file_exporter_end_page (EvFileExporter *exporter)
 {
-	gchar *command_line;
-	gint exit_stat;
-	GError *err = NULL;
-	gboolean success;
-
 	DviDocument *dvi_document = DVI_DOCUMENT(exporter);
-	gchar* quoted_filename = g_shell_quote (dvi_document->context->filename);
-
-	command_line = g_strdup_printf ("dvipdfm %s -o %s %s", /* dvipdfm -s 1,2,.., -o exporter_filename dvi_filename */
-					dvi_document->exporter_opts->str,
-					dvi_document->exporter_filename,
-					quoted_filename);
-	g_free (quoted_filename);
 
-	success = g_spawn_command_line_sync (command_line,
-					     NULL,
-					     NULL,
-					     &exit_stat,
-					     &err);
+	if (dvi_document->exporter_cr)
+		cairo_show_page (dvi_document->exporter_cr);
+}
 
-	g_free (command_line);
+static void
+dvi_document_exporter_run_tool (DviDocument *dvi_document)
+{
+	const gchar *argv[7];
+	gint exit_stat;
+	GError *err = NULL;
+	gboolean success;
+	gboolean dvips;
+
+	if (dvi_document->exporter_pages->len == 0)
+		return;
+
+	/* dvipdfm -s 1,2,.. -o exporter_filename dvi_filename
+	 * dvips -pp 1,2,.. -o exporter_filename dvi_filename */
+	dvips = dvi_document->exporter_format == EV_FILE_FORMAT_PS;
+	argv[0] = dvi_document->exporter_tool;
+	argv[1] = dvips ? "-pp" : "-s";
+	argv[2] = dvi_document->exporter_pages->str;
+	argv[3] = "-o";
+	argv[4] = dvi_document->exporter_filename;
+	argv[5] = dvi_document->context->filename;
+	argv[6] = NULL;
+
+	success = g_spawn_sync (NULL, (gchar **) argv, NULL,
+				G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+				NULL, NULL, NULL, NULL,
+				&exit_stat, &err);
 
 	if (success == FALSE) {
 		g_warning ("Error: %s", err->message);
 	} else if (!WIFEXITED(exit_stat) || WEXITSTATUS(exit_stat) != EXIT_SUCCESS){
-		g_warning ("Error: dvipdfm does not end normally or exit with a failure status.");
+		g_warning ("Error: %s does not end normally or exit with a failure status.",
+			   dvips ? "dvips" : "dvipdfm");
 	}
 
 	if (err)
 		g_error_free (err);
 }
 
+static void
+dvi_document_exporter_clear (DviDocument *dvi_document)
+{
+	cairo_status_t status;
+
+	g_clear_pointer (&dvi_document->exporter_tool, g_free);
+	g_clear_pointer (&dvi_document->exporter_filename, g_free);
+	if (dvi_document->exporter_pages) {
+		g_string_free (dvi_document->exporter_pages, TRUE);
+		dvi_document->exporter_pages = NULL;
+	}
+
+	if (!dvi_document->exporter_cr)
+		return;
+
+	/* Finish the file here to find out about write errors */
+	cairo_surface_finish (cairo_get_target (dvi_document->exporter_cr));
+	status = cairo_surface_status (cairo_get_target (dvi_document->exporter_cr));
+	if (status != CAIRO_STATUS_SUCCESS)
+		g_warning ("Error exporting DVI document: %s", cairo_status_to_string (status));
+
+	g_clear_pointer (&dvi_document->exporter_cr, cairo_destroy);
+
+	dvi_document_release_render_context (dvi_document, dvi_document->exporter_context);
+	dvi_document->exporter_context = NULL;
+}
+
+static void
+dvi_document_file_exporter_end (EvFileExporter *exporter)
+{
+	DviDocument *dvi_document = DVI_DOCUMENT(exporter);
+
+	if (dvi_document->exporter_tool)
+		dvi_document_exporter_run_tool (dvi_document);
+
+	dvi_document_exporter_clear (dvi_document);
+}
+
 static EvFileExporterCapabilities
 dvi_document_file_exporter_get_capabilities (EvFileExporter *exporter)
 {
@@ -333,7 +554,13 @@ dvi_document_file_exporter_get_capabilities (EvFileExporter *exporter)
 		EV_FILE_EXPORTER_CAN_COPIES |
 		EV_FILE_EXPORTER_CAN_COLLATE |
 		EV_FILE_EXPORTER_CAN_REVERSE |
-		EV_FILE_EXPORTER_CAN_GENERATE_PDF;
+#ifdef CAIRO_HAS_PS_SURFACE
+		EV_FILE_EXPORTER_CAN_GENERATE_PS |
+#endif
+#ifdef CAIRO_HAS_PDF_SURFACE
+		EV_FILE_EXPORTER_CAN_GENERATE_PDF |
+#endif
+		0;
 }
 
 static void
@@ -341,6 +568,7 @@ dvi_document_file_exporter_iface_init (EvFileExporterInterface *iface)
 {
         iface->begin = dvi_document_file_exporter_begin;
         iface->do_page = dvi_document_file_exporter_do_page;
+        iface->end_page = dvi_document_file_exporter_end_page;
         iface->end = dvi_document_file_exporter_end;
 	iface->get_capabilities = dvi_document_file_exporter_get_capabilities;
 }
@@ -521,8 +749,13 @@ static void
 dvi_document_init (DviDocument *dvi_document)
 {
 	dvi_document->context = NULL;
+	g_mutex_init (&dvi_document->render_contexts_lock);
+	g_queue_init (&dvi_document->render_contexts);
 	dvi_document_init_params (dvi_document);
 
+	dvi_document->exporter_tool = NULL;
 	dvi_document->exporter_filename = NULL;
-	dvi_document->exporter_opts = NULL;
+	dvi_document->exporter_pages = NULL;
+	dvi_document->exporter_cr = NULL;
+	dvi_document->exporter_context = NULL;
 }
@@ -918,6 +918,18 @@ void	mdvi_shrink_glyph(DviContext *dvi, DviFont *font,
 		bitmap_print(stderr, newmap);
 }
 
+static void put_row(DviDevice *dev, void *image, int y, Ulong *row, int w)
+{
+	int	x;
+
+	if(dev->put_row) {
+		dev->put_row(image, y, row, w);
+		return;
+	}
+	for(x = 0; x < w; x++)
+		dev->put_pixel(image, x, y, row[x]);
+}
+
 void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	DviFontChar *pk, DviGlyph *dest)
 {
@@ -931,6 +943,7 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	DviGlyph *glyph;
 	BITMAP 	*map;
 	Ulong	*pixels;
+	Ulong	*row;
 	int	npixels;
 	Ulong	colortab[2];
 	int	hs, vs;
@@ -990,6 +1003,9 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	dest->w = w;
 	dest->h = h;
 
+	/* the image is written a row at a time */
+	row = xnalloc(Ulong, w);
+
 	y = 0;
 	old_ptr = map->data;
 	rows_left = glyph->h;
@@ -1009,23 +1025,27 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 			if(npixels - 1 != samplemax)
 				sampleval = ((npixels-1) * sampleval) / samplemax;
 			ASSERT(sampleval < npixels);
-			dev->put_pixel(image, x, y, pixels[sampleval]);
+			row[x] = pixels[sampleval];
 			cols_left -= cols;
 			cols = hs;
 			x++;
 		}
 		for(; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
+			row[x] = pixels[0];
+		put_row(dev, image, y, row, w);
 		old_ptr = bm_offset(old_ptr, rows * map->stride);
 		rows_left -= rows;
 		rows = vs;
 		y++;
 	}
 
-	for(; y < h; y++) {
+	if(y < h) {
 		for(x = 0; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
+			row[x] = pixels[0];
+		for(; y < h; y++)
+			put_row(dev, image, y, row, w);
 	}
+	mdvi_free(row);
 
         dev->image_done(image);
 	DEBUG((DBG_BITMAPS, "shrink_glyph_grey: (%dw,%dh,%dx,%dy) -> (%dw,%dh,%dx,%dy)\n",
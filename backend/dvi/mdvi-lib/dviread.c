@@ -428,7 +428,9 @@ static DviFontRef *define_font(DviContext *dvi, int op)
 	DEBUG((DBG_FONTS, "requesting font %d = `%s' at %.1fpt (%dx%d dpi)\n",
 		arg, name, (double)scale / (dvi->params.tfm_conv * 0x100000),
 		hdpi, vdpi));
+	font_lock();
 	ref = font_reference(&dvi->params, arg, name, checksum, hdpi, vdpi, scale);
+	font_unlock();
 	if(ref == NULL) {
 		mdvi_error(_("could not load font `%s'\n"), name);
 		mdvi_free(name);
@@ -489,6 +491,7 @@ int	mdvi_reload(DviContext *dvi, DviParams *np)
 	}
 
 	/* drop all our font references */
+	font_lock();
 	font_drop_chain(dvi->fonts);
 	/* destroy our font map */
 	if(dvi->fontmap)
@@ -527,6 +530,7 @@ int	mdvi_reload(DviContext *dvi, DviParams *np)
 
 	/* remove fonts that are not being used anymore */
 	font_free_unused(&dvi->device);
+	font_unlock();
 
 	mdvi_free(newdvi->filename);
 	mdvi_free(newdvi);
@@ -565,17 +569,16 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 		case MDVI_SET_YDPI:
 			np.vdpi = va_arg(ap, Uint);
 			break;
+		/* glyphs remember their shrink factors, and those
+		 * shrunk for other factors are kept in the glyph cache */
 		case MDVI_SET_SHRINK:
 			np.hshrink = np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_XSHRINK:
 			np.hshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_YSHRINK:
 			np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_ORIENTATION:
 			np.orientation = va_arg(ap, DviOrientation);
@@ -651,7 +654,9 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 	}
 
 	if(reset_font) {
+		font_lock();
 		font_reset_chain_glyphs(&dvi->device, dvi->fonts, reset_font);
+		font_unlock();
 	}
 	dvi->params = np;
 	if((reset_font & MDVI_FONTSEL_GLYPH) && dvi->device.refresh) {
@@ -896,6 +901,7 @@ DviContext *mdvi_init_context(DviParams *par, DviPageSpec *spec, const char *fil
 	dvi->device.free_image   = dummy_free_image;
 	dvi->device.dev_destroy  = dummy_dev_destroy;
 	dvi->device.put_pixel    = dummy_dev_putpixel;
+	dvi->device.put_row      = NULL;
 	dvi->device.refresh      = dummy_dev_refresh;
 	dvi->device.set_color    = dummy_dev_set_color;
 	dvi->device.device_data  = NULL;
@@ -918,8 +924,10 @@ void	mdvi_destroy_context(DviContext *dvi)
 		dvi->device.dev_destroy(dvi->device.device_data);
 	/* release all fonts */
 	if(dvi->fonts) {
+		font_lock();
 		font_drop_chain(dvi->fonts);
 		font_free_unused(&dvi->device);
+		font_unlock();
 	}
 	if(dvi->fontmap)
 		mdvi_free(dvi->fontmap);
@@ -1249,6 +1257,7 @@ int	set_char(DviContext *dvi, int opcode)
 	int	num;
 	int	h;
 	int	hh;
+	Int32	tfmwidth;
 	DviFontChar *ch;
 	DviFont	*font;
 
@@ -1261,11 +1270,14 @@ int	set_char(DviContext *dvi, int opcode)
 		return -1;
 	}
 	font = dvi->currfont->ref;
+	/* the glyph belongs to the shared font, keep it until it's drawn */
+	font_lock();
 	ch = font_get_glyph(dvi, font, num);
 	if(ch == NULL || ch->missing) {
 		/* try to display something anyway */
 		ch = FONTCHAR(font, num);
 		if(!glyph_present(ch)) {
+			font_unlock();
 			dviwarn(dvi,
 			_("requested character %d does not exist in `%s'\n"),
 				num, font->fontname);
@@ -1280,16 +1292,18 @@ int	set_char(DviContext *dvi, int opcode)
 			dvi->device.draw_glyph(dvi, ch,
 				dvi->pos.hh, dvi->pos.vv);
 	}
+	tfmwidth = ch->tfmwidth;
+	font_unlock();
 	if(opcode >= DVI_PUT1 && opcode <= DVI_PUT4) {
 		SHOWCMD((dvi, "putchar", opcode - DVI_PUT1 + 1,
 			"char %d (%s)\n",
 			num, dvi->currfont->ref->fontname));
 	} else {
-		h = dvi->pos.h + ch->tfmwidth;
-		hh = dvi->pos.hh + pixel_round(dvi, ch->tfmwidth);
+		h = dvi->pos.h + tfmwidth;
+		hh = dvi->pos.hh + pixel_round(dvi, tfmwidth);
 		SHOWCMD((dvi, "setchar", num, "(%d,%d) h:=%d%c%ld=%d, hh:=%d (%s)\n",
 			dvi->pos.hh, dvi->pos.vv,
-			DBGSUM(dvi->pos.h, (long) ch->tfmwidth, h), hh,
+			DBGSUM(dvi->pos.h, (long) tfmwidth, h), hh,
 			font->fontname));
 		dvi->pos.h  = h;
 		dvi->pos.hh = hh;
@@ -23,6 +23,8 @@
 #include "private.h"
 
 static ListHead fontlist;
+static DviLockFunc font_lock_func = NULL;
+static DviLockFunc font_unlock_func = NULL;
 
 extern char *_mdvi_fallback_font;
 
@@ -32,6 +34,24 @@ extern void vf_free_macros(DviFont *);
 #define TYPENAME(font)	\
 	((font)->finfo ? (font)->finfo->name : "none")
 
+void	mdvi_set_font_lock(DviLockFunc lock, DviLockFunc unlock)
+{
+	font_lock_func = lock;
+	font_unlock_func = unlock;
+}
+
+void	font_lock(void)
+{
+	if(font_lock_func)
+		font_lock_func();
+}
+
+void	font_unlock(void)
+{
+	if(font_unlock_func)
+		font_unlock_func();
+}
+
 int	font_reopen(DviFont *font)
 {
 	if(font->in)
@@ -366,10 +386,26 @@ again:
 	/* yes, we have to do this again */
 	ch = FONTCHAR(font, code);
 
+	if(!ch->width || !ch->height || font->finfo->getglyph == NULL)
+		return ch;
+
+	/* The glyph may have been shrunk for another zoom level, or by
+	 * another context: keep it in the cache, and get the right one.
+	 * This has to be done even when no shrinking is needed, so that
+	 * the glyphs shrunk for another zoom level are not drawn. */
+	if(ch->hshrink != dvi->params.hshrink ||
+	   ch->vshrink != dvi->params.vshrink) {
+		if(ch->shrunk.data || ch->grey.data)
+			glyph_cache_store(&dvi->device, font, code, ch);
+		if(!glyph_cache_fetch(font, code, ch,
+				      dvi->params.hshrink, dvi->params.vshrink)) {
+			ch->hshrink = dvi->params.hshrink;
+			ch->vshrink = dvi->params.vshrink;
+		}
+	}
+
 	/* Got the glyph. If we also have the right scaled glyph, do no more */
-	if(!ch->width || !ch->height ||
-	   font->finfo->getglyph == NULL ||
-	   (dvi->params.hshrink == 1 && dvi->params.vshrink == 1))
+	if(dvi->params.hshrink == 1 && dvi->params.vshrink == 1)
 		return ch;
 
 	/* If the glyph is empty, we just need to shrink the box */
@@ -427,6 +463,8 @@ void	font_reset_font_glyphs(DviDevice *dev, DviFont *font, int what)
 
 	if(what & MDVI_FONTSEL_GLYPH)
 		what |= MDVI_FONTSEL_BITMAP|MDVI_FONTSEL_GREY;
+	/* cached glyphs were shrunk with the old settings as well */
+	glyph_cache_drop_font(font);
 	if(font->subfonts) {
 		DviFontRef *ref;
 
@@ -468,7 +506,9 @@ void	font_finish_definitions(DviContext *dvi)
 	DviFontRef **map, *ref;
 
 	/* first get rid of unused fonts */
+	font_lock();
 	font_free_unused(&dvi->device);
+	font_unlock();
 
 	if(dvi->fonts == NULL) {
 		mdvi_warning(_("%s: no fonts defined\n"), dvi->filename);
@@ -0,0 +1,223 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * A cache of shrunk glyphs. A DviFontChar only holds the glyph for the
+ * shrink factors it was last drawn at; when those change, the old glyph
+ * is moved here instead of being destroyed, so going back to a previous
+ * zoom level doesn't have to unpack and shrink the glyphs again. The
+ * cache is shared by all contexts and is limited by a memory budget,
+ * dropping the least recently stored glyphs first. Callers must hold
+ * the font lock.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+
+#include "mdvi.h"
+#include "private.h"
+
+#define GLYPH_CACHE_BUCKETS	1021
+
+typedef struct {
+	DviFont	*font;
+	int	code;
+	int	hshrink;
+	int	vshrink;
+} GlyphKey;
+
+typedef struct _GlyphEntry GlyphEntry;
+
+struct _GlyphEntry {
+	GlyphEntry *next;	/* for the LRU list, must be first */
+	GlyphEntry *prev;
+	GlyphKey key;
+	Ulong	fg;
+	Ulong	bg;
+	DviGlyph shrunk;
+	DviGlyph grey;
+	DviFreeImage free_image;
+	size_t	size;
+};
+
+static DviHashTable glyph_table = MDVI_EMPTY_HASH_TABLE;
+static ListHead glyph_lru = MDVI_EMPTY_LIST_HEAD;
+static size_t glyph_cache_size = 0;
+static size_t glyph_cache_budget = MDVI_GLYPH_CACHE_SIZE;
+
+static Ulong hash_glyph_key(DviHashKey key)
+{
+	GlyphKey *k = (GlyphKey *)key;
+	Ulong	h;
+
+	h = (Ulong)k->font;
+	h = h * 31 + (Ulong)k->code;
+	h = h * 31 + (Ulong)k->hshrink;
+	h = h * 31 + (Ulong)k->vshrink;
+
+	return h;
+}
+
+static int compare_glyph_keys(DviHashKey k1, DviHashKey k2)
+{
+	GlyphKey *a = (GlyphKey *)k1;
+	GlyphKey *b = (GlyphKey *)k2;
+
+	return !(a->font == b->font &&
+		 a->code == b->code &&
+		 a->hshrink == b->hshrink &&
+		 a->vshrink == b->vshrink);
+}
+
+static size_t glyph_size(DviGlyph *bitmap, DviGlyph *grey)
+{
+	size_t	size = sizeof(GlyphEntry);
+
+	if(MDVI_GLYPH_NONEMPTY(bitmap->data))
+		size += (size_t)ROUND(bitmap->w, BITMAP_BITS) * BITMAP_BYTES * bitmap->h;
+	/* devices use at least 32 bits per pixel for grey images */
+	if(MDVI_GLYPH_NONEMPTY(grey->data))
+		size += (size_t)grey->w * grey->h * 4;
+
+	return size;
+}
+
+static void free_glyph_entry(GlyphEntry *entry)
+{
+	if(MDVI_GLYPH_NONEMPTY(entry->shrunk.data))
+		bitmap_destroy((BITMAP *)entry->shrunk.data);
+	if(MDVI_GLYPH_NONEMPTY(entry->grey.data) && entry->free_image)
+		entry->free_image(entry->grey.data);
+	mdvi_free(entry);
+}
+
+static void remove_glyph_entry(GlyphEntry *entry)
+{
+	mdvi_hash_remove_ptr(&glyph_table, MDVI_KEY(&entry->key));
+	listh_remove(&glyph_lru, LIST(entry));
+	glyph_cache_size -= entry->size;
+}
+
+static void trim_glyph_cache(size_t budget)
+{
+	GlyphEntry *entry;
+
+	while(glyph_cache_size > budget &&
+	      (entry = (GlyphEntry *)glyph_lru.tail) != NULL) {
+		remove_glyph_entry(entry);
+		free_glyph_entry(entry);
+	}
+}
+
+void	mdvi_set_glyph_cache_size(size_t budget)
+{
+	font_lock();
+	glyph_cache_budget = budget;
+	trim_glyph_cache(budget);
+	font_unlock();
+}
+
+/* move the shrunk glyphs of `ch' to the cache */
+void	glyph_cache_store(DviDevice *dev, DviFont *font, int code, DviFontChar *ch)
+{
+	GlyphEntry *entry;
+
+	entry = xalloc(GlyphEntry);
+	entry->key.font = font;
+	entry->key.code = code;
+	entry->key.hshrink = ch->hshrink;
+	entry->key.vshrink = ch->vshrink;
+	entry->fg = ch->fg;
+	entry->bg = ch->bg;
+	entry->shrunk = ch->shrunk;
+	entry->grey = ch->grey;
+	entry->free_image = dev->free_image;
+	entry->size = glyph_size(&ch->shrunk, &ch->grey);
+
+	ch->shrunk.data = NULL;
+	ch->grey.data = NULL;
+
+	if(entry->size > glyph_cache_budget) {
+		free_glyph_entry(entry);
+		return;
+	}
+
+	if(glyph_table.buckets == NULL) {
+		mdvi_hash_create(&glyph_table, GLYPH_CACHE_BUCKETS);
+		glyph_table.hash_func = hash_glyph_key;
+		glyph_table.hash_comp = compare_glyph_keys;
+	} else {
+		GlyphEntry *old;
+
+		old = (GlyphEntry *)mdvi_hash_lookup(&glyph_table,
+			MDVI_KEY(&entry->key));
+		if(old) {
+			remove_glyph_entry(old);
+			free_glyph_entry(old);
+		}
+	}
+
+	mdvi_hash_add(&glyph_table, MDVI_KEY(&entry->key), entry,
+		MDVI_HASH_UNCHECKED);
+	listh_prepend(&glyph_lru, LIST(entry));
+	glyph_cache_size += entry->size;
+
+	trim_glyph_cache(glyph_cache_budget);
+}
+
+/* move the glyphs cached for the given shrink factors back to `ch' */
+int	glyph_cache_fetch(DviFont *font, int code, DviFontChar *ch,
+	int hshrink, int vshrink)
+{
+	GlyphEntry *entry;
+	GlyphKey key;
+
+	if(glyph_table.buckets == NULL)
+		return 0;
+
+	key.font = font;
+	key.code = code;
+	key.hshrink = hshrink;
+	key.vshrink = vshrink;
+	entry = (GlyphEntry *)mdvi_hash_lookup(&glyph_table, MDVI_KEY(&key));
+	if(entry == NULL)
+		return 0;
+
+	remove_glyph_entry(entry);
+	ch->shrunk = entry->shrunk;
+	ch->grey = entry->grey;
+	ch->fg = entry->fg;
+	ch->bg = entry->bg;
+	ch->hshrink = hshrink;
+	ch->vshrink = vshrink;
+	mdvi_free(entry);
+
+	return 1;
+}
+
+/* forget all the glyphs of `font' */
+void	glyph_cache_drop_font(DviFont *font)
+{
+	GlyphEntry *entry, *next;
+
+	for(entry = (GlyphEntry *)glyph_lru.head; entry; entry = next) {
+		next = entry->next;
+		if(entry->key.font != font)
+			continue;
+		remove_glyph_entry(entry);
+		free_glyph_entry(entry);
+	}
+}
@@ -49,6 +49,7 @@ typedef struct _DviFontSearch DviFontSearch;
 typedef struct _DviFontClass DviFontClass;
 
 typedef void (*DviFreeFunc) __PROTO((void *));
+typedef void (*DviLockFunc) __PROTO((void));
 typedef void (*DviFree2Func) __PROTO((void *, void *));
 
 typedef Ulong	DviColor;
@@ -99,6 +100,8 @@ typedef void *(*DviCreateImage)	__PROTO((void *device_data,
 				         Uint bpp));
 typedef void (*DviFreeImage)	__PROTO((void *image));
 typedef void (*DviPutPixel)	__PROTO((void *image, int x, int y, Ulong color));
+typedef void (*DviPutRow)	__PROTO((void *image, int y,
+				         const Ulong *colors, int npixels));
 typedef void (*DviImageDone)    __PROTO((void *image));
 typedef void (*DviDevDestroy)   __PROTO((void *data));
 typedef void (*DviRefresh)      __PROTO((DviContext *dvi, void *device_data));
@@ -115,6 +118,7 @@ struct _DviDevice {
 	DviCreateImage	create_image;
 	DviFreeImage	free_image;
 	DviPutPixel	put_pixel;
+	DviPutRow	put_row;	/* optional, writes a whole row */
         DviImageDone    image_done;
 	DviDevDestroy	dev_destroy;
 	DviRefresh	refresh;
@@ -196,6 +200,8 @@ struct _DviFontChar {
 #endif
 	Ulong	fg;
 	Ulong	bg;
+	Ushort	hshrink;	/* shrink factors of `shrunk' and `grey' */
+	Ushort	vshrink;
 	BITMAP	*glyph_data;
 	/* data for shrunk bitimaps */
 	DviGlyph glyph;
@@ -541,6 +547,15 @@ extern void mdvi_flush_specials __PROTO((void));
 
 /* Fonts */
 
+/*
+ * Fonts and their glyphs are shared by all contexts. Applications that
+ * use several contexts from different threads must install a lock; it
+ * is taken recursively, since virtual fonts and specials nest.
+ */
+extern void mdvi_set_font_lock __PROTO((DviLockFunc lock, DviLockFunc unlock));
+extern void font_lock __PROTO((void));
+extern void font_unlock __PROTO((void));
+
 #define MDVI_FONTSEL_BITMAP	(1 << 0)
 #define MDVI_FONTSEL_GREY	(1 << 1)
 #define MDVI_FONTSEL_GLYPH	(1 << 2)
@@ -552,6 +567,14 @@ extern void mdvi_flush_specials __PROTO((void));
 
 #define glyph_present(x) ((x) && (x)->offset)
 
+/* default memory budget of the shrunk glyph cache, in bytes */
+#define MDVI_GLYPH_CACHE_SIZE	(16 * 1024 * 1024)
+
+extern void mdvi_set_glyph_cache_size __PROTO((size_t));
+extern void glyph_cache_store __PROTO((DviDevice *, DviFont *, int, DviFontChar *));
+extern int  glyph_cache_fetch __PROTO((DviFont *, int, DviFontChar *, int, int));
+extern void glyph_cache_drop_font __PROTO((DviFont *));
+
 /* create a reference to a font */
 extern DviFontRef *font_reference __PROTO((DviParams *params,
                                            Int32 dvi_id,
@@ -204,8 +204,10 @@ int	mdvi_do_special(DviContext *dvi, char *string)
 			sp->label, prefix, ptr));
 	}
 
-	/* invoke the handler */
+	/* invoke the handler; they may keep state in static data */
+	font_lock();
 	sp->handler(dvi, prefix, ptr);
+	font_unlock();
 
 	return 0;
 }
@@ -38,6 +38,13 @@
 #include <cairo-ps.h>
 #endif
 #include <glib/gi18n-lib.h>
+#ifdef G_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib-unix.h>
+#endif
 
 #include "ev-poppler.h"
 #include "ev-file-exporter.h"
@@ -80,6 +87,12 @@ typedef struct {
 
 #ifdef HAVE_CAIRO_PRINT
 	cairo_t *cr;
+
+	/* Times each page is exported in a row, and the last
+	 * exported page, recorded when there are several */
+	gint page_copies;
+	gint last_page;
+	cairo_surface_t *page_recording;
 #else
 	PopplerPSFile *ps_file;
 #endif
@@ -248,6 +261,205 @@ pdf_document_save (EvDocument  *document,
 	return retval;
 }
 
+#ifdef G_OS_UNIX
+/* Changes bigger than this are saved rewriting the whole file */
+#define PDF_MAX_CHANGES_SIZE (32 * 1024 * 1024)
+#define PDF_CHANGES_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+	gint        input;
+	gint        target;
+	goffset     size;
+	goffset     offset;
+	GByteArray *changes;
+	gboolean    give_up;
+	gint        errsv;
+} PdfChangesReader;
+
+/* Compares the document written by poppler with the target file, and
+ * keeps what follows the first difference. With incremental updates
+ * that's only the appended section, so it gives up as soon as the
+ * document differs before the end of the file */
+static gpointer
+pdf_changes_reader_thread (PdfChangesReader *reader)
+{
+	guchar  *buffer;
+	guchar  *current;
+	gboolean diverged = FALSE;
+
+	buffer = g_malloc (PDF_CHANGES_BUFFER_SIZE);
+	current = g_malloc (PDF_CHANGES_BUFFER_SIZE);
+
+	while (TRUE) {
+		gssize n, len, i = 0;
+
+		n = read (reader->input, buffer, PDF_CHANGES_BUFFER_SIZE);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0) {
+			reader->errsv = errno;
+			reader->give_up = TRUE;
+			break;
+		}
+		if (n == 0)
+			break;
+
+		/* Keep reading so that poppler doesn't block */
+		if (reader->give_up)
+			continue;
+
+		if (!diverged) {
+			len = pread (reader->target, current, n, reader->offset);
+			if (len < 0) {
+				reader->errsv = errno;
+				reader->give_up = TRUE;
+				continue;
+			}
+
+			if (len == n && memcmp (buffer, current, n) == 0)
+				i = n;
+			else
+				while (i < len && buffer[i] == current[i])
+					i++;
+
+			reader->offset += i;
+			if (i == n)
+				continue;
+
+			diverged = TRUE;
+			if (reader->offset != reader->size) {
+				reader->give_up = TRUE;
+				continue;
+			}
+		}
+
+		g_byte_array_append (reader->changes, buffer + i, n - i);
+		if (reader->changes->len > PDF_MAX_CHANGES_SIZE)
+			reader->give_up = TRUE;
+	}
+
+	close (reader->input);
+	g_free (buffer);
+	g_free (current);
+
+	return NULL;
+}
+
+static gboolean
+pdf_document_save_changes (EvDocument  *document,
+			   const char  *uri,
+			   GError     **error)
+{
+	PdfDocument     *pdf_document = PDF_DOCUMENT (document);
+	PdfChangesReader reader = { -1, -1, 0, 0, NULL, FALSE, 0 };
+	GError          *poppler_error = NULL;
+	struct stat      st;
+	GThread         *thread;
+	gchar           *filename;
+	gint             fds[2];
+	gboolean         retval;
+
+	filename = g_filename_from_uri (uri, NULL, error);
+	if (!filename)
+		return FALSE;
+
+	reader.target = open (filename, O_RDWR | O_CLOEXEC);
+	g_free (filename);
+	if (reader.target == -1) {
+		int errsv = errno;
+
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (errsv),
+				     g_strerror (errsv));
+		return FALSE;
+	}
+
+	if (fstat (reader.target, &st) == -1) {
+		int errsv = errno;
+
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (errsv),
+				     g_strerror (errsv));
+		close (reader.target);
+		return FALSE;
+	}
+	reader.size = st.st_size;
+
+	if (!g_unix_open_pipe (fds, FD_CLOEXEC, error)) {
+		close (reader.target);
+		return FALSE;
+	}
+
+	reader.input = fds[0];
+	reader.changes = g_byte_array_new ();
+	thread = g_thread_new ("EvPdfSaveChanges",
+			       (GThreadFunc) pdf_changes_reader_thread,
+			       &reader);
+
+	/* poppler closes the write end of the pipe when it's done */
+	retval = poppler_document_save_to_fd (pdf_document->document, fds[1],
+					      TRUE, &poppler_error);
+	g_thread_join (thread);
+
+	if (!retval) {
+		convert_error (poppler_error, error);
+	} else if (reader.errsv) {
+		g_set_error_literal (error, G_IO_ERROR,
+				     g_io_error_from_errno (reader.errsv),
+				     g_strerror (reader.errsv));
+		retval = FALSE;
+	} else if (reader.give_up || reader.offset != reader.size ||
+		   reader.changes->len == 0) {
+		/* Only appending to the file is safe, anything else
+		 * lets the caller save a new file */
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Document changes can't be appended to the file");
+		retval = FALSE;
+	} else {
+		gsize written = 0;
+
+		while (written < reader.changes->len) {
+			gssize n;
+
+			n = pwrite (reader.target, reader.changes->data + written,
+				    reader.changes->len - written,
+				    reader.offset + written);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				break;
+			written += n;
+		}
+
+		/* The changes must be on disk before the caller reports
+		 * the document as saved */
+		if (written < reader.changes->len || fsync (reader.target) == -1) {
+			int errsv = errno;
+
+			g_set_error_literal (error, G_IO_ERROR,
+					     g_io_error_from_errno (errsv),
+					     g_strerror (errsv));
+			retval = FALSE;
+
+			/* Drop what was appended, the file is left as it was */
+			if (ftruncate (reader.target, reader.size) == 0)
+				fsync (reader.target);
+		}
+	}
+
+	close (reader.target);
+	g_byte_array_unref (reader.changes);
+
+	if (retval) {
+		pdf_document->forms_modified = FALSE;
+		pdf_document->annots_modified = FALSE;
+		ev_document_set_modified (EV_DOCUMENT (document), FALSE);
+	}
+
+	return retval;
+}
+#endif /* G_OS_UNIX */
+
 static gboolean
 pdf_document_load (EvDocument   *document,
 		   const char   *uri,
@@ -471,13 +683,75 @@ make_thumbnail_for_page (PopplerPage     *poppler_page,
 	return pixbuf;
 }
 
+/* Embedded thumbnails are used instead of rendering the page when their
+ * size is within these factors of the requested one. */
+#define EMBEDDED_THUMBNAIL_MIN_FACTOR 0.8
+#define EMBEDDED_THUMBNAIL_MAX_FACTOR 2.0
+
+static gboolean
+embedded_thumbnail_size_is_close (gint thumb_size,
+				  gint size)
+{
+	return thumb_size >= size * EMBEDDED_THUMBNAIL_MIN_FACTOR &&
+		thumb_size <= size * EMBEDDED_THUMBNAIL_MAX_FACTOR;
+}
+
+/* Returns the /Thumb image of the page scaled and rotated to the
+ * (already rotated) @width x @height size, or %NULL when the page has no
+ * embedded thumbnail or its size is not close enough to the requested one */
+static cairo_surface_t *
+pdf_page_get_embedded_thumbnail (PopplerPage     *poppler_page,
+				 EvRenderContext *rc,
+				 gint             width,
+				 gint             height)
+{
+	cairo_surface_t *surface;
+	cairo_surface_t *scaled_surface;
+	cairo_surface_t *rotated_surface;
+	gint             thumb_width, thumb_height;
+	gint             unrotated_width, unrotated_height;
+
+	if (rc->rotation == 90 || rc->rotation == 270) {
+		unrotated_width = height;
+		unrotated_height = width;
+	} else {
+		unrotated_width = width;
+		unrotated_height = height;
+	}
+
+	/* Checking the size doesn't decode the image */
+	if (!poppler_page_get_thumbnail_size (poppler_page, &thumb_width, &thumb_height))
+		return NULL;
+
+	if (!embedded_thumbnail_size_is_close (thumb_width, unrotated_width) ||
+	    !embedded_thumbnail_size_is_close (thumb_height, unrotated_height))
+		return NULL;
+
+	surface = poppler_page_get_thumbnail (poppler_page);
+	if (!surface)
+		return NULL;
+
+	scaled_surface = ev_document_misc_surface_downsample (surface,
+							      unrotated_width,
+							      unrotated_height);
+	cairo_surface_destroy (surface);
+
+	rotated_surface = ev_document_misc_surface_rotate_and_scale (scaled_surface,
+								     unrotated_width,
+								     unrotated_height,
+								     rc->rotation);
+	cairo_surface_destroy (scaled_surface);
+
+	return rotated_surface;
+}
+
 static GdkPixbuf *
 pdf_document_get_thumbnail (EvDocument      *document,
 			    EvRenderContext *rc)
 {
 	PopplerPage *poppler_page;
 	cairo_surface_t *surface;
-	GdkPixbuf *pixbuf = NULL;
+	GdkPixbuf *pixbuf;
 	double page_width, page_height;
 	gint width, height;
 
@@ -489,33 +763,14 @@ pdf_document_get_thumbnail (EvDocument      *document,
 	ev_render_context_compute_transformed_size (rc, page_width, page_height,
 						    &width, &height);
 
-	surface = poppler_page_get_thumbnail (poppler_page);
-	if (surface) {
-		pixbuf = ev_document_misc_pixbuf_from_surface (surface);
-		cairo_surface_destroy (surface);
+	surface = pdf_page_get_embedded_thumbnail (poppler_page, rc, width, height);
+	if (!surface) {
+		/* There is no usable provided thumbnail. We need to make one. */
+		return make_thumbnail_for_page (poppler_page, rc, width, height);
 	}
 
-	if (pixbuf != NULL) {
-		int thumb_width = (rc->rotation == 90 || rc->rotation == 270) ?
-			gdk_pixbuf_get_height (pixbuf) :
-			gdk_pixbuf_get_width (pixbuf);
-
-		if (thumb_width == width) {
-			GdkPixbuf *rotated_pixbuf;
-
-			rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf,
-								   (GdkPixbufRotation) (360 - rc->rotation));
-			g_object_unref (pixbuf);
-			pixbuf = rotated_pixbuf;
-		} else {
-			/* The provided thumbnail has a different size */
-			g_object_unref (pixbuf);
-			pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-		}
-	} else {
-		/* There is no provided thumbnail. We need to make one. */
-		pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
-	}
+	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
+	cairo_surface_destroy (surface);
 
 	return pixbuf;
 }
@@ -538,23 +793,9 @@ pdf_document_get_thumbnail_surface (EvDocument      *document,
 	ev_render_context_compute_transformed_size (rc, page_width, page_height,
 						    &width, &height);
 
-	surface = poppler_page_get_thumbnail (poppler_page);
-	if (surface) {
-		int surface_width = (rc->rotation == 90 || rc->rotation == 270) ?
-			cairo_image_surface_get_height (surface) :
-			cairo_image_surface_get_width (surface);
-
-		if (surface_width == width) {
-			cairo_surface_t *rotated_surface;
-
-			rotated_surface = ev_document_misc_surface_rotate_and_scale (surface, width, height, rc->rotation);
-			cairo_surface_destroy (surface);
-			return rotated_surface;
-		} else {
-			/* The provided thumbnail has a different size */
-			cairo_surface_destroy (surface);
-		}
-	}
+	surface = pdf_page_get_embedded_thumbnail (poppler_page, rc, width, height);
+	if (surface)
+		return surface;
 
 	ev_document_fc_mutex_lock ();
 	surface = pdf_page_render (poppler_page, width, height, rc);
@@ -776,6 +1017,9 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	g_object_class->dispose = pdf_document_dispose;
 
 	ev_document_class->save = pdf_document_save;
+#ifdef G_OS_UNIX
+	ev_document_class->save_changes = pdf_document_save_changes;
+#endif
 	ev_document_class->load = pdf_document_load;
         ev_document_class->load_stream = pdf_document_load_stream;
         ev_document_class->load_gfile = pdf_document_load_gfile;
@@ -1646,6 +1890,7 @@ pdf_print_context_free (PdfPrintContext *ctx)
 		return;
 
 #ifdef HAVE_CAIRO_PRINT
+	g_clear_pointer (&ctx->page_recording, cairo_surface_destroy);
 	if (ctx->cr) {
 		cairo_destroy (ctx->cr);
 		ctx->cr = NULL;
@@ -1710,6 +1955,8 @@ pdf_document_file_exporter_begin (EvFileExporter        *exporter,
 	}
 
 	ctx->pages_printed = 0;
+	ctx->page_copies = MAX (fc->page_copies, 1);
+	ctx->last_page = -1;
 
 	switch (fc->format) {
 	        case EV_FILE_FORMAT_PS:
@@ -1740,6 +1987,41 @@ pdf_document_file_exporter_begin (EvFileExporter        *exporter,
 #endif /* HAVE_CAIRO_PRINT */
 }
 
+#ifdef HAVE_CAIRO_PRINT
+/* When copies are not collated, every page is exported several times in
+ * a row. The page is then rendered once into a recording surface, which
+ * is painted for all the copies, so that the PDF or PostScript surface
+ * writes it once as a form used by all of them. */
+static void
+pdf_print_context_render_page (PdfPrintContext *ctx,
+			       PopplerPage     *poppler_page,
+			       gint             page_index)
+{
+	if (ctx->page_copies == 1) {
+		poppler_page_render_for_printing (poppler_page, ctx->cr);
+		return;
+	}
+
+	if (page_index != ctx->last_page) {
+		cairo_rectangle_t extents = { 0, 0, 0, 0 };
+		cairo_t          *cr;
+
+		g_clear_pointer (&ctx->page_recording, cairo_surface_destroy);
+		ctx->last_page = page_index;
+
+		poppler_page_get_size (poppler_page, &extents.width, &extents.height);
+		ctx->page_recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA,
+								      &extents);
+		cr = cairo_create (ctx->page_recording);
+		poppler_page_render_for_printing (poppler_page, cr);
+		cairo_destroy (cr);
+	}
+
+	cairo_set_source_surface (ctx->cr, ctx->page_recording, 0, 0);
+	cairo_paint (ctx->cr);
+}
+#endif /* HAVE_CAIRO_PRINT */
+
 static void
 pdf_document_file_exporter_begin_page (EvFileExporter *exporter)
 {
@@ -1860,7 +2142,7 @@ pdf_document_file_exporter_do_page (EvFileExporter  *exporter,
 			 y * (rotate ? pwidth : pheight));
 	cairo_scale (ctx->cr, xscale, yscale);
 
-	poppler_page_render_for_printing (poppler_page, ctx->cr);
+	pdf_print_context_render_page (ctx, poppler_page, rc->page->index);
 
 	ctx->pages_printed++;
 
@@ -24,6 +24,8 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -34,6 +36,7 @@
 #include "ev-document-misc.h"
 #include "ev-file-exporter.h"
 #include "ev-file-helpers.h"
+#include "ev-pixel-ops.h"
 
 struct _TiffDocumentClass
 {
@@ -45,7 +48,7 @@ struct _TiffDocument
   EvDocument parent_instance;
 
   TIFF *tiff;
-  gint n_pages;
+  GArray *pages;
   TIFF2PSContext *ps_export_ctx;
 
   gchar *uri;
@@ -53,6 +56,21 @@ struct _TiffDocument
 
 typedef struct _TiffDocumentClass TiffDocumentClass;
 
+/* A reduced resolution version of a page, either a directory flagged as
+ * FILETYPE_REDUCEDIMAGE following the page in the main chain, or one of
+ * the page's SubIFDs (subifd_offset != 0) */
+typedef struct {
+	tdir_t   dir;
+	guint64  subifd_offset;
+	guint32  width;
+	guint32  height;
+} TiffLevel;
+
+typedef struct {
+	tdir_t   dir;
+	GArray  *levels;
+} TiffPage;
+
 static void tiff_document_document_file_exporter_iface_init (EvFileExporterInterface *iface);
 
 EV_BACKEND_REGISTER_WITH_CODE (TiffDocument, tiff_document,
@@ -78,6 +96,167 @@ pop_handlers (void)
 	TIFFSetWarningHandler (orig_warning_handler);
 }
 
+static void
+tiff_page_clear (TiffPage *page)
+{
+	g_clear_pointer (&page->levels, g_array_unref);
+}
+
+static void
+tiff_page_add_level (TiffPage *page,
+		     tdir_t    dir,
+		     guint64   subifd_offset,
+		     guint32   width,
+		     guint32   height)
+{
+	TiffLevel level;
+
+	if (width == 0 || height == 0)
+		return;
+
+	if (!page->levels)
+		page->levels = g_array_new (FALSE, FALSE, sizeof (TiffLevel));
+
+	level.dir = dir;
+	level.subifd_offset = subifd_offset;
+	level.width = width;
+	level.height = height;
+	g_array_append_val (page->levels, level);
+}
+
+/* Walks all the directories once, so that reduced resolution images are
+ * neither counted as pages nor looked up again on every render */
+static void
+tiff_document_index_pages (TiffDocument *tiff_document)
+{
+	TIFF *tiff = tiff_document->tiff;
+	GArray *subifds;
+	tdir_t dir = 0;
+	guint i;
+
+	tiff_document->pages = g_array_new (FALSE, TRUE, sizeof (TiffPage));
+	g_array_set_clear_func (tiff_document->pages, (GDestroyNotify) tiff_page_clear);
+
+	/* Pairs of page index and SubIFD offset, read once the main
+	 * chain is done as reading a SubIFD breaks the directory walk */
+	subifds = g_array_new (FALSE, FALSE, sizeof (guint64) * 2);
+
+	do {
+		guint32 subfile_type = 0;
+		guint16 n_subifds = 0;
+		guint64 *subifd_offsets = NULL;
+		TiffPage *page;
+
+		TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+
+		if ((subfile_type & FILETYPE_REDUCEDIMAGE) && tiff_document->pages->len > 0) {
+			guint32 w = 0, h = 0;
+
+			TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &w);
+			TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &h);
+			page = &g_array_index (tiff_document->pages, TiffPage,
+					       tiff_document->pages->len - 1);
+			tiff_page_add_level (page, dir, 0, w, h);
+			continue;
+		}
+
+		g_array_set_size (tiff_document->pages, tiff_document->pages->len + 1);
+		page = &g_array_index (tiff_document->pages, TiffPage,
+				       tiff_document->pages->len - 1);
+		page->dir = dir;
+
+		if (TIFFGetField (tiff, TIFFTAG_SUBIFD, &n_subifds, &subifd_offsets)) {
+			for (i = 0; i < n_subifds; i++) {
+				guint64 entry[2];
+
+				entry[0] = tiff_document->pages->len - 1;
+				entry[1] = subifd_offsets[i];
+				g_array_append_val (subifds, entry);
+			}
+		}
+	} while (dir++, TIFFReadDirectory (tiff));
+
+	for (i = 0; i < subifds->len; i++) {
+		guint64 *entry = &g_array_index (subifds, guint64, i * 2);
+		TiffPage *page = &g_array_index (tiff_document->pages, TiffPage, entry[0]);
+		guint32 subfile_type = 0;
+		guint32 w = 0, h = 0;
+
+		if (!TIFFSetSubDirectory (tiff, entry[1]))
+			continue;
+
+		TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+		if (!(subfile_type & FILETYPE_REDUCEDIMAGE))
+			continue;
+
+		TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &w);
+		TIFFGetField (tiff, TIFFTAG_IMAGELENGTH, &h);
+		tiff_page_add_level (page, page->dir, entry[1], w, h);
+	}
+
+	g_array_unref (subifds);
+}
+
+static gboolean
+tiff_document_set_page (TiffDocument *tiff_document,
+			gint          index)
+{
+	TiffPage *page;
+
+	if (index < 0 || index >= tiff_document->pages->len)
+		return FALSE;
+
+	page = &g_array_index (tiff_document->pages, TiffPage, index);
+
+	return TIFFSetDirectory (tiff_document->tiff, page->dir) == 1;
+}
+
+/* Makes current the smallest reduced resolution image of the page that
+ * is still at least @width x @height pixels. Returns FALSE when there's
+ * none, leaving the full resolution image as the current directory. */
+static gboolean
+tiff_document_set_page_level (TiffDocument *tiff_document,
+			      gint          index,
+			      gint          width,
+			      gint          height,
+			      gint          full_width)
+{
+	TiffPage *page;
+	TiffLevel *best = NULL;
+	guint i;
+
+	page = &g_array_index (tiff_document->pages, TiffPage, index);
+	if (!page->levels)
+		return FALSE;
+
+	for (i = 0; i < page->levels->len; i++) {
+		TiffLevel *level = &g_array_index (page->levels, TiffLevel, i);
+
+		if (level->width < width || level->height < height ||
+		    level->width >= full_width)
+			continue;
+
+		if (!best || level->width < best->width)
+			best = level;
+	}
+
+	if (!best)
+		return FALSE;
+
+	if (best->subifd_offset != 0) {
+		if (TIFFSetDirectory (tiff_document->tiff, best->dir) == 1 &&
+		    TIFFSetSubDirectory (tiff_document->tiff, best->subifd_offset))
+			return TRUE;
+	} else if (TIFFSetDirectory (tiff_document->tiff, best->dir) == 1) {
+		return TRUE;
+	}
+
+	/* Leave the full resolution image selected if the level is broken */
+	tiff_document_set_page (tiff_document, index);
+
+	return FALSE;
+}
+
 static gboolean
 tiff_document_load (EvDocument  *document,
 		    const char  *uri,
@@ -107,14 +286,6 @@ tiff_document_load (EvDocument  *document,
 #else
 	tiff = TIFFOpen (filename, "r");
 #endif
-	if (tiff) {
-		guint32 w, h;
-
-		/* FIXME: unused data? why bother here */
-		TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &w);
-		TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &h);
-	}
-
 	if (!tiff) {
 		pop_handlers ();
 
@@ -132,6 +303,8 @@ tiff_document_load (EvDocument  *document,
 	g_free (filename);
 	tiff_document->uri = g_strdup (uri);
 
+	tiff_document_index_pages (tiff_document);
+
 	pop_handlers ();
 	return TRUE;
 }
@@ -154,18 +327,7 @@ tiff_document_get_n_pages (EvDocument  *document)
 	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), 0);
 	g_return_val_if_fail (tiff_document->tiff != NULL, 0);
 
-	if (tiff_document->n_pages == -1) {
-		push_handlers ();
-		tiff_document->n_pages = 0;
-
-		do {
-			tiff_document->n_pages ++;
-		}
-		while (TIFFReadDirectory (tiff_document->tiff));
-		pop_handlers ();
-	}
-
-	return tiff_document->n_pages;
+	return tiff_document->pages->len;
 }
 
 static void
@@ -206,7 +368,7 @@ tiff_document_get_page_size (EvDocument *document,
 	g_return_if_fail (tiff_document->tiff != NULL);
 
 	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, page->index) != 1) {
+	if (!tiff_document_set_page (tiff_document, page->index)) {
 		pop_handlers ();
 		return;
 	}
@@ -222,6 +384,209 @@ tiff_document_get_page_size (EvDocument *document,
 	pop_handlers ();
 }
 
+static gboolean
+orientation_is_bottom_up (guint16 orientation)
+{
+	return orientation == ORIENTATION_BOTLEFT ||
+		orientation == ORIENTATION_BOTRIGHT ||
+		orientation == ORIENTATION_LEFTBOT ||
+		orientation == ORIENTATION_RIGHTBOT;
+}
+
+/* Decodes the current directory in bands of whole strips (or tile rows)
+ * and box-filters every band into a @dest_width x @dest_height surface
+ * as soon as it's read, so only one band of the full resolution image
+ * is in memory at any time. The destination size can't be bigger than
+ * the image. Must be called with the libtiff handlers pushed.
+ */
+static cairo_surface_t *
+tiff_document_read_scaled (TiffDocument  *tiff_document,
+			   gint           width,
+			   gint           height,
+			   gint           dest_width,
+			   gint           dest_height,
+			   guint16        req_orientation,
+			   cairo_format_t format)
+{
+	TIFF *tiff = tiff_document->tiff;
+	TIFFRGBAImage img;
+	char emsg[1024];
+	guint32 band_height = 0;
+	gboolean reverse;
+	guint32 *raster;
+	gfloat *row, *acc;
+	gdouble scale_x, scale_y, norm;
+	cairo_surface_t *surface;
+	guchar *dest_data;
+	gint dest_stride;
+	gint band, dy = 0;
+
+	g_assert (dest_width <= width && dest_height <= height);
+
+	if (!TIFFRGBAImageOK (tiff, emsg) ||
+	    !TIFFRGBAImageBegin (&img, tiff, 0, emsg)) {
+		g_warning ("Failed to read TIFF image: %s", emsg);
+		return NULL;
+	}
+
+	/* Reading whole strips or tiles avoids decoding them more than once */
+	if (TIFFIsTiled (tiff))
+		TIFFGetField (tiff, TIFFTAG_TILELENGTH, &band_height);
+	else
+		TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &band_height);
+	if (band_height == 0 || band_height > height)
+		band_height = height;
+	else if (band_height < 64)
+		band_height = MIN (height, (64 / band_height + 1) * band_height);
+
+	if (width > G_MAXSIZE / sizeof (guint32) / band_height) {
+		g_warning ("Overflow while rendering document.");
+		TIFFRGBAImageEnd (&img);
+		return NULL;
+	}
+
+	raster = g_try_new (guint32, (gsize) width * band_height);
+	if (!raster) {
+		g_warning ("Failed to allocate memory for rendering.");
+		TIFFRGBAImageEnd (&img);
+		return NULL;
+	}
+
+	surface = cairo_image_surface_create (format, dest_width, dest_height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		g_warning ("Failed to allocate memory for rendering.");
+		cairo_surface_destroy (surface);
+		TIFFRGBAImageEnd (&img);
+		g_free (raster);
+		return NULL;
+	}
+	dest_data = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	/* libtiff flips every band when the requested orientation starts
+	 * at the other end of the image, so the bands have to be read
+	 * from the last one to keep the rows in order.
+	 */
+	img.req_orientation = req_orientation;
+	reverse = orientation_is_bottom_up (img.orientation) != orientation_is_bottom_up (req_orientation);
+
+	scale_x = (gdouble) width / dest_width;
+	scale_y = (gdouble) height / dest_height;
+	norm = 1.0 / (scale_x * scale_y);
+
+	row = g_new (gfloat, dest_width * 4);
+	acc = g_new0 (gfloat, dest_width * 4);
+
+	for (band = 0; band < height && dy < dest_height; band += band_height) {
+		gint rows = MIN (band_height, height - band);
+		gint i;
+
+		img.row_offset = reverse ? height - band - rows : band;
+		img.col_offset = 0;
+		if (!TIFFRGBAImageGet (&img, raster, width, rows)) {
+			g_warning ("Failed to read TIFF image.");
+			cairo_surface_destroy (surface);
+			surface = NULL;
+			break;
+		}
+
+		for (i = 0; i < rows && dy < dest_height; i++) {
+			gdouble y0 = band + i;
+			gdouble y1 = y0 + 1;
+
+			/* At the image's own size it's only a format conversion */
+			if (dest_width == width && dest_height == height) {
+				ev_pixel_ops_swap_red_blue (raster + (gsize) i * width,
+							    (guint32 *) (dest_data + dy * dest_stride),
+							    width);
+				dy++;
+				continue;
+			}
+
+			/* libtiff packs the pixels as ABGR */
+			ev_pixel_ops_swap_red_blue (raster + (gsize) i * width,
+						    raster + (gsize) i * width,
+						    width);
+			memset (row, 0, sizeof (gfloat) * dest_width * 4);
+			ev_document_misc_downsample_row (raster + (gsize) i * width, width,
+							 scale_x, 1.0, row, dest_width);
+
+			/* A source row contributes to at most two destination
+			 * rows, as the image is never scaled up here */
+			while (y0 < y1 && dy < dest_height) {
+				gdouble row_end = (dy + 1) * scale_y;
+				gfloat  w = MIN (y1, row_end) - y0;
+				gint    dx;
+
+				for (dx = 0; dx < dest_width * 4; dx++)
+					acc[dx] += w * row[dx];
+
+				if (y1 < row_end && band + i + 1 < height)
+					break;
+
+				ev_document_misc_downsample_store_row (acc, norm,
+								       (guint32 *) (dest_data + dy * dest_stride),
+								       dest_width);
+				memset (acc, 0, sizeof (gfloat) * dest_width * 4);
+				dy++;
+				y0 = row_end;
+			}
+		}
+	}
+
+	TIFFRGBAImageEnd (&img);
+	g_free (raster);
+	g_free (row);
+	g_free (acc);
+
+	if (surface)
+		cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+/* Reads page @index, whose full resolution image is the current
+ * directory, at @scaled_width x @scaled_height from the smallest image
+ * in its pyramid that's big enough. @scaled_height is already corrected
+ * for non square pixels, as given by the x/y resolution ratio @aspect.
+ */
+static cairo_surface_t *
+tiff_document_read_page_scaled (TiffDocument  *tiff_document,
+				gint           index,
+				gint           width,
+				gint           height,
+				gint           scaled_width,
+				gint           scaled_height,
+				gdouble        aspect,
+				guint16        orientation,
+				cairo_format_t format)
+{
+	cairo_surface_t *surface;
+	guint32 level_width, level_height;
+
+	if (tiff_document_set_page_level (tiff_document, index,
+					  scaled_width, ceil (scaled_height / aspect),
+					  width) &&
+	    TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &level_width) &&
+	    TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &level_height) &&
+	    level_width > 0 && level_height > 0) {
+		surface = tiff_document_read_scaled (tiff_document, level_width, level_height,
+						     CLAMP (scaled_width, 1, level_width),
+						     CLAMP (scaled_height, 1, level_height),
+						     orientation, format);
+		if (surface)
+			return surface;
+
+		if (!tiff_document_set_page (tiff_document, index))
+			return NULL;
+	}
+
+	return tiff_document_read_scaled (tiff_document, width, height,
+					  CLAMP (scaled_width, 1, width),
+					  CLAMP (scaled_height, 1, height),
+					  orientation, format);
+}
+
 static cairo_surface_t *
 tiff_document_render (EvDocument      *document,
 		      EvRenderContext *rc)
@@ -230,19 +595,15 @@ tiff_document_render (EvDocument      *document,
 	int width, height;
 	int scaled_width, scaled_height;
 	float x_res, y_res;
-	gint rowstride, bytes;
-	guchar *pixels = NULL;
-	guchar *p;
-	int orientation;
+	guint16 orientation;
 	cairo_surface_t *surface;
 	cairo_surface_t *rotated_surface;
-	static const cairo_user_data_key_t key;
 
 	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
 	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
 
 	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
+	if (!tiff_document_set_page (tiff_document, rc->page->index)) {
 		pop_handlers ();
 		g_warning("Failed to select page %d", rc->page->index);
 		return NULL;
@@ -266,69 +627,28 @@ tiff_document_render (EvDocument      *document,
 
 	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
 
-	pop_handlers ();
-
 	/* Sanity check the doc */
 	if (width <= 0 || height <= 0) {
+		pop_handlers ();
 		g_warning("Invalid width or height.");
 		return NULL;
 	}
 
-	rowstride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
-	if (rowstride / 4 != width) {
-		g_warning("Overflow while rendering document.");
-		/* overflow, or cairo was changed in an unsupported way */
-		return NULL;
-	}
-
-	if (height >= INT_MAX / rowstride) {
-		g_warning("Overflow while rendering document.");
-		/* overflow */
-		return NULL;
-	}
-	bytes = height * rowstride;
-
-	pixels = g_try_malloc (bytes);
-	if (!pixels) {
-		g_warning("Failed to allocate memory for rendering.");
-		return NULL;
-	}
-
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32_t *)pixels,
-					orientation, 0)) {
-		g_warning ("Failed to read TIFF image.");
-		g_free (pixels);
-		return NULL;
-	}
+	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
+					       &scaled_width, &scaled_height);
 
-	surface = cairo_image_surface_create_for_data (pixels,
-						       CAIRO_FORMAT_RGB24,
-						       width, height,
-						       rowstride);
-	cairo_surface_set_user_data (surface, &key,
-				     pixels, (cairo_destroy_func_t)g_free);
+	/* Only the output resolution needs to fit in memory. When zooming
+	 * in, the image is read at its own resolution and scaled up below */
+	surface = tiff_document_read_page_scaled (tiff_document, rc->page->index,
+						  width, height,
+						  scaled_width, scaled_height,
+						  x_res / y_res, orientation,
+						  CAIRO_FORMAT_RGB24);
 	pop_handlers ();
 
-	/* Convert the format returned by libtiff to
-	* what cairo expects
-	*/
-	p = pixels;
-	while (p < pixels + bytes) {
-		guint32 *pixel = (guint32*)p;
-		guint8 r = TIFFGetR(*pixel);
-		guint8 g = TIFFGetG(*pixel);
-		guint8 b = TIFFGetB(*pixel);
-		guint8 a = TIFFGetA(*pixel);
-
-		*pixel = (a << 24) | (r << 16) | (g << 8) | b;
-
-		p += 4;
-	}
+	if (!surface)
+		return NULL;
 
-	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
-					       &scaled_width, &scaled_height);
 	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
 								     scaled_width, scaled_height,
 								     rc->rotation);
@@ -345,14 +665,13 @@ tiff_document_get_thumbnail (EvDocument      *document,
 	int width, height;
 	int scaled_width, scaled_height;
 	float x_res, y_res;
-	gint rowstride, bytes;
-	guchar *pixels = NULL;
+	cairo_surface_t *surface;
+	cairo_surface_t *scaled_surface;
 	GdkPixbuf *pixbuf;
-	GdkPixbuf *scaled_pixbuf;
 	GdkPixbuf *rotated_pixbuf;
 
 	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
+	if (!tiff_document_set_page (tiff_document, rc->page->index)) {
 		pop_handlers ();
 		return NULL;
 	}
@@ -369,49 +688,36 @@ tiff_document_get_thumbnail (EvDocument      *document,
 
 	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
 
-	pop_handlers ();
-
 	/* Sanity check the doc */
-	if (width <= 0 || height <= 0)
+	if (width <= 0 || height <= 0) {
+		pop_handlers ();
 		return NULL;
+	}
 
-	if (width >= INT_MAX / 4)
-		/* overflow */
-		return NULL;
-	rowstride = width * 4;
+	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
+					       &scaled_width, &scaled_height);
 
-	if (height >= INT_MAX / rowstride)
-		/* overflow */
-		return NULL;
-	bytes = height * rowstride;
+	surface = tiff_document_read_page_scaled (tiff_document, rc->page->index,
+						  width, height,
+						  scaled_width, scaled_height,
+						  x_res / y_res, ORIENTATION_TOPLEFT,
+						  CAIRO_FORMAT_ARGB32);
+	pop_handlers ();
 
-	pixels = g_try_malloc (bytes);
-	if (!pixels)
+	if (!surface)
 		return NULL;
 
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32_t *)pixels,
-					ORIENTATION_TOPLEFT, 0)) {
-		g_free (pixels);
-		return NULL;
-	}
+	scaled_surface = ev_document_misc_surface_rotate_and_scale (surface,
+								    scaled_width, scaled_height,
+								    0);
+	cairo_surface_destroy (surface);
 
-	pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, TRUE, 8,
-					   width, height, rowstride,
-					   (GdkPixbufDestroyNotify) g_free, NULL);
-	pop_handlers ();
+	pixbuf = ev_document_misc_pixbuf_from_surface (scaled_surface);
+	cairo_surface_destroy (scaled_surface);
 
-	ev_render_context_compute_scaled_size (rc, width, height * (x_res / y_res),
-					       &scaled_width, &scaled_height);
-	scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-						 scaled_width, scaled_height,
-						 GDK_INTERP_BILINEAR);
+	rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf, 360 - rc->rotation);
 	g_object_unref (pixbuf);
 
-	rotated_pixbuf = gdk_pixbuf_rotate_simple (scaled_pixbuf, 360 - rc->rotation);
-	g_object_unref (scaled_pixbuf);
-
 	return rotated_pixbuf;
 }
 
@@ -454,6 +760,8 @@ tiff_document_finalize (GObject *object)
 
 	if (tiff_document->tiff)
 		TIFFClose (tiff_document->tiff);
+	if (tiff_document->pages)
+		g_array_unref (tiff_document->pages);
 	if (tiff_document->uri)
 		g_free (tiff_document->uri);
 
@@ -495,7 +803,7 @@ tiff_document_file_exporter_do_page (EvFileExporter *exporter, EvRenderContext *
 
 	if (document->ps_export_ctx == NULL)
 		return;
-	if (TIFFSetDirectory (document->tiff, rc->page->index) != 1)
+	if (!tiff_document_set_page (document, rc->page->index))
 		return;
 	tiff2ps_process_page (document->ps_export_ctx, document->tiff,
 			      0, 0, 0, 0, 0);
@@ -533,5 +841,4 @@ tiff_document_document_file_exporter_iface_init (EvFileExporterInterface *iface)
 static void
 tiff_document_init (TiffDocument *tiff_document)
 {
-	tiff_document->n_pages = -1;
 }
@@ -26,6 +26,7 @@
 #include <gtk/gtk.h>
 
 #include "ev-document-misc.h"
+#include "ev-pixel-ops.h"
 
 /* Returns a new GdkPixbuf that is suitable for placing in the thumbnail view.
  * It is four pixels wider and taller than the source.  If source_pixbuf is not
@@ -383,17 +384,51 @@ ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
 {
 	cairo_surface_t *surface;
 	cairo_t         *cr;
+	gboolean         has_alpha;
+	gint             width, height, n_channels;
+	gint             src_stride, dest_stride, y;
+	const guchar    *src_data;
+	guchar          *dest_data;
 
 	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
 
-	surface = cairo_image_surface_create (gdk_pixbuf_get_has_alpha (pixbuf) ?
+	has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+	surface = cairo_image_surface_create (has_alpha ?
 					      CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
-					      gdk_pixbuf_get_width (pixbuf),
-					      gdk_pixbuf_get_height (pixbuf));
-	cr = cairo_create (surface);
-	gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-	cairo_paint (cr);
-	cairo_destroy (cr);
+					      width, height);
+
+	if (gdk_pixbuf_get_bits_per_sample (pixbuf) != 8 ||
+	    n_channels != (has_alpha ? 4 : 3) ||
+	    cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cr = cairo_create (surface);
+		gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
+		cairo_paint (cr);
+		cairo_destroy (cr);
+
+		return surface;
+	}
+
+	/* Convert straight into the surface, one row at a time */
+	src_data = gdk_pixbuf_read_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	cairo_surface_flush (surface);
+	dest_data = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	for (y = 0; y < height; y++) {
+		const guchar *src = src_data + y * src_stride;
+		guint32      *dest = (guint32 *) (dest_data + y * dest_stride);
+
+		if (has_alpha)
+			ev_pixel_ops_rgba_to_argb_premul (src, dest, width);
+		else
+			ev_pixel_ops_rgb_to_xrgb (src, dest, width);
+	}
+	cairo_surface_mark_dirty (surface);
 
 	return surface;
 }
@@ -475,6 +510,166 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 	return new_surface;
 }
 
+/*
+ * ev_document_misc_downsample_row:
+ * @src: a row of cairo ARGB32 or RGB24 pixels
+ * @src_width: the number of pixels in @src
+ * @scale_x: the number of source pixels covered by a destination pixel
+ * @weight: the fraction of the destination row covered by @src
+ * @acc: the A, R, G and B sums of the destination row
+ * @dest_width: the number of pixels of the destination row
+ *
+ * Accumulates one source row into @acc for a box filter, averaging the
+ * source pixels covered by each destination column with fractional edge
+ * weights. Backends that scale their images down while decoding them
+ * share it with ev_document_misc_surface_downsample().
+ */
+void
+ev_document_misc_downsample_row (const guint32 *src,
+				 gint           src_width,
+				 gdouble        scale_x,
+				 gdouble        weight,
+				 gfloat        *acc,
+				 gint           dest_width)
+{
+	gint dx;
+
+	for (dx = 0; dx < dest_width; dx++) {
+		gdouble x0 = dx * scale_x;
+		gdouble x1 = MIN ((dx + 1) * scale_x, src_width);
+		gfloat  a = 0, r = 0, g = 0, b = 0;
+		gint    sx;
+
+		for (sx = (gint) x0; sx < x1; sx++) {
+			gfloat  w = MIN (x1, sx + 1) - MAX (x0, sx);
+			guint32 p = src[sx];
+
+			a += w * ((p >> 24) & 0xff);
+			r += w * ((p >> 16) & 0xff);
+			g += w * ((p >> 8) & 0xff);
+			b += w * (p & 0xff);
+		}
+
+		acc[dx * 4 + 0] += weight * a;
+		acc[dx * 4 + 1] += weight * r;
+		acc[dx * 4 + 2] += weight * g;
+		acc[dx * 4 + 3] += weight * b;
+	}
+}
+
+/*
+ * ev_document_misc_downsample_store_row:
+ * @acc: the A, R, G and B sums of a destination row
+ * @norm: the inverse of the number of source pixels covered by a
+ *   destination pixel
+ * @dest: the destination row
+ * @dest_width: the number of pixels in @dest
+ *
+ * Stores the averages accumulated by ev_document_misc_downsample_row()
+ * in @dest as cairo pixels.
+ */
+void
+ev_document_misc_downsample_store_row (const gfloat *acc,
+				       gdouble       norm,
+				       guint32      *dest,
+				       gint          dest_width)
+{
+	gint dx;
+
+	for (dx = 0; dx < dest_width; dx++) {
+		guint32 a = CLAMP (acc[dx * 4 + 0] * norm + 0.5, 0, 255);
+		guint32 r = CLAMP (acc[dx * 4 + 1] * norm + 0.5, 0, 255);
+		guint32 g = CLAMP (acc[dx * 4 + 2] * norm + 0.5, 0, 255);
+		guint32 b = CLAMP (acc[dx * 4 + 3] * norm + 0.5, 0, 255);
+
+		dest[dx] = (a << 24) | (r << 16) | (g << 8) | b;
+	}
+}
+
+/**
+ * ev_document_misc_surface_downsample:
+ * @surface: a #cairo_surface_t image surface
+ * @dest_width: the desired width
+ * @dest_height: the desired height
+ *
+ * Scales @surface down to @dest_width x @dest_height averaging all the
+ * source pixels covered by every destination pixel (a box filter), which
+ * is what thumbnails derived from already rendered pages need. Falls back
+ * to ev_document_misc_surface_rotate_and_scale() when the surface would
+ * have to be enlarged or is not a 32 bits per pixel image surface.
+ *
+ * Returns: (transfer full): a new #cairo_surface_t
+ *
+ * Since: 46.0
+ */
+cairo_surface_t *
+ev_document_misc_surface_downsample (cairo_surface_t *surface,
+				     gint             dest_width,
+				     gint             dest_height)
+{
+	cairo_surface_t *new_surface;
+	cairo_format_t   format;
+	gint             width, height;
+	gint             src_stride, dest_stride;
+	guchar          *src_data, *dest_data;
+	gdouble          scale_x, scale_y, norm;
+	gfloat          *acc;
+	gint             dy;
+
+	g_return_val_if_fail (surface != NULL, NULL);
+	g_return_val_if_fail (dest_width > 0 && dest_height > 0, NULL);
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	format = cairo_image_surface_get_format (surface);
+
+	if (dest_width > width || dest_height > height ||
+	    (format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24))
+		return ev_document_misc_surface_rotate_and_scale (surface, dest_width, dest_height, 0);
+
+	if (dest_width == width && dest_height == height)
+		return cairo_surface_reference (surface);
+
+	new_surface = cairo_image_surface_create (format, dest_width, dest_height);
+	if (cairo_surface_status (new_surface) != CAIRO_STATUS_SUCCESS)
+		return new_surface;
+
+	cairo_surface_flush (surface);
+	src_data = cairo_image_surface_get_data (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	dest_data = cairo_image_surface_get_data (new_surface);
+	dest_stride = cairo_image_surface_get_stride (new_surface);
+
+	scale_x = (gdouble) width / dest_width;
+	scale_y = (gdouble) height / dest_height;
+	norm = 1.0 / (scale_x * scale_y);
+
+	acc = g_new (gfloat, dest_width * 4);
+
+	for (dy = 0; dy < dest_height; dy++) {
+		gdouble  y0 = dy * scale_y;
+		gdouble  y1 = MIN ((dy + 1) * scale_y, height);
+		gint     sy;
+
+		memset (acc, 0, sizeof (gfloat) * dest_width * 4);
+		for (sy = (gint) y0; sy < y1; sy++) {
+			ev_document_misc_downsample_row ((const guint32 *) (src_data + sy * src_stride),
+							 width, scale_x,
+							 MIN (y1, sy + 1) - MAX (y0, sy),
+							 acc, dest_width);
+		}
+
+		ev_document_misc_downsample_store_row (acc, norm,
+						       (guint32 *) (dest_data + dy * dest_stride),
+						       dest_width);
+	}
+
+	g_free (acc);
+	cairo_surface_mark_dirty (new_surface);
+
+	return new_surface;
+}
+
 void
 ev_document_misc_invert_surface (cairo_surface_t *surface) {
 	cairo_t *cr;
@@ -491,8 +686,8 @@ ev_document_misc_invert_surface (cairo_surface_t *surface) {
 void
 ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 {
-	guchar *data, *p;
-	guint   width, height, x, y, rowstride, n_channels;
+	guchar *data, *row;
+	guint   width, height, y, rowstride, n_channels;
 
 	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
 	g_assert (gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB);
@@ -506,14 +701,24 @@ ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 
 	width = gdk_pixbuf_get_width (pixbuf);
 	height = gdk_pixbuf_get_height (pixbuf);
-	for (x = 0; x < width; x++) {
-		for (y = 0; y < height; y++) {
-			/* Calculate pixel's offset into the data array. */
-			p = data + x * n_channels + y * rowstride;
-			/* Change the RGB values*/
-			p[0] = 255 - p[0];
-			p[1] = 255 - p[1];
-			p[2] = 255 - p[2];
+	for (y = 0; y < height; y++) {
+		row = data + y * rowstride;
+
+		/* Change the RGB values, leaving alpha untouched */
+		if (n_channels == 4)
+			ev_pixel_ops_xor32 ((guint32 *) row, GUINT32_TO_BE (0xffffff00), width);
+		else if (n_channels == 3)
+			ev_pixel_ops_invert_bytes (row, width * 3);
+		else {
+			guint x;
+
+			for (x = 0; x < width; x++) {
+				guchar *p = row + x * n_channels;
+
+				p[0] = 255 - p[0];
+				p[1] = 255 - p[1];
+				p[2] = 255 - p[2];
+			}
 		}
 	}
 }
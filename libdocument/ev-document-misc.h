@@ -87,6 +87,22 @@ cairo_surface_t *ev_document_misc_surface_rotate_and_scale (cairo_surface_t *sur
 							    gint             dest_height,
 							    gint             dest_rotation);
 EV_PUBLIC
+cairo_surface_t *ev_document_misc_surface_downsample (cairo_surface_t *surface,
+						      gint             dest_width,
+						      gint             dest_height);
+EV_PRIVATE
+void             ev_document_misc_downsample_row (const guint32 *src,
+						  gint           src_width,
+						  gdouble        scale_x,
+						  gdouble        weight,
+						  gfloat        *acc,
+						  gint           dest_width);
+EV_PRIVATE
+void             ev_document_misc_downsample_store_row (const gfloat *acc,
+							gdouble       norm,
+							guint32      *dest,
+							gint          dest_width);
+EV_PUBLIC
 void             ev_document_misc_invert_surface (cairo_surface_t *surface);
 EV_PUBLIC
 void		 ev_document_misc_invert_pixbuf  (GdkPixbuf       *pixbuf);
@@ -46,10 +46,13 @@ struct _EvDocumentPrivate
 {
 	gchar          *uri;
 	guint64         file_size;
+	guint64         file_mtime;
+	guint32         file_mtime_usec;
 
 	gboolean        cache_loaded;
 	gint            n_pages;
 	gboolean        modified;
+	gboolean        edited;
 
 	gboolean        uniform;
 	gdouble         uniform_width;
@@ -68,8 +71,10 @@ struct _EvDocumentPrivate
 	synctex_scanner_p synctex_scanner;
 };
 
-static guint64         _ev_document_get_size_gfile  (GFile      *file);
-static guint64         _ev_document_get_size        (const char *uri);
+static void            _ev_document_query_file      (GFile      *file,
+						     guint64    *size,
+						     guint64    *mtime,
+						     guint32    *mtime_usec);
 static gint            _ev_document_get_n_pages     (EvDocument *document);
 static void            _ev_document_get_page_size   (EvDocument *document,
 						     EvPage     *page,
@@ -223,12 +228,40 @@ ev_document_set_modified (EvDocument *document,
 {
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 
+	if (modified)
+		document->priv->edited = TRUE;
+
 	if (document->priv->modified != modified) {
 		document->priv->modified = modified;
 		g_object_notify (G_OBJECT (document), "modified");
 	}
 }
 
+/**
+ * ev_document_get_edited:
+ * @document: an #EvDocument
+ *
+ * Unlike ev_document_get_modified(), this is not reset when the
+ * document is saved, so it tells whether the document still has the
+ * contents of the file it was loaded from.
+ *
+ * Like the modified state, this is only set by backends calling
+ * ev_document_set_modified(), which currently only the PDF backend
+ * does when forms or annotations change. The other backends can't
+ * modify documents, so for them this is always %FALSE.
+ *
+ * Returns: %TRUE if the document has been modified since it was loaded
+ *
+ * Since: 46.0
+ */
+gboolean
+ev_document_get_edited (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return document->priv->edited;
+}
+
 void
 ev_document_doc_mutex_lock (void)
 {
@@ -416,7 +449,7 @@ ev_document_load_full (EvDocument           *document,
 		if (!(flags & EV_DOCUMENT_LOAD_FLAG_NO_CACHE))
 			ev_document_setup_cache (document);
 		document->priv->uri = g_strdup (uri);
-		document->priv->file_size = _ev_document_get_size (uri);
+		ev_document_record_file_info (document);
 		ev_document_initialize_synctex (document, uri);
         }
 
@@ -544,7 +577,7 @@ ev_document_load_gfile (EvDocument         *document,
                 ev_document_setup_cache (document);
 
 	document->priv->uri = g_file_get_uri (file);
-	document->priv->file_size = _ev_document_get_size_gfile (file);
+	ev_document_record_file_info (document);
 	ev_document_initialize_synctex (document, document->priv->uri);
 
         return TRUE;
@@ -656,6 +689,62 @@ ev_document_save (EvDocument  *document,
 	return klass->save (document, uri, error);
 }
 
+/**
+ * ev_document_save_changes:
+ * @document: a #EvDocument
+ * @uri: the URI of a copy of the file @document was loaded from
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Updates the file at @uri with the changes made to @document, writing
+ * only the part of the file that changes, like a PDF incremental update.
+ * The cost of saving is then proportional to the size of the changes
+ * instead of the size of the document.
+ *
+ * When the changes can't be saved that way, %FALSE is returned with a
+ * %G_IO_ERROR_NOT_SUPPORTED error and @uri is left untouched, so the
+ * caller can fall back to ev_document_save().
+ *
+ * Returns: %TRUE on success, or %FALSE on error with @error filled in
+ *
+ * Since: 46.0
+ */
+gboolean
+ev_document_save_changes (EvDocument  *document,
+			  const char  *uri,
+			  GError     **error)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+	g_return_val_if_fail (uri != NULL, FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+	if (!klass->save_changes) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Backend does not support saving only the changes");
+		return FALSE;
+	}
+
+	return klass->save_changes (document, uri, error);
+}
+
+/**
+ * ev_document_can_save_changes:
+ * @document: an #EvDocument
+ *
+ * Returns: %TRUE if @document may save its changes with
+ *   ev_document_save_changes()
+ *
+ * Since: 46.0
+ */
+gboolean
+ev_document_can_save_changes (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return EV_DOCUMENT_GET_CLASS (document)->save_changes != NULL;
+}
+
 /**
  * ev_document_get_page:
  * @document: a #EvDocument
@@ -791,30 +880,94 @@ ev_document_synctex_forward_search (EvDocument   *document,
         return result;
 }
 
-static guint64
-_ev_document_get_size_gfile (GFile *file)
+static void
+_ev_document_query_file (GFile      *file,
+			 guint64    *size,
+			 guint64    *mtime,
+			 guint32    *mtime_usec)
 {
-	goffset    size = 0;
-	GFileInfo *info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+	GFileInfo *info = g_file_query_info (file,
+					     G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+					     G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+					     G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
                                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+	*size = 0;
+	*mtime = 0;
+	*mtime_usec = 0;
+
 	if (info) {
-		size = g_file_info_get_size (info);
+		*size = g_file_info_get_size (info);
+		*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		*mtime_usec = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
 
 		g_object_unref (info);
 	}
+}
 
-	return size;
+/**
+ * ev_document_record_file_info:
+ * @document: an #EvDocument
+ *
+ * Records the size and modification time of the file @document was
+ * loaded from, so that ev_document_is_file_unchanged() can tell later
+ * whether the file still has the contents of the document.
+ *
+ * Since: 46.0
+ */
+void
+ev_document_record_file_info (EvDocument *document)
+{
+	GFile *file;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	g_return_if_fail (document->priv->uri != NULL);
+
+	file = g_file_new_for_uri (document->priv->uri);
+	_ev_document_query_file (file,
+				 &document->priv->file_size,
+				 &document->priv->file_mtime,
+				 &document->priv->file_mtime_usec);
+	g_object_unref (file);
 }
 
-static guint64
-_ev_document_get_size (const char  *uri)
+/**
+ * ev_document_is_file_unchanged:
+ * @document: an #EvDocument
+ *
+ * Checks whether the file @document was loaded from is a local file
+ * whose size and modification time are still the ones recorded when
+ * it was loaded.
+ *
+ * Returns: %TRUE if the file on disk still matches @document
+ *
+ * Since: 46.0
+ */
+gboolean
+ev_document_is_file_unchanged (EvDocument *document)
 {
-	GFile  *file = g_file_new_for_uri (uri);
-	guint64 size = _ev_document_get_size_gfile (file);
+	GFile    *file;
+	guint64   size;
+	guint64   mtime;
+	guint32   mtime_usec;
+	gboolean  retval = FALSE;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
+	if (!document->priv->uri)
+		return FALSE;
+
+	file = g_file_new_for_uri (document->priv->uri);
+	if (g_file_is_native (file)) {
+		_ev_document_query_file (file, &size, &mtime, &mtime_usec);
+		retval = mtime != 0 &&
+			size == document->priv->file_size &&
+			mtime == document->priv->file_mtime &&
+			mtime_usec == document->priv->file_mtime_usec;
+	}
 	g_object_unref (file);
 
-	return size;
+	return retval;
 }
 
 static gint
@@ -966,6 +1119,71 @@ ev_document_render (EvDocument      *document,
 	return klass->render (document, rc);
 }
 
+/**
+ * ev_document_render_region:
+ * @document: an #EvDocument
+ * @rc: an #EvRenderContext
+ * @area: the area of the page to render
+ *
+ * Renders only @area of the page, in the coordinates of the page once
+ * scaled and rotated as requested by @rc. @area must be inside the page,
+ * and the returned surface has its size. Documents that can't render a region by themselves
+ * render the whole page and copy @area from it, see
+ * ev_document_can_render_region().
+ *
+ * Returns: (transfer full): a #cairo_surface_t
+ *
+ * Since: 46.0
+ */
+cairo_surface_t *
+ev_document_render_region (EvDocument                  *document,
+			   EvRenderContext             *rc,
+			   const cairo_rectangle_int_t *area)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *page_surface;
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+	g_return_val_if_fail (area != NULL && area->width > 0 && area->height > 0, NULL);
+
+	if (klass->render_region)
+		return klass->render_region (document, rc, area);
+
+	page_surface = klass->render (document, rc);
+	if (!page_surface)
+		return NULL;
+
+	surface = cairo_image_surface_create (cairo_surface_get_content (page_surface) == CAIRO_CONTENT_COLOR ?
+					      CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32,
+					      area->width, area->height);
+	cr = cairo_create (surface);
+	cairo_set_source_surface (cr, page_surface, -area->x, -area->y);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (page_surface);
+
+	return surface;
+}
+
+/**
+ * ev_document_can_render_region:
+ * @document: an #EvDocument
+ *
+ * Returns: %TRUE if @document renders regions of a page without
+ *   rendering the whole page first
+ *
+ * Since: 46.0
+ */
+gboolean
+ev_document_can_render_region (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return EV_DOCUMENT_GET_CLASS (document)->render_region != NULL;
+}
+
 static GdkPixbuf *
 _ev_document_get_thumbnail (EvDocument      *document,
 			    EvRenderContext *rc)
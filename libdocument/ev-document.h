@@ -134,6 +134,12 @@ struct _EvDocumentClass
 						     EvDocumentLoadFlags  flags,
 						     GCancellable        *cancellable,
 						     GError             **error);
+	cairo_surface_t * (* render_region)         (EvDocument          *document,
+						     EvRenderContext     *rc,
+						     const cairo_rectangle_int_t *area);
+	gboolean          (* save_changes)          (EvDocument          *document,
+						     const char          *uri,
+						     GError             **error);
 };
 
 EV_PUBLIC
@@ -168,6 +174,8 @@ EV_PUBLIC
 void             ev_document_set_modified         (EvDocument      *document,
 						   gboolean         modified);
 EV_PUBLIC
+gboolean         ev_document_get_edited           (EvDocument      *document);
+EV_PUBLIC
 gboolean         ev_document_load                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
@@ -215,6 +223,18 @@ EV_PUBLIC
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
 EV_PUBLIC
+cairo_surface_t *ev_document_render_region        (EvDocument      *document,
+						   EvRenderContext *rc,
+						   const cairo_rectangle_int_t *area);
+EV_PUBLIC
+gboolean         ev_document_can_render_region    (EvDocument      *document);
+EV_PUBLIC
+gboolean         ev_document_save_changes         (EvDocument      *document,
+						   const char      *uri,
+						   GError         **error);
+EV_PUBLIC
+gboolean         ev_document_can_save_changes     (EvDocument      *document);
+EV_PUBLIC
 GdkPixbuf       *ev_document_get_thumbnail        (EvDocument      *document,
 						   EvRenderContext *rc);
 EV_PUBLIC
@@ -224,6 +244,10 @@ EV_PUBLIC
 guint64          ev_document_get_size             (EvDocument      *document);
 EV_PUBLIC
 const gchar     *ev_document_get_uri              (EvDocument      *document);
+EV_PRIVATE
+void             ev_document_record_file_info     (EvDocument      *document);
+EV_PRIVATE
+gboolean         ev_document_is_file_unchanged    (EvDocument      *document);
 EV_PUBLIC
 const gchar     *ev_document_get_title            (EvDocument      *document);
 EV_PUBLIC
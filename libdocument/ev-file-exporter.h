@@ -62,6 +62,7 @@ struct _EvFileExporterContext {
 	gdouble              paper_height;
 	gboolean             duplex;
 	gint                 pages_per_sheet;
+	gint                 page_copies; /* times each page is exported in a row */
 };
 
 #define EV_TYPE_FILE_EXPORTER            (ev_file_exporter_get_type ())
@@ -0,0 +1,600 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "ev-pixel-ops.h"
+
+/* SSE2 is part of x86-64, so it only needs a runtime check for AVX2.
+ * The vector versions assume a little endian CPU, which all of these are.
+ */
+#if defined (__GNUC__) && (defined (__x86_64__) || (defined (__i386__) && defined (__SSE2__)))
+#define EV_PIXEL_OPS_SSE2 1
+#include <emmintrin.h>
+#if defined (__x86_64__) && (defined (__clang__) || __GNUC__ >= 5)
+#define EV_PIXEL_OPS_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined (__GNUC__) && defined (__aarch64__) && defined (__ARM_NEON) && !defined (__ARM_BIG_ENDIAN)
+#define EV_PIXEL_OPS_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+	const gchar *name;
+	void (* swap_red_blue)       (const guint32 *src, guint32 *dest, gsize n_pixels);
+	void (* rgba_to_argb_premul) (const guchar *src, guint32 *dest, gsize n_pixels);
+	void (* rgb_to_xrgb)         (const guchar *src, guint32 *dest, gsize n_pixels);
+	void (* xor32)               (guint32 *pixels, guint32 mask, gsize n_pixels);
+	void (* invert_bytes)        (guchar *data, gsize n_bytes);
+} EvPixelOps;
+
+/* x * a / 255, correctly rounded */
+static inline guint
+mul_div_255 (guint x,
+	     guint a)
+{
+	guint t = x * a + 128;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+/* Plain C versions, also used for the pixels left over by the vector ones */
+
+static void
+swap_red_blue_c (const guint32 *src,
+		 guint32       *dest,
+		 gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32 p = src[i];
+
+		dest[i] = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+	}
+}
+
+static void
+rgba_to_argb_premul_c (const guchar *src,
+		       guint32      *dest,
+		       gsize         n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++, src += 4) {
+		guint r = src[0], g = src[1], b = src[2], a = src[3];
+
+		if (a == 0) {
+			dest[i] = 0;
+		} else if (a == 0xff) {
+			dest[i] = 0xff000000 | (r << 16) | (g << 8) | b;
+		} else {
+			dest[i] = (a << 24) |
+				(mul_div_255 (r, a) << 16) |
+				(mul_div_255 (g, a) << 8) |
+				mul_div_255 (b, a);
+		}
+	}
+}
+
+static void
+rgb_to_xrgb_c (const guchar *src,
+	       guint32      *dest,
+	       gsize         n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++, src += 3)
+		dest[i] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+}
+
+static void
+xor32_c (guint32 *pixels,
+	 guint32  mask,
+	 gsize    n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i < n_pixels; i++)
+		pixels[i] ^= mask;
+}
+
+static void
+invert_bytes_c (guchar *data,
+		gsize   n_bytes)
+{
+	gsize i;
+
+	for (i = 0; i < n_bytes; i++)
+		data[i] = ~data[i];
+}
+
+static const EvPixelOps c_ops = {
+	"c",
+	swap_red_blue_c,
+	rgba_to_argb_premul_c,
+	rgb_to_xrgb_c,
+	xor32_c,
+	invert_bytes_c
+};
+
+#ifdef EV_PIXEL_OPS_SSE2
+
+static inline __m128i
+swap_red_blue_4_sse2 (__m128i p)
+{
+	const __m128i ga = _mm_set1_epi32 ((gint) 0xff00ff00);
+	const __m128i low = _mm_set1_epi32 (0xff);
+	__m128i r = _mm_and_si128 (_mm_srli_epi32 (p, 16), low);
+	__m128i b = _mm_slli_epi32 (_mm_and_si128 (p, low), 16);
+
+	return _mm_or_si128 (_mm_and_si128 (p, ga), _mm_or_si128 (r, b));
+}
+
+/* Premultiplies two BGRA pixels widened to 16 bits per channel */
+static inline __m128i
+premul_2_sse2 (__m128i p)
+{
+	const __m128i alpha_lanes = _mm_set_epi16 (0xff, 0, 0, 0, 0xff, 0, 0, 0);
+	const __m128i round = _mm_set1_epi16 (128);
+	__m128i a;
+
+	a = _mm_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+	/* Alpha itself is multiplied by 255, leaving it unchanged */
+	a = _mm_or_si128 (a, alpha_lanes);
+
+	p = _mm_add_epi16 (_mm_mullo_epi16 (p, a), round);
+
+	return _mm_srli_epi16 (_mm_add_epi16 (p, _mm_srli_epi16 (p, 8)), 8);
+}
+
+static void
+swap_red_blue_sse2 (const guint32 *src,
+		    guint32       *dest,
+		    gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *) (src + i));
+
+		_mm_storeu_si128 ((__m128i *) (dest + i), swap_red_blue_4_sse2 (p));
+	}
+
+	swap_red_blue_c (src + i, dest + i, n_pixels - i);
+}
+
+static void
+rgba_to_argb_premul_sse2 (const guchar *src,
+			  guint32      *dest,
+			  gsize         n_pixels)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *) (src + i * 4));
+		__m128i lo, hi;
+
+		p = swap_red_blue_4_sse2 (p);
+		lo = premul_2_sse2 (_mm_unpacklo_epi8 (p, zero));
+		hi = premul_2_sse2 (_mm_unpackhi_epi8 (p, zero));
+
+		_mm_storeu_si128 ((__m128i *) (dest + i), _mm_packus_epi16 (lo, hi));
+	}
+
+	rgba_to_argb_premul_c (src + i * 4, dest + i, n_pixels - i);
+}
+
+static void
+xor32_sse2 (guint32 *pixels,
+	    guint32  mask,
+	    gsize    n_pixels)
+{
+	const __m128i m = _mm_set1_epi32 ((gint) mask);
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *) (pixels + i));
+
+		_mm_storeu_si128 ((__m128i *) (pixels + i), _mm_xor_si128 (p, m));
+	}
+
+	xor32_c (pixels + i, mask, n_pixels - i);
+}
+
+static void
+invert_bytes_sse2 (guchar *data,
+		   gsize   n_bytes)
+{
+	const __m128i m = _mm_set1_epi8 ((gchar) 0xff);
+	gsize i;
+
+	for (i = 0; i + 16 <= n_bytes; i += 16) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *) (data + i));
+
+		_mm_storeu_si128 ((__m128i *) (data + i), _mm_xor_si128 (p, m));
+	}
+
+	invert_bytes_c (data + i, n_bytes - i);
+}
+
+static const EvPixelOps sse2_ops = {
+	"sse2",
+	swap_red_blue_sse2,
+	rgba_to_argb_premul_sse2,
+	rgb_to_xrgb_c,
+	xor32_sse2,
+	invert_bytes_sse2
+};
+
+#endif /* EV_PIXEL_OPS_SSE2 */
+
+#ifdef EV_PIXEL_OPS_AVX2
+
+#define AVX2 __attribute__ ((__target__ ("avx2")))
+
+static inline AVX2 __m256i
+swap_red_blue_8_avx2 (__m256i p)
+{
+	const __m256i ga = _mm256_set1_epi32 ((gint) 0xff00ff00);
+	const __m256i low = _mm256_set1_epi32 (0xff);
+	__m256i r = _mm256_and_si256 (_mm256_srli_epi32 (p, 16), low);
+	__m256i b = _mm256_slli_epi32 (_mm256_and_si256 (p, low), 16);
+
+	return _mm256_or_si256 (_mm256_and_si256 (p, ga), _mm256_or_si256 (r, b));
+}
+
+static inline AVX2 __m256i
+premul_4_avx2 (__m256i p)
+{
+	const __m256i alpha_lanes = _mm256_set_epi16 (0xff, 0, 0, 0, 0xff, 0, 0, 0,
+						      0xff, 0, 0, 0, 0xff, 0, 0, 0);
+	const __m256i round = _mm256_set1_epi16 (128);
+	__m256i a;
+
+	a = _mm256_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm256_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm256_or_si256 (a, alpha_lanes);
+
+	p = _mm256_add_epi16 (_mm256_mullo_epi16 (p, a), round);
+
+	return _mm256_srli_epi16 (_mm256_add_epi16 (p, _mm256_srli_epi16 (p, 8)), 8);
+}
+
+static AVX2 void
+swap_red_blue_avx2 (const guint32 *src,
+		    guint32       *dest,
+		    gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *) (src + i));
+
+		_mm256_storeu_si256 ((__m256i *) (dest + i), swap_red_blue_8_avx2 (p));
+	}
+
+	swap_red_blue_sse2 (src + i, dest + i, n_pixels - i);
+}
+
+static AVX2 void
+rgba_to_argb_premul_avx2 (const guchar *src,
+			  guint32      *dest,
+			  gsize         n_pixels)
+{
+	const __m256i zero = _mm256_setzero_si256 ();
+	gsize i;
+
+	/* Unpacking and packing both work within 128 bits lanes, so the
+	 * pixels end up back in their original order */
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *) (src + i * 4));
+		__m256i lo, hi;
+
+		p = swap_red_blue_8_avx2 (p);
+		lo = premul_4_avx2 (_mm256_unpacklo_epi8 (p, zero));
+		hi = premul_4_avx2 (_mm256_unpackhi_epi8 (p, zero));
+
+		_mm256_storeu_si256 ((__m256i *) (dest + i), _mm256_packus_epi16 (lo, hi));
+	}
+
+	rgba_to_argb_premul_sse2 (src + i * 4, dest + i, n_pixels - i);
+}
+
+static AVX2 void
+xor32_avx2 (guint32 *pixels,
+	    guint32  mask,
+	    gsize    n_pixels)
+{
+	const __m256i m = _mm256_set1_epi32 ((gint) mask);
+	gsize i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *) (pixels + i));
+
+		_mm256_storeu_si256 ((__m256i *) (pixels + i), _mm256_xor_si256 (p, m));
+	}
+
+	xor32_sse2 (pixels + i, mask, n_pixels - i);
+}
+
+static AVX2 void
+invert_bytes_avx2 (guchar *data,
+		   gsize   n_bytes)
+{
+	const __m256i m = _mm256_set1_epi8 ((gchar) 0xff);
+	gsize i;
+
+	for (i = 0; i + 32 <= n_bytes; i += 32) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *) (data + i));
+
+		_mm256_storeu_si256 ((__m256i *) (data + i), _mm256_xor_si256 (p, m));
+	}
+
+	invert_bytes_sse2 (data + i, n_bytes - i);
+}
+
+static const EvPixelOps avx2_ops = {
+	"avx2",
+	swap_red_blue_avx2,
+	rgba_to_argb_premul_avx2,
+	rgb_to_xrgb_c,
+	xor32_avx2,
+	invert_bytes_avx2
+};
+
+#endif /* EV_PIXEL_OPS_AVX2 */
+
+#ifdef EV_PIXEL_OPS_NEON
+
+/* Same rounding as mul_div_255() */
+static inline uint8x16_t
+mul_div_255_neon (uint8x16_t x,
+		  uint8x16_t a)
+{
+	uint16x8_t lo = vmull_u8 (vget_low_u8 (x), vget_low_u8 (a));
+	uint16x8_t hi = vmull_u8 (vget_high_u8 (x), vget_high_u8 (a));
+
+	return vcombine_u8 (vraddhn_u16 (lo, vrshrq_n_u16 (lo, 8)),
+			    vraddhn_u16 (hi, vrshrq_n_u16 (hi, 8)));
+}
+
+static void
+swap_red_blue_neon (const guint32 *src,
+		    guint32       *dest,
+		    gsize          n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 16 <= n_pixels; i += 16) {
+		uint8x16x4_t p = vld4q_u8 ((const guint8 *) (src + i));
+		uint8x16_t   t = p.val[0];
+
+		p.val[0] = p.val[2];
+		p.val[2] = t;
+		vst4q_u8 ((guint8 *) (dest + i), p);
+	}
+
+	swap_red_blue_c (src + i, dest + i, n_pixels - i);
+}
+
+static void
+rgba_to_argb_premul_neon (const guchar *src,
+			  guint32      *dest,
+			  gsize         n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 16 <= n_pixels; i += 16) {
+		uint8x16x4_t p = vld4q_u8 (src + i * 4);
+		uint8x16x4_t q;
+
+		q.val[0] = mul_div_255_neon (p.val[2], p.val[3]);
+		q.val[1] = mul_div_255_neon (p.val[1], p.val[3]);
+		q.val[2] = mul_div_255_neon (p.val[0], p.val[3]);
+		q.val[3] = p.val[3];
+		vst4q_u8 ((guint8 *) (dest + i), q);
+	}
+
+	rgba_to_argb_premul_c (src + i * 4, dest + i, n_pixels - i);
+}
+
+static void
+rgb_to_xrgb_neon (const guchar *src,
+		  guint32      *dest,
+		  gsize         n_pixels)
+{
+	gsize i;
+
+	for (i = 0; i + 16 <= n_pixels; i += 16) {
+		uint8x16x3_t p = vld3q_u8 (src + i * 3);
+		uint8x16x4_t q;
+
+		q.val[0] = p.val[2];
+		q.val[1] = p.val[1];
+		q.val[2] = p.val[0];
+		q.val[3] = vdupq_n_u8 (0xff);
+		vst4q_u8 ((guint8 *) (dest + i), q);
+	}
+
+	rgb_to_xrgb_c (src + i * 3, dest + i, n_pixels - i);
+}
+
+static void
+xor32_neon (guint32 *pixels,
+	    guint32  mask,
+	    gsize    n_pixels)
+{
+	const uint32x4_t m = vdupq_n_u32 (mask);
+	gsize i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4)
+		vst1q_u32 (pixels + i, veorq_u32 (vld1q_u32 (pixels + i), m));
+
+	xor32_c (pixels + i, mask, n_pixels - i);
+}
+
+static void
+invert_bytes_neon (guchar *data,
+		   gsize   n_bytes)
+{
+	gsize i;
+
+	for (i = 0; i + 16 <= n_bytes; i += 16)
+		vst1q_u8 (data + i, vmvnq_u8 (vld1q_u8 (data + i)));
+
+	invert_bytes_c (data + i, n_bytes - i);
+}
+
+static const EvPixelOps neon_ops = {
+	"neon",
+	swap_red_blue_neon,
+	rgba_to_argb_premul_neon,
+	rgb_to_xrgb_neon,
+	xor32_neon,
+	invert_bytes_neon
+};
+
+#endif /* EV_PIXEL_OPS_NEON */
+
+static const EvPixelOps *pixel_ops = NULL;
+
+#ifdef EV_PIXEL_OPS_AVX2
+static gboolean
+cpu_supports_avx2 (void)
+{
+	__builtin_cpu_init ();
+
+	return __builtin_cpu_supports ("avx2");
+}
+#endif
+
+static const EvPixelOps *
+get_pixel_ops (void)
+{
+	if (g_once_init_enter (&pixel_ops)) {
+		const EvPixelOps *best = &c_ops;
+
+#ifdef EV_PIXEL_OPS_SSE2
+		best = &sse2_ops;
+#endif
+#ifdef EV_PIXEL_OPS_AVX2
+		if (cpu_supports_avx2 ())
+			best = &avx2_ops;
+#endif
+#ifdef EV_PIXEL_OPS_NEON
+		best = &neon_ops;
+#endif
+		g_once_init_leave (&pixel_ops, best);
+	}
+
+	return pixel_ops;
+}
+
+void
+ev_pixel_ops_swap_red_blue (const guint32 *src,
+			    guint32       *dest,
+			    gsize          n_pixels)
+{
+	get_pixel_ops ()->swap_red_blue (src, dest, n_pixels);
+}
+
+void
+ev_pixel_ops_rgba_to_argb_premul (const guchar *src,
+				  guint32      *dest,
+				  gsize         n_pixels)
+{
+	get_pixel_ops ()->rgba_to_argb_premul (src, dest, n_pixels);
+}
+
+void
+ev_pixel_ops_rgb_to_xrgb (const guchar *src,
+			  guint32      *dest,
+			  gsize         n_pixels)
+{
+	get_pixel_ops ()->rgb_to_xrgb (src, dest, n_pixels);
+}
+
+void
+ev_pixel_ops_xor32 (guint32 *pixels,
+		    guint32  mask,
+		    gsize    n_pixels)
+{
+	get_pixel_ops ()->xor32 (pixels, mask, n_pixels);
+}
+
+void
+ev_pixel_ops_invert_bytes (guchar *data,
+			   gsize   n_bytes)
+{
+	get_pixel_ops ()->invert_bytes (data, n_bytes);
+}
+
+void
+ev_pixel_ops_fill (guint32 *pixels,
+		   guint32  color,
+		   gsize    n_pixels)
+{
+	gsize i;
+
+	/* Simple enough for the compiler to vectorize on its own */
+	for (i = 0; i < n_pixels; i++)
+		pixels[i] = color;
+}
+
+const gchar *
+ev_pixel_ops_get_implementation (void)
+{
+	return get_pixel_ops ()->name;
+}
+
+gboolean
+ev_pixel_ops_set_implementation (const gchar *name)
+{
+	const EvPixelOps *ops = NULL;
+
+	g_return_val_if_fail (name != NULL, FALSE);
+
+	if (g_str_equal (name, c_ops.name))
+		ops = &c_ops;
+#ifdef EV_PIXEL_OPS_SSE2
+	else if (g_str_equal (name, sse2_ops.name))
+		ops = &sse2_ops;
+#endif
+#ifdef EV_PIXEL_OPS_AVX2
+	else if (g_str_equal (name, avx2_ops.name) && cpu_supports_avx2 ())
+		ops = &avx2_ops;
+#endif
+#ifdef EV_PIXEL_OPS_NEON
+	else if (g_str_equal (name, neon_ops.name))
+		ops = &neon_ops;
+#endif
+
+	if (!ops)
+		return FALSE;
+
+	/* Don't let the first conversion pick the best one again */
+	get_pixel_ops ();
+	g_atomic_pointer_set (&pixel_ops, ops);
+
+	return TRUE;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <glib.h>
+
+#include "ev-macros.h"
+
+G_BEGIN_DECLS
+
+/* Pixel format conversions used by the raster backends. They all work
+ * on a single row of @n_pixels pixels; 32 bits pixels are in native
+ * endianness, like cairo image surfaces, and byte formats are in memory
+ * order, like GdkPixbuf. The source and destination rows may be the
+ * same for the conversions that don't change the pixel size.
+ */
+
+/* Swaps the red and blue channels: ABGR, as returned by libtiff, to
+ * cairo's ARGB and back */
+EV_PRIVATE
+void ev_pixel_ops_swap_red_blue        (const guint32 *src,
+					guint32       *dest,
+					gsize          n_pixels);
+
+/* Non premultiplied RGBA bytes to premultiplied cairo ARGB32 */
+EV_PRIVATE
+void ev_pixel_ops_rgba_to_argb_premul  (const guchar  *src,
+					guint32       *dest,
+					gsize          n_pixels);
+
+/* RGB bytes to cairo RGB24 */
+EV_PRIVATE
+void ev_pixel_ops_rgb_to_xrgb          (const guchar  *src,
+					guint32       *dest,
+					gsize          n_pixels);
+
+/* XORs every pixel with @mask, which inverts the channels set in it */
+EV_PRIVATE
+void ev_pixel_ops_xor32                (guint32       *pixels,
+					guint32        mask,
+					gsize          n_pixels);
+
+/* Inverts every byte of @data, which is how packed RGB is inverted */
+EV_PRIVATE
+void ev_pixel_ops_invert_bytes         (guchar        *data,
+					gsize          n_bytes);
+
+/* Fills @pixels with @color */
+EV_PRIVATE
+void ev_pixel_ops_fill                 (guint32       *pixels,
+					guint32        color,
+					gsize          n_pixels);
+
+/* The name of the implementation chosen for this CPU, for debugging */
+EV_PRIVATE
+const gchar *ev_pixel_ops_get_implementation (void);
+
+/* Makes all the conversions use the implementation @name, which is
+ * meant for tests and benchmarks. Returns %FALSE when it isn't
+ * available in this build or on this CPU */
+EV_PRIVATE
+gboolean     ev_pixel_ops_set_implementation (const gchar *name);
+
+G_END_DECLS
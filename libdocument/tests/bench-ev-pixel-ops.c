@@ -0,0 +1,126 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Measures every pixel conversion with each implementation available
+ * on this CPU, on rows as wide as an A4 page rendered at 300 dpi */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "ev-pixel-ops.h"
+
+#define ROW_PIXELS 2480
+#define N_ROWS     3508
+
+static const gchar *implementations[] = { "c", "sse2", "avx2", "neon" };
+
+typedef enum {
+	KERNEL_SWAP_RED_BLUE,
+	KERNEL_RGBA_TO_ARGB_PREMUL,
+	KERNEL_RGB_TO_XRGB,
+	KERNEL_XOR32,
+	KERNEL_INVERT_BYTES,
+	N_KERNELS
+} Kernel;
+
+static const gchar *kernel_names[] = {
+	"swap_red_blue",
+	"rgba_to_argb_premul",
+	"rgb_to_xrgb",
+	"xor32",
+	"invert_bytes"
+};
+
+static void
+run_kernel (Kernel   kernel,
+	    guchar  *src,
+	    guint32 *dest)
+{
+	switch (kernel) {
+	case KERNEL_SWAP_RED_BLUE:
+		ev_pixel_ops_swap_red_blue ((guint32 *)src, dest, ROW_PIXELS);
+		break;
+	case KERNEL_RGBA_TO_ARGB_PREMUL:
+		ev_pixel_ops_rgba_to_argb_premul (src, dest, ROW_PIXELS);
+		break;
+	case KERNEL_RGB_TO_XRGB:
+		ev_pixel_ops_rgb_to_xrgb (src, dest, ROW_PIXELS);
+		break;
+	case KERNEL_XOR32:
+		ev_pixel_ops_xor32 (dest, 0x00ffffff, ROW_PIXELS);
+		break;
+	case KERNEL_INVERT_BYTES:
+		ev_pixel_ops_invert_bytes ((guchar *)dest, ROW_PIXELS * 3);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	guchar  *src;
+	guint32 *dest;
+	gint     n_runs = 5;
+	guint    i, k;
+	gint     run, row;
+
+	if (argc > 1)
+		n_runs = MAX (atoi (argv[1]), 1);
+
+	src = g_malloc (ROW_PIXELS * 4);
+	dest = g_malloc (ROW_PIXELS * 4);
+	for (i = 0; i < ROW_PIXELS * 4; i++)
+		src[i] = g_random_int_range (0, 256);
+	memset (dest, 0, ROW_PIXELS * 4);
+
+	g_print ("Default implementation: %s\n", ev_pixel_ops_get_implementation ());
+	g_print ("%-22s%-8s%12s\n", "kernel", "impl", "Mpixels/s");
+
+	for (k = 0; k < N_KERNELS; k++) {
+		for (i = 0; i < G_N_ELEMENTS (implementations); i++) {
+			gint64 best = G_MAXINT64;
+
+			if (!ev_pixel_ops_set_implementation (implementations[i]))
+				continue;
+
+			/* Keep the fastest of the runs, the others
+			 * are the ones disturbed by something else */
+			for (run = 0; run < n_runs; run++) {
+				gint64 start = g_get_monotonic_time ();
+
+				for (row = 0; row < N_ROWS; row++)
+					run_kernel (k, src, dest);
+
+				best = MIN (best, g_get_monotonic_time () - start);
+			}
+
+			g_print ("%-22s%-8s%12.1f\n", kernel_names[k], implementations[i],
+				 (gdouble)ROW_PIXELS * N_ROWS / MAX (best, 1));
+		}
+	}
+
+	g_free (src);
+	g_free (dest);
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "ev-pixel-ops.h"
+
+/* Long enough to go through the vector loops a few times and
+ * through the left over pixels with every remainder */
+#define MAX_PIXELS 133
+
+static const gchar *vector_implementations[] = { "sse2", "avx2", "neon" };
+
+static guchar input[(MAX_PIXELS + 1) * 4];
+
+static void
+fill_input (void)
+{
+	GRand *rand = g_rand_new_with_seed (46);
+	guint  i;
+
+	for (i = 0; i < sizeof (input); i++)
+		input[i] = g_rand_int_range (rand, 0, 256);
+
+	/* Make sure the alpha values that are special cased show up */
+	for (i = 3; i + 4 < sizeof (input); i += 16) {
+		input[i] = 0;
+		input[i + 4] = 0xff;
+	}
+
+	g_rand_free (rand);
+}
+
+/* Runs the conversions on every length up to MAX_PIXELS, starting on
+ * an aligned and on an unaligned pixel, and returns all the results */
+static GByteArray *
+run_pixel_ops (void)
+{
+	GByteArray *output = g_byte_array_new ();
+	guint32     src[MAX_PIXELS + 1];
+	guint32     dest[MAX_PIXELS + 1];
+	guchar      bytes[(MAX_PIXELS + 1) * 4];
+	gsize       start, n;
+
+	memcpy (src, input, sizeof (src));
+
+	for (start = 0; start <= 1; start++) {
+		for (n = 0; n <= MAX_PIXELS; n++) {
+			memset (dest, 0, sizeof (dest));
+			ev_pixel_ops_swap_red_blue (src + start, dest + start, n);
+			g_byte_array_append (output, (guchar *)dest, sizeof (dest));
+
+			memcpy (dest, src, sizeof (dest));
+			ev_pixel_ops_swap_red_blue (dest + start, dest + start, n);
+			g_byte_array_append (output, (guchar *)dest, sizeof (dest));
+
+			memset (dest, 0, sizeof (dest));
+			ev_pixel_ops_rgba_to_argb_premul (input + start, dest + start, n);
+			g_byte_array_append (output, (guchar *)dest, sizeof (dest));
+
+			memset (dest, 0, sizeof (dest));
+			ev_pixel_ops_rgb_to_xrgb (input + start, dest + start, n);
+			g_byte_array_append (output, (guchar *)dest, sizeof (dest));
+
+			memcpy (dest, src, sizeof (dest));
+			ev_pixel_ops_xor32 (dest + start, 0x00ffffff, n);
+			g_byte_array_append (output, (guchar *)dest, sizeof (dest));
+
+			memcpy (bytes, input, sizeof (bytes));
+			ev_pixel_ops_invert_bytes (bytes + start, n * 3);
+			g_byte_array_append (output, bytes, sizeof (bytes));
+		}
+	}
+
+	return output;
+}
+
+static void
+test_pixel_ops_c (void)
+{
+	const guchar rgba[] = { 0x20, 0x40, 0x80, 0x80,
+				0x20, 0x40, 0x80, 0x00,
+				0x20, 0x40, 0x80, 0xff };
+	const guchar rgb[] = { 0x20, 0x40, 0x80 };
+	guint32      pixels[3];
+
+	g_assert_true (ev_pixel_ops_set_implementation ("c"));
+
+	ev_pixel_ops_rgba_to_argb_premul (rgba, pixels, 3);
+	g_assert_cmphex (pixels[0], ==, 0x80102040);
+	g_assert_cmphex (pixels[1], ==, 0x00000000);
+	g_assert_cmphex (pixels[2], ==, 0xff204080);
+
+	ev_pixel_ops_rgb_to_xrgb (rgb, pixels, 1);
+	g_assert_cmphex (pixels[0], ==, 0xff204080);
+
+	ev_pixel_ops_swap_red_blue (pixels, pixels, 1);
+	g_assert_cmphex (pixels[0], ==, 0xff804020);
+
+	ev_pixel_ops_xor32 (pixels, 0x00ffffff, 1);
+	g_assert_cmphex (pixels[0], ==, 0xff7fbfdf);
+}
+
+static void
+test_pixel_ops_vector (void)
+{
+	GByteArray *expected;
+	guint       i;
+
+	g_assert_true (ev_pixel_ops_set_implementation ("c"));
+	expected = run_pixel_ops ();
+
+	for (i = 0; i < G_N_ELEMENTS (vector_implementations); i++) {
+		GByteArray *output;
+
+		if (!ev_pixel_ops_set_implementation (vector_implementations[i]))
+			continue;
+
+		g_test_message ("Comparing the %s implementation", vector_implementations[i]);
+
+		output = run_pixel_ops ();
+		g_assert_cmpuint (output->len, ==, expected->len);
+		g_assert_true (memcmp (output->data, expected->data, expected->len) == 0);
+		g_byte_array_unref (output);
+	}
+
+	g_byte_array_unref (expected);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	fill_input ();
+
+	g_test_add_func ("/pixel-ops/c", test_pixel_ops_c);
+	g_test_add_func ("/pixel-ops/vector", test_pixel_ops_vector);
+
+	return g_test_run ();
+}
@@ -18,14 +18,36 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
+
 #include "ev-debug.h"
 #include "ev-job-scheduler.h"
+#include "ev-surface-cache.h"
+
+typedef struct _EvSchedulerJob EvSchedulerJob;
+
+struct _EvSchedulerJob {
+	EvJob          *job;
+	EvJobPriority   priority;
+	EvJobPriority   queue_priority;
+	EvJobCategory   category;
+	gint64          queued_time;
+	GSList         *job_link;
+
+	/* Identical render jobs are run only once: the first one pushed
+	 * is the leader, and the others wait for its result attached to
+	 * it as followers. Protected by job_queue_mutex. */
+	EvSchedulerJob *leader;
+	GList          *followers;
+};
 
-typedef struct _EvSchedulerJob {
-	EvJob         *job;
-	EvJobPriority  priority;
-	GSList        *job_link;
-} EvSchedulerJob;
+/* Jobs waiting for longer than this are run first, whatever their
+ * category and priority are, but never before the urgent renders of
+ * the views. Once such a job has run, at least STARVATION_INTERVAL
+ * jobs are taken in the usual order before the next one, so that a
+ * batch of jobs that aged together doesn't hold the views back. */
+#define STARVATION_TIMEOUT  1000000 /* us */
+#define STARVATION_INTERVAL 4
 
 G_LOCK_DEFINE_STATIC(job_list);
 static GSList *job_list = NULL;
@@ -36,50 +58,337 @@ static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 						   GCancellable   *cancellable);
 
-/* EvJobQueue */
-static GQueue queue_urgent = G_QUEUE_INIT;
-static GQueue queue_high = G_QUEUE_INIT;
-static GQueue queue_low = G_QUEUE_INIT;
-static GQueue queue_none = G_QUEUE_INIT;
+/* EvJobQueue: one queue per priority for every job category. The
+ * queues and the stats are protected by job_queue_mutex. */
+static GQueue job_queue[EV_JOB_N_CATEGORIES][EV_JOB_N_PRIORITIES];
+static EvJobSchedulerStats job_stats[EV_JOB_N_CATEGORIES];
 static GCond job_queue_cond;
 static GMutex job_queue_mutex;
+static EvSchedulerJob *running_s_job = NULL;
+static guint n_jobs_since_starving = STARVATION_INTERVAL;
 
-static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
-	&queue_urgent,
-	&queue_high,
-	&queue_low,
-	&queue_none
-};
+static void
+ev_job_queue_push_unlocked (EvSchedulerJob *job,
+			    EvJobPriority   priority)
+{
+	EvJobSchedulerStats *stats = &job_stats[job->category];
+
+	g_queue_push_tail (&job_queue[job->category][priority], job);
+	job->queue_priority = priority;
+
+	stats->queue_depth++;
+	stats->max_queue_depth = MAX (stats->max_queue_depth, stats->queue_depth);
+}
+
+static gboolean
+ev_job_queue_remove_unlocked (EvSchedulerJob *job)
+{
+	if (!g_queue_remove (&job_queue[job->category][job->queue_priority], job))
+		return FALSE;
+
+	job_stats[job->category].queue_depth--;
+
+	return TRUE;
+}
 
 static void
 ev_job_queue_push (EvSchedulerJob *job,
 		   EvJobPriority   priority)
 {
-	ev_debug_message (DEBUG_JOBS, "%s priority %d", EV_GET_TYPE_NAME (job->job), priority);
+	ev_debug_message (DEBUG_JOBS, "%s category %d priority %d",
+			  EV_GET_TYPE_NAME (job->job), job->category, priority);
 
 	g_mutex_lock (&job_queue_mutex);
 
-	g_queue_push_tail (job_queue[priority], job);
+	job->queued_time = g_get_monotonic_time ();
+	ev_job_queue_push_unlocked (job, priority);
 	g_cond_broadcast (&job_queue_cond);
 
 	g_mutex_unlock (&job_queue_mutex);
 }
 
+/* Returns the job that has been waiting the longest, if it has been
+ * waiting for more than STARVATION_TIMEOUT, so that jobs of the lower
+ * categories make progress while the views keep preloading pages */
+static EvSchedulerJob *
+ev_job_queue_get_starving_unlocked (void)
+{
+	GQueue *oldest_queue = NULL;
+	gint64  oldest_time = G_MAXINT64;
+	gint    i, j;
+
+	if (n_jobs_since_starving < STARVATION_INTERVAL ||
+	    !g_queue_is_empty (&job_queue[EV_JOB_CATEGORY_VIEW][EV_JOB_PRIORITY_URGENT]))
+		return NULL;
+
+	for (i = EV_JOB_CATEGORY_VIEW; i < EV_JOB_N_CATEGORIES; i++) {
+		for (j = EV_JOB_PRIORITY_URGENT; j < EV_JOB_N_PRIORITIES; j++) {
+			EvSchedulerJob *job = g_queue_peek_head (&job_queue[i][j]);
+
+			if (job && job->queued_time < oldest_time) {
+				oldest_time = job->queued_time;
+				oldest_queue = &job_queue[i][j];
+			}
+		}
+	}
+
+	if (!oldest_queue || g_get_monotonic_time () - oldest_time < STARVATION_TIMEOUT)
+		return NULL;
+
+	return (EvSchedulerJob *) g_queue_pop_head (oldest_queue);
+}
+
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
+{
+	gint i, j;
+	EvSchedulerJob *job;
+	gboolean starving;
+
+	job = ev_job_queue_get_starving_unlocked ();
+	starving = job != NULL;
+
+	/* Urgent jobs of any category go first */
+	for (i = EV_JOB_CATEGORY_VIEW; i < EV_JOB_N_CATEGORIES && !job; i++)
+		job = (EvSchedulerJob *) g_queue_pop_head (&job_queue[i][EV_JOB_PRIORITY_URGENT]);
+
+	for (i = EV_JOB_CATEGORY_VIEW; i < EV_JOB_N_CATEGORIES && !job; i++) {
+		for (j = EV_JOB_PRIORITY_HIGH; j < EV_JOB_N_PRIORITIES; j++) {
+			job = (EvSchedulerJob *) g_queue_pop_head (&job_queue[i][j]);
+			if (job)
+				break;
+		}
+	}
+
+	if (job) {
+		EvJobSchedulerStats *stats = &job_stats[job->category];
+		gint64               wait_time;
+
+		wait_time = g_get_monotonic_time () - job->queued_time;
+		n_jobs_since_starving = starving ? 0 : MIN (n_jobs_since_starving + 1, STARVATION_INTERVAL);
+		stats->queue_depth--;
+		stats->n_jobs++;
+		stats->total_wait_time += wait_time;
+		stats->max_wait_time = MAX (stats->max_wait_time, wait_time);
+
+		ev_debug_message (DEBUG_JOBS, "%s waited %" G_GINT64_FORMAT " us",
+				  EV_GET_TYPE_NAME (job->job), wait_time);
+	} else {
+		ev_debug_message (DEBUG_JOBS, "No jobs in queue");
+	}
+
+	return job;
+}
+
+/* The priority a leader is queued with: the most urgent of its own
+ * and the ones of the jobs waiting for its result */
+static EvJobPriority
+ev_scheduler_job_get_priority_unlocked (EvSchedulerJob *job)
+{
+	EvJobPriority priority = job->priority;
+	GList        *l;
+
+	for (l = job->followers; l; l = l->next) {
+		EvSchedulerJob *follower = (EvSchedulerJob *)l->data;
+
+		priority = MIN (priority, follower->priority);
+	}
+
+	return priority;
+}
+
+static gboolean
+ev_scheduler_job_can_be_coalesced (EvJob *job)
+{
+	/* The selection depends on the requester, so only plain renders
+	 * are shared */
+	if (EV_IS_JOB_RENDER (job))
+		return !EV_JOB_RENDER (job)->include_selection;
+
+	return EV_IS_JOB_THUMBNAIL (job);
+}
+
+static gboolean
+ev_scheduler_jobs_are_equivalent (EvJob *a,
+				  EvJob *b)
+{
+	if (G_OBJECT_TYPE (a) != G_OBJECT_TYPE (b) || a->document != b->document)
+		return FALSE;
+
+	if (EV_IS_JOB_RENDER (a)) {
+		EvJobRender *ra = EV_JOB_RENDER (a);
+		EvJobRender *rb = EV_JOB_RENDER (b);
+
+		return ra->page == rb->page &&
+			ra->rotation == rb->rotation &&
+			ra->scale == rb->scale &&
+			ra->target_width == rb->target_width &&
+			ra->target_height == rb->target_height &&
+			ra->has_area == rb->has_area &&
+			(!ra->has_area ||
+			 (ra->area.x == rb->area.x &&
+			  ra->area.y == rb->area.y &&
+			  ra->area.width == rb->area.width &&
+			  ra->area.height == rb->area.height)) &&
+			!ra->include_selection && !rb->include_selection;
+	}
+
+	if (EV_IS_JOB_THUMBNAIL (a)) {
+		EvJobThumbnail *ta = EV_JOB_THUMBNAIL (a);
+		EvJobThumbnail *tb = EV_JOB_THUMBNAIL (b);
+
+		return ta->page == tb->page &&
+			ta->rotation == tb->rotation &&
+			ta->scale == tb->scale &&
+			ta->target_width == tb->target_width &&
+			ta->target_height == tb->target_height &&
+			ta->format == tb->format &&
+			ta->has_frame == tb->has_frame;
+	}
+
+	return FALSE;
+}
+
+/* Looks for a queued or running job rendering the same as @job */
+static EvSchedulerJob *
+ev_job_queue_find_leader_unlocked (EvSchedulerJob *job)
 {
 	gint i;
-	EvSchedulerJob *job = NULL;
+
+	if (!ev_scheduler_job_can_be_coalesced (job->job))
+		return NULL;
+
+	if (running_s_job &&
+	    !g_cancellable_is_cancelled (running_s_job->job->cancellable) &&
+	    ev_scheduler_jobs_are_equivalent (running_s_job->job, job->job))
+		return running_s_job;
 
 	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
-			break;
+		GList *l;
+
+		for (l = job_queue[job->category][i].head; l; l = l->next) {
+			EvSchedulerJob *leader = (EvSchedulerJob *)l->data;
+
+			if (ev_scheduler_jobs_are_equivalent (leader->job, job->job))
+				return leader;
+		}
 	}
 
-	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
+	return NULL;
+}
 
-	return job;
+/* Makes the first follower of @job the leader of the others and queues
+ * it, because @job was cancelled before producing its result */
+static void
+ev_scheduler_job_promote_follower_unlocked (EvSchedulerJob *job)
+{
+	EvSchedulerJob *leader;
+	GList          *l;
+
+	if (!job->followers)
+		return;
+
+	leader = (EvSchedulerJob *)job->followers->data;
+	leader->leader = NULL;
+	leader->followers = g_list_delete_link (job->followers, job->followers);
+	job->followers = NULL;
+
+	for (l = leader->followers; l; l = l->next) {
+		EvSchedulerJob *follower = (EvSchedulerJob *)l->data;
+
+		follower->leader = leader;
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%s (%p) takes over %s (%p)",
+			  EV_GET_TYPE_NAME (leader->job), leader->job,
+			  EV_GET_TYPE_NAME (job->job), job->job);
+
+	leader->queued_time = g_get_monotonic_time ();
+	ev_job_queue_push_unlocked (leader, ev_scheduler_job_get_priority_unlocked (leader));
+	g_cond_broadcast (&job_queue_cond);
+}
+
+/* The result of a leader handed over to one of its followers. The
+ * surfaces are only referenced in the worker thread, and copied in the
+ * main thread, where the requesters of the leader may be using them */
+typedef struct {
+	EvJob           *job;
+	cairo_surface_t *surface;
+	GdkPixbuf       *thumbnail;
+} EvSharedResult;
+
+static void
+ev_shared_result_free (EvSharedResult *result)
+{
+	g_object_unref (result->job);
+	g_clear_pointer (&result->surface, cairo_surface_destroy);
+	g_clear_object (&result->thumbnail);
+	g_free (result);
+}
+
+/* Requesters modify the surfaces they get, setting their device scale
+ * for example, so every follower gets its own copy */
+static gboolean
+ev_shared_result_copy (EvSharedResult *result)
+{
+	EvJob *job = result->job;
+
+	if (job->cancelled)
+		return G_SOURCE_REMOVE;
+
+	if (EV_IS_JOB_RENDER (job)) {
+		EvJobRender *dest = EV_JOB_RENDER (job);
+
+		dest->surface = ev_surface_cache_copy_surface (result->surface, FALSE);
+	} else if (EV_IS_JOB_THUMBNAIL (job)) {
+		EvJobThumbnail *dest = EV_JOB_THUMBNAIL (job);
+
+		if (result->thumbnail)
+			dest->thumbnail = gdk_pixbuf_copy (result->thumbnail);
+		dest->thumbnail_surface = ev_surface_cache_copy_surface (result->surface, FALSE);
+	}
+
+	ev_job_succeeded (job);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+ev_scheduler_job_share_result (EvSchedulerJob *leader,
+			       EvSchedulerJob *follower)
+{
+	EvJob          *job = follower->job;
+	EvSharedResult *result;
+
+	ev_debug_message (DEBUG_JOBS, "%s (%p) gets the result of %p",
+			  EV_GET_TYPE_NAME (job), job, leader->job);
+
+	if (leader->job->failed) {
+		ev_job_failed_from_error (job, leader->job->error);
+		return;
+	}
+
+	result = g_new0 (EvSharedResult, 1);
+	result->job = g_object_ref (job);
+
+	if (EV_IS_JOB_RENDER (job)) {
+		EvJobRender *src = EV_JOB_RENDER (leader->job);
+
+		if (src->surface)
+			result->surface = cairo_surface_reference (src->surface);
+	} else if (EV_IS_JOB_THUMBNAIL (job)) {
+		EvJobThumbnail *src = EV_JOB_THUMBNAIL (leader->job);
+
+		if (src->thumbnail)
+			result->thumbnail = g_object_ref (src->thumbnail);
+		if (src->thumbnail_surface)
+			result->surface = cairo_surface_reference (src->thumbnail_surface);
+	}
+
+	g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+			 (GSourceFunc)ev_shared_result_copy,
+			 result,
+			 (GDestroyNotify)ev_shared_result_free);
 }
 
 static gpointer
@@ -148,20 +457,29 @@ static void
 ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 				   GCancellable   *cancellable)
 {
-	GList   *list;
-
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 
 	g_mutex_lock (&job_queue_mutex);
 
+	/* A job waiting for the result of another one just stops
+	 * waiting, without affecting the job it was attached to.
+	 */
+	if (job->leader) {
+		job->leader->followers = g_list_remove (job->leader->followers, job);
+		job->leader = NULL;
+		g_mutex_unlock (&job_queue_mutex);
+		ev_scheduler_job_destroy (job);
+		return;
+	}
+
 	/* If the job is not still running,
-	 * remove it from the job queue and job list.
+	 * remove it from the job queue and job list,
+	 * handing it over to the jobs waiting for it.
 	 * If the job is currently running, it will be
 	 * destroyed as soon as it finishes.
 	 */
-	list = g_queue_find (job_queue[job->priority], job);
-	if (list) {
-		g_queue_delete_link (job_queue[job->priority], list);
+	if (ev_job_queue_remove_unlocked (job)) {
+		ev_scheduler_job_promote_follower_unlocked (job);
 		g_mutex_unlock (&job_queue_mutex);
 		ev_scheduler_job_destroy (job);
 	} else {
@@ -169,23 +487,22 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	}
 }
 
-static void
+/* Returns %TRUE if the job has to be run again */
+static gboolean
 ev_job_thread (EvJob *job)
 {
-	gboolean result;
+	gboolean result = FALSE;
 
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job));
 
-	do {
-		if (g_cancellable_is_cancelled (job->cancellable))
-			result = FALSE;
-		else {
-                        g_atomic_pointer_set (&running_job, job);
-			result = ev_job_run (job);
-                }
-	} while (result);
+	if (!g_cancellable_is_cancelled (job->cancellable)) {
+                g_atomic_pointer_set (&running_job, job);
+		result = ev_job_run (job);
+        }
 
         g_atomic_pointer_set (&running_job, NULL);
+
+	return result;
 }
 
 static gboolean
@@ -204,6 +521,9 @@ ev_job_thread_proxy (gpointer data)
 {
 	while (TRUE) {
 		EvSchedulerJob *job;
+		GList          *followers, *l;
+		gint64          start_time;
+		gboolean        run_again;
 
 		g_mutex_lock (&job_queue_mutex);
 		job = ev_job_queue_get_next_unlocked ();
@@ -212,15 +532,89 @@ ev_job_thread_proxy (gpointer data)
 			g_mutex_unlock (&job_queue_mutex);
 			continue;
 		}
+		running_s_job = job;
+		g_mutex_unlock (&job_queue_mutex);
+
+		start_time = g_get_monotonic_time ();
+		run_again = ev_job_thread (job->job);
+
+		g_mutex_lock (&job_queue_mutex);
+		job_stats[job->category].total_run_time += g_get_monotonic_time () - start_time;
+		running_s_job = NULL;
+
+		/* Jobs that have to run again go back to the queue, so that
+		 * a long job split in several runs doesn't delay the jobs
+		 * with a higher priority that were pushed meanwhile */
+		if (run_again) {
+			job->queued_time = g_get_monotonic_time ();
+			ev_job_queue_push_unlocked (job, ev_scheduler_job_get_priority_unlocked (job));
+			g_mutex_unlock (&job_queue_mutex);
+			continue;
+		}
+
+		/* Without a result, because it was cancelled, the job
+		 * is run again for the jobs waiting for it */
+		if (!ev_job_is_finished (job->job))
+			ev_scheduler_job_promote_follower_unlocked (job);
+
+		followers = job->followers;
+		job->followers = NULL;
+		for (l = followers; l; l = l->next) {
+			EvSchedulerJob *follower = (EvSchedulerJob *)l->data;
+
+			follower->leader = NULL;
+		}
 		g_mutex_unlock (&job_queue_mutex);
 
-		ev_job_thread (job->job);
+		for (l = followers; l; l = l->next) {
+			EvSchedulerJob *follower = (EvSchedulerJob *)l->data;
+
+			ev_scheduler_job_share_result (job, follower);
+			ev_scheduler_job_destroy (follower);
+		}
+		g_list_free (followers);
+
 		ev_scheduler_job_destroy (job);
 	}
 
 	return NULL;
 }
 
+/* Attaches @job to an identical job that is queued or running, if
+ * any, so that it gets the result of that one instead of rendering
+ * the same again */
+static gboolean
+ev_scheduler_job_attach (EvSchedulerJob *job)
+{
+	EvSchedulerJob *leader;
+
+	g_mutex_lock (&job_queue_mutex);
+
+	leader = ev_job_queue_find_leader_unlocked (job);
+	if (!leader) {
+		g_mutex_unlock (&job_queue_mutex);
+		return FALSE;
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%s (%p) attached to %p",
+			  EV_GET_TYPE_NAME (job->job), job->job, leader->job);
+
+	job->leader = leader;
+	leader->followers = g_list_append (leader->followers, job);
+	job_stats[job->category].n_coalesced++;
+
+	/* The leader runs as soon as the most urgent job waiting for it */
+	if (job->priority < leader->queue_priority &&
+	    ev_job_queue_remove_unlocked (leader)) {
+		ev_job_queue_push_unlocked (leader, job->priority);
+		g_cond_broadcast (&job_queue_cond);
+	}
+
+	g_mutex_unlock (&job_queue_mutex);
+
+	return TRUE;
+}
+
 void
 ev_job_scheduler_push_job (EvJob         *job,
 			   EvJobPriority  priority)
@@ -235,6 +629,7 @@ ev_job_scheduler_push_job (EvJob         *job,
 	s_job = g_new0 (EvSchedulerJob, 1);
 	s_job->job = g_object_ref (job);
 	s_job->priority = priority;
+	s_job->category = ev_job_scheduler_get_job_category (job);
 
 	ev_scheduler_job_list_add (s_job);
 
@@ -243,7 +638,8 @@ ev_job_scheduler_push_job (EvJob         *job,
 		g_signal_connect_swapped (job->cancellable, "cancelled",
 					  G_CALLBACK (ev_scheduler_thread_job_cancelled),
 					  s_job);
-		ev_job_queue_push (s_job, priority);
+		if (!ev_scheduler_job_attach (s_job))
+			ev_job_queue_push (s_job, priority);
 		break;
 	case EV_JOB_RUN_MAIN_LOOP:
 		g_signal_connect_swapped (job, "finished",
@@ -290,16 +686,22 @@ ev_job_scheduler_update_job (EvJob         *job,
 	G_UNLOCK (job_list);
 
 	if (need_resort) {
-		GList *list;
+		EvSchedulerJob *leader;
+		EvJobPriority   queue_priority;
 
 		g_mutex_lock (&job_queue_mutex);
 
-		list = g_queue_find (job_queue[s_job->priority], s_job);
-		if (list) {
+		s_job->priority = priority;
+
+		/* Jobs attached to another one move the one they wait for */
+		leader = s_job->leader ? s_job->leader : s_job;
+		queue_priority = ev_scheduler_job_get_priority_unlocked (leader);
+		if (queue_priority != leader->queue_priority &&
+		    ev_job_queue_remove_unlocked (leader)) {
 			ev_debug_message (DEBUG_JOBS, "Moving job %s from priority %d to %d",
-					  EV_GET_TYPE_NAME (job), s_job->priority, priority);
-			g_queue_delete_link (job_queue[s_job->priority], list);
-			g_queue_push_tail (job_queue[priority], s_job);
+					  EV_GET_TYPE_NAME (leader->job), leader->queue_priority,
+					  queue_priority);
+			ev_job_queue_push_unlocked (leader, queue_priority);
 			g_cond_broadcast (&job_queue_cond);
 		}
 
@@ -334,3 +736,78 @@ ev_job_scheduler_wait (void)
 
 	ev_debug_message (DEBUG_JOBS, "Job list is empty");
 }
+
+/**
+ * ev_job_scheduler_get_job_category:
+ * @job: an #EvJob
+ *
+ * Returns: the #EvJobCategory @job is scheduled with. Renders of the
+ *   views and the jobs the user is waiting for, like loading, saving,
+ *   searching or printing, are scheduled before thumbnails, and both
+ *   before any other job.
+ *
+ * Since: 46.0
+ */
+EvJobCategory
+ev_job_scheduler_get_job_category (EvJob *job)
+{
+	g_return_val_if_fail (EV_IS_JOB (job), EV_JOB_CATEGORY_BACKGROUND);
+
+	if (EV_IS_JOB_RENDER (job) || EV_IS_JOB_PAGE_DATA (job) ||
+	    EV_IS_JOB_LOAD (job) || EV_IS_JOB_LOAD_STREAM (job) ||
+	    EV_IS_JOB_LOAD_GFILE (job) || EV_IS_JOB_LOAD_FD (job) ||
+	    EV_IS_JOB_SAVE (job) || EV_IS_JOB_FIND (job) ||
+	    EV_IS_JOB_PRINT (job) || EV_IS_JOB_EXPORT (job))
+		return EV_JOB_CATEGORY_VIEW;
+	if (EV_IS_JOB_THUMBNAIL (job))
+		return EV_JOB_CATEGORY_THUMBNAIL;
+
+	return EV_JOB_CATEGORY_BACKGROUND;
+}
+
+/**
+ * ev_job_scheduler_get_stats:
+ * @category: an #EvJobCategory
+ * @stats: (out caller-allocates): return location for the stats
+ *
+ * Fills @stats with the queue depth, wait time and run time counters of
+ * the thread jobs of @category since the scheduler started, or since the
+ * last call to ev_job_scheduler_reset_stats().
+ *
+ * Since: 46.0
+ */
+void
+ev_job_scheduler_get_stats (EvJobCategory        category,
+			    EvJobSchedulerStats *stats)
+{
+	g_return_if_fail (category < EV_JOB_N_CATEGORIES);
+	g_return_if_fail (stats != NULL);
+
+	g_mutex_lock (&job_queue_mutex);
+	*stats = job_stats[category];
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/**
+ * ev_job_scheduler_reset_stats:
+ *
+ * Resets the counters returned by ev_job_scheduler_get_stats(), except
+ * the current queue depths.
+ *
+ * Since: 46.0
+ */
+void
+ev_job_scheduler_reset_stats (void)
+{
+	gint i;
+
+	g_mutex_lock (&job_queue_mutex);
+	for (i = 0; i < EV_JOB_N_CATEGORIES; i++) {
+		guint queue_depth = job_stats[i].queue_depth;
+
+		memset (&job_stats[i], 0, sizeof (EvJobSchedulerStats));
+		job_stats[i].queue_depth = queue_depth;
+		job_stats[i].max_queue_depth = queue_depth;
+	}
+	g_mutex_unlock (&job_queue_mutex);
+}
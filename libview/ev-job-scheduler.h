@@ -39,6 +39,29 @@ typedef enum {
 	EV_JOB_N_PRIORITIES
 } EvJobPriority;
 
+/* Urgent jobs are scheduled first. Other jobs of a category are
+ * scheduled before the jobs of the categories following it, whatever
+ * their priority is, unless those have been waiting for too long.
+ * Those never go before the urgent jobs of the views. */
+typedef enum {
+	EV_JOB_CATEGORY_VIEW,       /* Rendering pages for the views and interactive jobs */
+	EV_JOB_CATEGORY_THUMBNAIL,  /* Thumbnails for sidebars and previews */
+	EV_JOB_CATEGORY_BACKGROUND, /* Any other job */
+	EV_JOB_N_CATEGORIES
+} EvJobCategory;
+
+typedef struct _EvJobSchedulerStats EvJobSchedulerStats;
+
+struct _EvJobSchedulerStats {
+	guint   queue_depth;     /* Jobs currently waiting in the queue */
+	guint   max_queue_depth;
+	guint64 n_jobs;          /* Jobs taken from the queue so far */
+	gint64  total_wait_time; /* In microseconds */
+	gint64  max_wait_time;   /* In microseconds */
+	guint64 n_coalesced;     /* Jobs that got the result of an identical job */
+	gint64  total_run_time;  /* In microseconds */
+};
+
 EV_PUBLIC
 void   ev_job_scheduler_push_job               (EvJob        *job,
                                                 EvJobPriority priority);
@@ -51,4 +74,12 @@ EvJob *ev_job_scheduler_get_running_thread_job (void);
 EV_PUBLIC
 void   ev_job_scheduler_wait                   (void);
 
+EV_PUBLIC
+EvJobCategory ev_job_scheduler_get_job_category (EvJob               *job);
+EV_PUBLIC
+void          ev_job_scheduler_get_stats        (EvJobCategory        category,
+                                                 EvJobSchedulerStats *stats);
+EV_PUBLIC
+void          ev_job_scheduler_reset_stats      (void);
+
 G_END_DECLS
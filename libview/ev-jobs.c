@@ -44,6 +44,7 @@
 #include <glib/gi18n-lib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 typedef struct _EvJobLoadStreamPrivate EvJobLoadStreamPrivate;
 struct _EvJobLoadStreamPrivate
@@ -609,7 +610,11 @@ ev_job_render_run (EvJob *job)
 					   job_render->target_width, job_render->target_height);
 	g_object_unref (ev_page);
 
-	job_render->surface = ev_document_render (job->document, rc);
+	if (job_render->has_area)
+		job_render->surface = ev_document_render_region (job->document, rc,
+								 &job_render->area);
+	else
+		job_render->surface = ev_document_render (job->document, rc);
 
 	if (job_render->surface == NULL ||
 	    cairo_surface_status (job_render->surface) != CAIRO_STATUS_SUCCESS) {
@@ -721,6 +726,28 @@ ev_job_render_set_selection_info (EvJobRender     *job,
 	job->base = *base;
 }
 
+/**
+ * ev_job_render_set_area:
+ * @job: an #EvJobRender
+ * @area: the area of the page to render
+ *
+ * Makes @job render only @area of the page, in the coordinates of the
+ * page once scaled and rotated. The resulting surface has the size of
+ * @area, see ev_document_render_region().
+ *
+ * Since: 46.0
+ */
+void
+ev_job_render_set_area (EvJobRender                 *job,
+			const cairo_rectangle_int_t *area)
+{
+	g_return_if_fail (EV_IS_JOB_RENDER (job));
+	g_return_if_fail (area != NULL && area->width > 0 && area->height > 0);
+
+	job->has_area = TRUE;
+	job->area = *area;
+}
+
 /* EvJobPageData */
 static void
 ev_job_page_data_init (EvJobPageData *job)
@@ -1735,6 +1762,242 @@ ev_job_save_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_save_parent_class)->dispose) (object);
 }
 
+static void
+ev_job_save_finish (EvJobSave *job_save,
+		    GError    *error)
+{
+	EvJob *job = EV_JOB (job_save);
+
+	if (error) {
+		ev_job_failed_from_error (job, error);
+		g_error_free (error);
+
+		return;
+	}
+
+	/* Copy the metadata from the original file.
+	 * Ignore errors here. Failure to copy metadata is not a hard error */
+	if (job_save->document_uri)
+		ev_file_copy_metadata (job_save->document_uri, job_save->uri, NULL);
+
+	ev_job_succeeded (job);
+}
+
+/* Keeps the owner, permissions and extended attributes of the file
+ * being replaced, like GIO does. Ignore errors here, the owner can
+ * only be changed by root */
+static void
+ev_job_save_copy_attributes (const gchar *filename,
+			     const gchar *tmp_filename)
+{
+	GFile     *file;
+	GFile     *tmp_file;
+	GFileInfo *info;
+
+	file = g_file_new_for_path (filename);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_UNIX_UID ","
+				  G_FILE_ATTRIBUTE_UNIX_GID ","
+				  G_FILE_ATTRIBUTE_UNIX_MODE ","
+				  "xattr::*",
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return;
+
+	tmp_file = g_file_new_for_path (tmp_filename);
+	g_file_set_attributes_from_info (tmp_file, info,
+					 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+					 NULL, NULL);
+	g_object_unref (tmp_file);
+	g_object_unref (info);
+}
+
+/* Replaces @filename with @tmp_filename. Renaming would replace a
+ * symbolic link instead of the file it points to, and detach the file
+ * from its other hard links, so in those cases the contents are written
+ * over the existing file instead, which is what g_file_replace() does */
+static gboolean
+ev_job_save_replace_file (const gchar *tmp_filename,
+			  const gchar *filename,
+			  GError     **error)
+{
+	GStatBuf           st;
+	GFile             *tmp_file;
+	GFile             *file;
+	GFileInputStream  *input;
+	GFileOutputStream *output;
+	gboolean           retval = FALSE;
+
+	if (g_lstat (filename, &st) == -1 ||
+	    (S_ISREG (st.st_mode) && st.st_nlink == 1)) {
+		int errsv;
+
+		if (g_rename (tmp_filename, filename) == 0)
+			return TRUE;
+
+		errsv = errno;
+		g_set_error (error, G_IO_ERROR,
+			     g_io_error_from_errno (errsv),
+			     "%s", g_strerror (errsv));
+		return FALSE;
+	}
+
+	tmp_file = g_file_new_for_path (tmp_filename);
+	file = g_file_new_for_path (filename);
+
+	input = g_file_read (tmp_file, NULL, error);
+	if (input) {
+		output = g_file_replace (file, NULL, FALSE,
+					 G_FILE_CREATE_NONE,
+					 NULL, error);
+		if (output) {
+			retval = g_output_stream_splice (G_OUTPUT_STREAM (output),
+							 G_INPUT_STREAM (input),
+							 G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+							 G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+							 NULL, error) != -1;
+			g_object_unref (output);
+		}
+		g_object_unref (input);
+	}
+
+	g_object_unref (file);
+	g_object_unref (tmp_file);
+
+	g_unlink (tmp_filename);
+
+	return retval;
+}
+
+/* Returns the path of a new temporary file next to @filename, so that
+ * it can be renamed over it, or %NULL if it can't be created there */
+static gchar *
+ev_job_save_create_tmp_file_for (const gchar *filename)
+{
+	gchar   *dirname;
+	gchar   *basename;
+	gchar   *tmp_basename;
+	gchar   *tmp_filename;
+	gint     fd;
+
+	dirname = g_path_get_dirname (filename);
+	basename = g_path_get_basename (filename);
+	tmp_basename = g_strdup_printf (".%s.XXXXXX", basename);
+	tmp_filename = g_build_filename (dirname, tmp_basename, NULL);
+	g_free (tmp_basename);
+	g_free (basename);
+	g_free (dirname);
+
+	/* Like a new file, the mode is subject to the umask */
+	fd = g_mkstemp_full (tmp_filename, O_RDWR, 0666);
+	if (fd == -1) {
+		g_free (tmp_filename);
+
+		return NULL;
+	}
+	close (fd);
+
+	ev_job_save_copy_attributes (filename, tmp_filename);
+
+	return tmp_filename;
+}
+
+/* Saves only the changes to the document, on the file it was loaded
+ * from when it's the target, or on a copy of it that replaces the
+ * target. The copy is done by GIO, which clones the file when the
+ * filesystem supports it. Fails with G_IO_ERROR_NOT_SUPPORTED when the
+ * document has to be saved as a whole, which includes the file having
+ * changed on disk since it was loaded */
+static gboolean
+ev_job_save_changes (EvJobSave   *job_save,
+		     const gchar *filename,
+		     GError     **error)
+{
+	EvJob    *job = EV_JOB (job_save);
+	GFile    *source;
+	GFile    *target;
+	gchar    *tmp_filename;
+	gchar    *tmp_uri;
+	gboolean  retval = FALSE;
+
+	/* For remote documents this is the local copy */
+	source = g_file_new_for_uri (ev_document_get_uri (job->document));
+	target = g_file_new_for_path (filename);
+
+	if (!ev_document_is_file_unchanged (job->document)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "The document file changed since it was loaded");
+	} else if (g_file_equal (source, target)) {
+		ev_document_doc_mutex_lock ();
+		retval = ev_document_save_changes (job->document, job_save->uri, error);
+		ev_document_doc_mutex_unlock ();
+	} else if (!(tmp_filename = ev_job_save_create_tmp_file_for (filename))) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "Cannot create a temporary file next to the target");
+	} else {
+		GFile *tmp_file = g_file_new_for_path (tmp_filename);
+
+		retval = g_file_copy (source, tmp_file,
+				      G_FILE_COPY_OVERWRITE |
+				      G_FILE_COPY_TARGET_DEFAULT_PERMS,
+				      NULL, NULL, NULL, error);
+		g_object_unref (tmp_file);
+
+		if (retval) {
+			ev_job_save_copy_attributes (filename, tmp_filename);
+
+			tmp_uri = g_filename_to_uri (tmp_filename, NULL, error);
+			ev_document_doc_mutex_lock ();
+			retval = tmp_uri &&
+				ev_document_save_changes (job->document, tmp_uri, error);
+			ev_document_doc_mutex_unlock ();
+			g_free (tmp_uri);
+		}
+
+		if (retval)
+			retval = ev_job_save_replace_file (tmp_filename, filename, error);
+
+		if (!retval)
+			g_unlink (tmp_filename);
+		g_free (tmp_filename);
+	}
+
+	g_object_unref (target);
+	g_object_unref (source);
+
+	return retval;
+}
+
+/* Saves the document in a temporary file in the target directory
+ * that replaces the target, so it is never left half written */
+static gboolean
+ev_job_save_to_local_file (EvJobSave   *job_save,
+			   const gchar *tmp_filename,
+			   const gchar *filename,
+			   GError     **error)
+{
+	EvJob    *job = EV_JOB (job_save);
+	gchar    *tmp_uri;
+	gboolean  retval = FALSE;
+
+	tmp_uri = g_filename_to_uri (tmp_filename, NULL, error);
+	if (tmp_uri) {
+		ev_document_doc_mutex_lock ();
+		retval = ev_document_save (job->document, tmp_uri, error);
+		ev_document_doc_mutex_unlock ();
+		g_free (tmp_uri);
+	}
+
+	if (retval)
+		retval = ev_job_save_replace_file (tmp_filename, filename, error);
+
+	if (!retval)
+		g_unlink (tmp_filename);
+
+	return retval;
+}
+
 static gboolean
 ev_job_save_run (EvJob *job)
 {
@@ -1743,10 +2006,61 @@ ev_job_save_run (EvJob *job)
 	gchar     *tmp_filename = NULL;
 	gchar     *local_uri;
 	GError    *error = NULL;
+	gboolean   compressed;
 
 	ev_debug_message (DEBUG_JOBS, "uri: %s, document_uri: %s", job_save->uri, job_save->document_uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
+	compressed = g_object_get_data (G_OBJECT (job->document), "uri-uncompressed") != NULL;
+
+	/* A document that was never edited is a copy of the file it was
+	 * loaded from, which GIO can clone or copy without going through
+	 * user space, as long as the file didn't change on disk. Being
+	 * modified is not enough, since saving a copy resets it while the
+	 * original file keeps the old contents. For remote documents the
+	 * file is the local copy, so nothing is downloaded again. */
+	if (job_save->document_uri && !compressed &&
+	    !ev_document_get_edited (job->document) &&
+	    ev_document_is_file_unchanged (job->document)) {
+		ev_xfer_uri_simple (ev_document_get_uri (job->document),
+				    job_save->uri, &error);
+		ev_job_save_finish (job_save, error);
+
+		return FALSE;
+	}
+
+	if (!compressed) {
+		GFile *target = g_file_new_for_uri (job_save->uri);
+		gchar *filename = g_file_get_path (target);
+
+		g_object_unref (target);
+
+		/* Only the changes need to be written when the document
+		 * supports incremental saving */
+		if (filename && job_save->document_uri &&
+		    ev_document_can_save_changes (job->document)) {
+			if (ev_job_save_changes (job_save, filename, &error) ||
+			    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+				g_free (filename);
+				ev_job_save_finish (job_save, error);
+
+				return FALSE;
+			}
+			g_clear_error (&error);
+		}
+
+		tmp_filename = filename ? ev_job_save_create_tmp_file_for (filename) : NULL;
+		if (tmp_filename) {
+			ev_job_save_to_local_file (job_save, tmp_filename, filename, &error);
+			g_free (tmp_filename);
+			g_free (filename);
+			ev_job_save_finish (job_save, error);
+
+			return FALSE;
+		}
+		g_free (filename);
+	}
+
         fd = ev_mkstemp ("saveacopy.XXXXXX", &tmp_filename, &error);
         if (fd == -1) {
                 ev_job_failed_from_error (job, error);
@@ -1777,7 +2091,7 @@ ev_job_save_run (EvJob *job)
 	/* If original document was compressed,
 	 * compress it again before saving
 	 */
-	if (g_object_get_data (G_OBJECT (job->document), "uri-uncompressed")) {
+	if (compressed) {
 		EvCompressionType ctype = EV_COMPRESSION_NONE;
 		const gchar      *ext;
 		gchar            *uri_comp;
@@ -1816,19 +2130,9 @@ ev_job_save_run (EvJob *job)
 
 	ev_xfer_uri_simple (local_uri, job_save->uri, &error);
 	ev_tmp_uri_unlink (local_uri);
+	g_free (local_uri);
 
-        /* Copy the metadata from the original file */
-        if (!error) {
-                /* Ignore errors here. Failure to copy metadata is not a hard error */
-                ev_file_copy_metadata (job_save->document_uri, job_save->uri, NULL);
-        }
-
-	if (error) {
-		ev_job_failed_from_error (job, error);
-		g_error_free (error);
-	} else {
-		ev_job_succeeded (job);
-	}
+	ev_job_save_finish (job_save, error);
 
 	return FALSE;
 }
@@ -2159,16 +2463,99 @@ ev_job_export_dispose (GObject *object)
 	job = EV_JOB_EXPORT (object);
 
 	g_clear_object (&job->rc);
+	g_clear_pointer (&job->steps, g_array_unref);
 
 	(* G_OBJECT_CLASS (ev_job_export_parent_class)->dispose) (object);
 }
 
+typedef struct {
+	EvJobExportStepType type;
+	gint                page;
+} EvJobExportStep;
+
+static void
+ev_job_export_set_render_context_page (EvJobExport *job_export,
+				       gint         page)
+{
+	EvPage *ev_page;
+
+	ev_page = ev_document_get_page (EV_JOB (job_export)->document, page);
+	if (job_export->rc)
+		ev_render_context_set_page (job_export->rc, ev_page);
+	else
+		job_export->rc = ev_render_context_new (ev_page, 0, 1.0);
+	g_object_unref (ev_page);
+}
+
+/* Pages exported by every run of a batch job. The doc mutex is held
+ * while exporting a chunk, and the job goes back to the scheduler queue
+ * between chunks so that jobs rendering the view aren't delayed until
+ * the whole document has been exported */
+#define EXPORT_CHUNK_SIZE 16
+
+static gboolean
+ev_job_export_run_steps (EvJob *job)
+{
+	EvJobExport    *job_export = EV_JOB_EXPORT (job);
+	EvFileExporter *exporter = EV_FILE_EXPORTER (job->document);
+	gint            n_pages = 0;
+
+	ev_document_doc_mutex_lock ();
+
+	while (job_export->next_step < job_export->steps->len) {
+		EvJobExportStep *step;
+
+		step = &g_array_index (job_export->steps, EvJobExportStep, job_export->next_step);
+
+		if (step->type == EV_JOB_EXPORT_STEP_PAGE) {
+			if (n_pages == EXPORT_CHUNK_SIZE ||
+			    g_cancellable_is_cancelled (job->cancellable))
+				break;
+
+			ev_job_export_set_render_context_page (job_export, step->page);
+			ev_file_exporter_do_page (exporter, job_export->rc);
+			g_atomic_int_inc (&job_export->n_exported_pages);
+			n_pages++;
+		} else if (step->type == EV_JOB_EXPORT_STEP_BEGIN_PAGE) {
+			ev_file_exporter_begin_page (exporter);
+		} else if (step->type == EV_JOB_EXPORT_STEP_END_PAGE) {
+			ev_file_exporter_end_page (exporter);
+		} else if (step->type == EV_JOB_EXPORT_STEP_END) {
+			ev_file_exporter_end (exporter);
+		}
+
+		job_export->next_step++;
+	}
+
+	ev_document_doc_mutex_unlock ();
+
+	if (g_cancellable_is_cancelled (job->cancellable))
+		return FALSE;
+
+	/* Run again for the next chunk */
+	if (job_export->next_step < job_export->steps->len)
+		return TRUE;
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
 static gboolean
 ev_job_export_run (EvJob *job)
 {
 	EvJobExport *job_export = EV_JOB_EXPORT (job);
 	EvPage      *ev_page;
 
+	if (job_export->steps) {
+		ev_debug_message (DEBUG_JOBS, "step %u of %u", job_export->next_step,
+				  job_export->steps->len);
+		if (job_export->next_step == 0)
+			ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+		return ev_job_export_run_steps (job);
+	}
+
 	g_assert (job_export->page != -1);
 
 	ev_debug_message (DEBUG_JOBS, NULL);
@@ -2227,6 +2614,75 @@ ev_job_export_set_page (EvJobExport *job,
 	job->page = page;
 }
 
+/**
+ * ev_job_export_append_step:
+ * @job: an #EvJobExport
+ * @type: the #EvJobExportStepType
+ * @page: the page to export for %EV_JOB_EXPORT_STEP_PAGE, ignored otherwise
+ *
+ * Appends a step to the sequence of #EvFileExporter calls run by @job.
+ * A job with steps runs all of them, exporting many pages in a single
+ * job, instead of exporting the page set with ev_job_export_set_page().
+ * Steps can't be appended once the job has been scheduled.
+ *
+ * Since: 46.0
+ */
+void
+ev_job_export_append_step (EvJobExport         *job,
+			   EvJobExportStepType  type,
+			   gint                 page)
+{
+	EvJobExportStep step;
+
+	g_return_if_fail (EV_IS_JOB_EXPORT (job));
+	g_return_if_fail (type != EV_JOB_EXPORT_STEP_PAGE || page >= 0);
+
+	if (!job->steps)
+		job->steps = g_array_new (FALSE, FALSE, sizeof (EvJobExportStep));
+
+	step.type = type;
+	step.page = page;
+	g_array_append_val (job->steps, step);
+
+	if (type == EV_JOB_EXPORT_STEP_PAGE)
+		job->n_pages++;
+}
+
+/**
+ * ev_job_export_get_n_pages:
+ * @job: an #EvJobExport
+ *
+ * Returns: the number of pages exported by the steps of @job
+ *
+ * Since: 46.0
+ */
+gint
+ev_job_export_get_n_pages (EvJobExport *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_EXPORT (job), 0);
+
+	return job->n_pages;
+}
+
+/**
+ * ev_job_export_get_n_exported_pages:
+ * @job: an #EvJobExport
+ *
+ * Returns the number of pages already exported by the steps of @job.
+ * It can be called from the main thread while the job is running.
+ *
+ * Returns: the number of exported pages
+ *
+ * Since: 46.0
+ */
+gint
+ev_job_export_get_n_exported_pages (EvJobExport *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_EXPORT (job), 0);
+
+	return g_atomic_int_get (&job->n_exported_pages);
+}
+
 /* EvJobPrint */
 static void
 ev_job_print_init (EvJobPrint *job)
@@ -287,6 +287,9 @@ struct _EvJobRender
 	gint target_height;
 	cairo_surface_t *surface;
 
+	gboolean has_area;
+	cairo_rectangle_int_t area;
+
 	gboolean include_selection;
 	cairo_surface_t *selection;
 	cairo_region_t *selection_region;
@@ -488,12 +491,25 @@ struct _EvJobLayersClass
 	EvJobClass parent_class;
 };
 
+typedef enum {
+	EV_JOB_EXPORT_STEP_BEGIN_PAGE,
+	EV_JOB_EXPORT_STEP_PAGE,
+	EV_JOB_EXPORT_STEP_END_PAGE,
+	EV_JOB_EXPORT_STEP_END
+} EvJobExportStepType;
+
 struct _EvJobExport
 {
 	EvJob parent;
 
 	gint page;
 	EvRenderContext *rc;
+
+	/* Batch mode */
+	GArray *steps;
+	guint   next_step;
+	gint    n_pages;
+	gint    n_exported_pages; /* atomic */
 };
 
 struct _EvJobExportClass
@@ -578,6 +594,9 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+EV_PUBLIC
+void     ev_job_render_set_area           (EvJobRender     *job,
+					   const cairo_rectangle_int_t *area);
 /* EvJobPageData */
 EV_PUBLIC
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
@@ -740,6 +759,14 @@ EvJob          *ev_job_export_new         (EvDocument     *document);
 EV_PUBLIC
 void            ev_job_export_set_page    (EvJobExport    *job,
 					   gint            page);
+EV_PUBLIC
+void            ev_job_export_append_step (EvJobExport         *job,
+					   EvJobExportStepType  type,
+					   gint                 page);
+EV_PUBLIC
+gint            ev_job_export_get_n_pages (EvJobExport    *job);
+EV_PUBLIC
+gint            ev_job_export_get_n_exported_pages (EvJobExport *job);
 /* EvJobPrint */
 EV_PUBLIC
 GType           ev_job_print_get_type    (void) G_GNUC_CONST;
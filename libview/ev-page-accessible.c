@@ -35,6 +35,8 @@ struct _EvPageAccessiblePrivate {
 	GHashTable       *links;
 	GPtrArray        *children;
 	gboolean          children_initialized;
+	/* The text of the page is held while the accessible is alive */
+	EvPageCache      *page_cache;
 };
 
 
@@ -173,6 +175,12 @@ ev_page_accessible_finalize (GObject *object)
         g_clear_pointer (&priv->links, g_hash_table_destroy);
 	clear_children (EV_PAGE_ACCESSIBLE (object));
 
+	if (priv->page_cache) {
+		ev_page_cache_release_page (priv->page_cache, priv->page);
+		g_object_remove_weak_pointer (G_OBJECT (priv->page_cache),
+					      (gpointer *)&priv->page_cache);
+	}
+
 	G_OBJECT_CLASS (ev_page_accessible_parent_class)->finalize (object);
 }
 
@@ -1365,12 +1373,17 @@ ev_page_accessible_new (EvViewAccessible *view_accessible,
 				 NULL);
 
 	view = ev_page_accessible_get_view (EV_PAGE_ACCESSIBLE (atk_page));
+	atk_page->priv->page_cache = view->page_cache;
+	g_object_add_weak_pointer (G_OBJECT (view->page_cache),
+				   (gpointer *)&atk_page->priv->page_cache);
+	ev_page_cache_hold_page (view->page_cache, page);
+
 	if (ev_page_cache_is_page_cached (view->page_cache, page))
 		ev_page_accessible_initialize_children (EV_PAGE_ACCESSIBLE (atk_page));
 	else
-		g_signal_connect (view->page_cache, "page-cached",
-				  G_CALLBACK (page_cached_cb),
-				  atk_page);
+		g_signal_connect_object (view->page_cache, "page-cached",
+					 G_CALLBACK (page_cached_cb),
+					 atk_page, 0);
 
         return EV_PAGE_ACCESSIBLE (atk_page);
 }
@@ -44,6 +44,7 @@ typedef struct _EvPageCacheData {
 	gboolean           done : 1;
 	gboolean           dirty : 1;
 	EvJobPageDataFlags flags;
+	guint              n_holds;
 
 	EvMappingList     *link_mapping;
 	EvMappingList     *image_mapping;
@@ -71,6 +72,10 @@ struct _EvPageCache {
 	gint               end_page;
 
 	EvJobPageDataFlags flags;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor    *memory_monitor;
+#endif
 };
 
 struct _EvPageCacheClass {
@@ -124,6 +129,13 @@ ev_page_cache_finalize (GObject *object)
 	EvPageCache *cache = EV_PAGE_CACHE (object);
 	gint         i;
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	if (cache->memory_monitor) {
+		g_signal_handlers_disconnect_by_data (cache->memory_monitor, cache);
+		g_clear_object (&cache->memory_monitor);
+	}
+#endif
+
 	if (cache->page_list) {
 		for (i = 0; i < cache->n_pages; i++) {
 			EvPageCacheData *data;
@@ -245,6 +257,55 @@ ev_page_cache_get_flags_for_data (EvPageCache     *cache,
 	return flags;
 }
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+/* The text of the pages is kept for all the pages visited, and the text
+ * layouts take a rectangle per character, so on a serious low memory
+ * warning it's released for the pages out of the current range, unless
+ * they are held. It's extracted again when the pages get back in the
+ * range. */
+void
+ev_page_cache_handle_low_memory (EvPageCache               *cache,
+				 GMemoryMonitorWarningLevel level)
+{
+	gint i;
+
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+
+	if (level < G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+		return;
+
+	for (i = 0; i < cache->n_pages; i++) {
+		EvPageCacheData *data = &cache->page_list[i];
+
+		if (data->job || !data->done || data->n_holds > 0)
+			continue;
+
+		if (i >= cache->start_page - PRE_CACHE_SIZE &&
+		    i <= cache->end_page + PRE_CACHE_SIZE)
+			continue;
+
+		g_clear_pointer (&data->text_mapping, cairo_region_destroy);
+		g_clear_pointer (&data->text, g_free);
+		g_clear_pointer (&data->text_layout, g_free);
+		data->text_layout_length = 0;
+		g_clear_pointer (&data->text_attrs, pango_attr_list_unref);
+		g_clear_pointer (&data->text_log_attrs, g_free);
+		data->text_log_attrs_length = 0;
+
+		data->done = FALSE;
+		data->dirty = TRUE;
+	}
+}
+
+static void
+low_memory_warning_cb (GMemoryMonitor            *monitor,
+		       GMemoryMonitorWarningLevel level,
+		       EvPageCache               *cache)
+{
+	ev_page_cache_handle_low_memory (cache, level);
+}
+#endif
+
 EvPageCache *
 ev_page_cache_new (EvDocument *document)
 {
@@ -258,6 +319,12 @@ ev_page_cache_new (EvDocument *document)
 	cache->flags = EV_PAGE_DATA_FLAGS_DEFAULT;
 	cache->page_list = g_new0 (EvPageCacheData, cache->n_pages);
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	cache->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (cache->memory_monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb), cache);
+#endif
+
 	return cache;
 }
 
@@ -713,6 +780,29 @@ ev_page_cache_ensure_page (EvPageCache *cache,
         ev_page_cache_schedule_job_if_needed (cache, page);
 }
 
+/* Keeps the data of @page even on low memory warnings, for the users
+ * that expect it to stay available once cached, like accessibles */
+void
+ev_page_cache_hold_page (EvPageCache *cache,
+			 gint         page)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (page >= 0 && page < cache->n_pages);
+
+	cache->page_list[page].n_holds++;
+}
+
+void
+ev_page_cache_release_page (EvPageCache *cache,
+			    gint         page)
+{
+	g_return_if_fail (EV_IS_PAGE_CACHE (cache));
+	g_return_if_fail (page >= 0 && page < cache->n_pages);
+	g_return_if_fail (cache->page_list[page].n_holds > 0);
+
+	cache->page_list[page].n_holds--;
+}
+
 gboolean
 ev_page_cache_is_page_cached (EvPageCache   *cache,
 			      gint           page)
@@ -80,4 +80,12 @@ void               ev_page_cache_ensure_page            (EvPageCache       *cach
                                                          gint               page);
 gboolean           ev_page_cache_is_page_cached         (EvPageCache       *cache,
                                                          gint               page);
+void               ev_page_cache_hold_page              (EvPageCache       *cache,
+							 gint               page);
+void               ev_page_cache_release_page           (EvPageCache       *cache,
+							 gint               page);
+#if GLIB_CHECK_VERSION (2, 64, 0)
+void               ev_page_cache_handle_low_memory      (EvPageCache       *cache,
+							 GMemoryMonitorWarningLevel level);
+#endif
 G_END_DECLS
@@ -1,6 +1,9 @@
 #include <config.h>
+#include <math.h>
+
 #include "ev-pixbuf-cache.h"
 #include "ev-job-scheduler.h"
+#include "ev-surface-cache.h"
 #include "ev-view-private.h"
 
 typedef enum {
@@ -12,6 +15,11 @@ typedef struct _CacheJobInfo
 {
 	EvJob *job;
 	gboolean page_ready;
+	/* The surface is kept compressed in the surface cache, is being
+	 * compressed, or doesn't compress well enough to try again */
+	gboolean compressed;
+	gboolean compressing;
+	gboolean incompressible;
 
 	/* Region of the page that needs to be drawn */
 	cairo_region_t  *region;
@@ -51,8 +59,6 @@ struct _EvPixbufCache
         ScrollDirection scroll_direction;
 	gboolean inverted_colors;
 
-	gsize max_size;
-
 	/* preload_cache_size is the number of pages prior to the current
 	 * visible area that we cache.  It's normally 1, but could be 2 in the
 	 * case of twin pages.
@@ -60,9 +66,29 @@ struct _EvPixbufCache
 	int preload_cache_size;
 	guint job_list_len;
 
+	/* Whether preloaded pages are kept compressed, and how much they
+	 * were compressed so far, to estimate how many fit in memory */
+	gboolean compress_preloaded;
+	gsize uncompressed_size;
+	gsize compressed_size;
+
+	/* More pages are preloaded in the scroll direction the faster the
+	 * view scrolls and the slower pages are rendered. The scroll
+	 * velocity is in pages per second and the render time in seconds,
+	 * measured from the scheduler stats of the view jobs. */
+	gint64 scroll_time;
+	gdouble scroll_velocity;
+	gdouble render_time;
+	gint64 total_run_time;
+	guint64 n_jobs;
+
 	CacheJobInfo *prev_job;
 	CacheJobInfo *job_list;
 	CacheJobInfo *next_job;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor *memory_monitor;
+#endif
 };
 
 struct _EvPixbufCacheClass
@@ -70,12 +96,15 @@ struct _EvPixbufCacheClass
 	GObjectClass parent_class;
 
 	void (* job_finished) (EvPixbufCache *pixbuf_cache);
+	void (* page_ready)   (EvPixbufCache *pixbuf_cache,
+			       gint           page);
 };
 
 
 enum
 {
 	JOB_FINISHED,
+	PAGE_READY,
 	N_SIGNALS,
 };
 
@@ -104,6 +133,14 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 	((pixbuf_cache->end_page - pixbuf_cache->start_page) + 1)
 
 #define MAX_PRELOADED_PAGES 3
+#define MAX_COMPRESSED_PRELOADED_PAGES 10
+#define MAX_ADAPTIVE_PRELOADED_PAGES 20
+
+/* Pages are preloaded in the scroll direction to cover the time it
+ * takes to render this many of them */
+#define PRELOAD_RENDER_LOOKAHEAD 4
+/* The scroll velocity is forgotten after this time without scrolling */
+#define SCROLL_VELOCITY_TIMEOUT 500000 /* us */
 
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
@@ -133,6 +170,15 @@ ev_pixbuf_cache_class_init (EvPixbufCacheClass *class)
 			      g_cclosure_marshal_VOID__POINTER,
 			      G_TYPE_NONE, 1,
 			      G_TYPE_POINTER);
+	signals[PAGE_READY] =
+		g_signal_new ("page-ready",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvPixbufCacheClass, page_ready),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__INT,
+			      G_TYPE_NONE, 1,
+			      G_TYPE_INT);
 }
 
 static void
@@ -160,6 +206,8 @@ ev_pixbuf_cache_finalize (GObject *object)
 
 	g_object_unref (pixbuf_cache->model);
 
+	ev_surface_cache_remove_view ();
+
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->finalize (object);
 }
 
@@ -190,6 +238,9 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 	g_clear_pointer (&job_info->selection_region, cairo_region_destroy);
 
 	job_info->points_set = FALSE;
+	job_info->compressed = FALSE;
+	job_info->compressing = FALSE;
+	job_info->incompressible = FALSE;
 }
 
 static void
@@ -200,6 +251,13 @@ ev_pixbuf_cache_dispose (GObject *object)
 
 	pixbuf_cache = EV_PIXBUF_CACHE (object);
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	if (pixbuf_cache->memory_monitor) {
+		g_signal_handlers_disconnect_by_data (pixbuf_cache->memory_monitor, pixbuf_cache);
+		g_clear_object (&pixbuf_cache->memory_monitor);
+	}
+#endif
+
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
 		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
 		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
@@ -212,11 +270,37 @@ ev_pixbuf_cache_dispose (GObject *object)
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->dispose (object);
 }
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+/* The preloaded pages are the first thing to go when the system is low
+ * on memory, at any level. The surface cache lowers its limit too, so
+ * fewer pages are preloaded until it recovers. */
+void
+ev_pixbuf_cache_handle_low_memory (EvPixbufCache             *pixbuf_cache,
+				   GMemoryMonitorWarningLevel level)
+{
+	int i;
+
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
+		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
+	}
+}
+
+static void
+low_memory_warning_cb (GMemoryMonitor            *monitor,
+		       GMemoryMonitorWarningLevel level,
+		       EvPixbufCache             *pixbuf_cache)
+{
+	ev_pixbuf_cache_handle_low_memory (pixbuf_cache, level);
+}
+#endif
+
 
 EvPixbufCache *
 ev_pixbuf_cache_new (GtkWidget       *view,
-		     EvDocumentModel *model,
-		     gsize            max_size)
+		     EvDocumentModel *model)
 {
 	EvPixbufCache *pixbuf_cache;
 
@@ -225,21 +309,15 @@ ev_pixbuf_cache_new (GtkWidget       *view,
 	pixbuf_cache->view = view;
 	pixbuf_cache->model = g_object_ref (model);
 	pixbuf_cache->document = ev_document_model_get_document (model);
-	pixbuf_cache->max_size = max_size;
+	ev_surface_cache_add_view ();
 
-	return pixbuf_cache;
-}
-
-void
-ev_pixbuf_cache_set_max_size (EvPixbufCache *pixbuf_cache,
-			      gsize          max_size)
-{
-	if (pixbuf_cache->max_size == max_size)
-		return;
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	pixbuf_cache->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (pixbuf_cache->memory_monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb), pixbuf_cache);
+#endif
 
-	if (pixbuf_cache->max_size > max_size)
-		ev_pixbuf_cache_clear (pixbuf_cache);
-	pixbuf_cache->max_size = max_size;
+	return pixbuf_cache;
 }
 
 static int
@@ -271,11 +349,17 @@ copy_job_to_job_info (EvJobRender   *job_render,
 	if (job_info->surface) {
 		cairo_surface_destroy (job_info->surface);
 	}
-	job_info->surface = cairo_surface_reference (job_render->surface);
+	/* The job surface may still be copied for other requesters */
+	if (pixbuf_cache->inverted_colors)
+		job_info->surface = ev_surface_cache_copy_surface (job_render->surface, TRUE);
+	else
+		job_info->surface = cairo_surface_reference (job_render->surface);
 	set_device_scale_on_surface (job_info->surface, job_info->device_scale);
-	if (pixbuf_cache->inverted_colors) {
-		ev_document_misc_invert_surface (job_info->surface);
-	}
+	ev_surface_cache_add (pixbuf_cache->document,
+			      job_render->page, job_render->rotation,
+			      job_info->device_scale,
+			      pixbuf_cache->inverted_colors,
+			      job_info->surface);
 
 	job_info->points_set = FALSE;
 	if (job_render->include_selection) {
@@ -300,6 +384,100 @@ copy_job_to_job_info (EvJobRender   *job_render,
 		end_job (job_info, pixbuf_cache);
 
 	job_info->page_ready = TRUE;
+	job_info->compressed = FALSE;
+	job_info->compressing = FALSE;
+	job_info->incompressible = FALSE;
+}
+
+typedef struct {
+	cairo_surface_t *surface;
+	gint             page;
+	gint             rotation;
+	gboolean         inverted;
+} CompressRequest;
+
+static void
+compress_request_free (CompressRequest *request)
+{
+	cairo_surface_destroy (request->surface);
+	g_slice_free (CompressRequest, request);
+}
+
+static void
+compress_finished_cb (GObject      *source_object,
+		      GAsyncResult *result,
+		      gpointer      user_data)
+{
+	EvPixbufCache   *pixbuf_cache = EV_PIXBUF_CACHE (source_object);
+	CompressRequest *request = user_data;
+	CacheJobInfo    *job_info;
+	gint             page = request->page;
+	gsize            size, compressed_size;
+
+	/* The page may have been rendered again, or become visible,
+	 * while it was being compressed */
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (!job_info || job_info->surface != request->surface) {
+		compress_request_free (request);
+		return;
+	}
+
+	job_info->compressing = FALSE;
+
+	if (job_info->points_set ||
+	    (page >= pixbuf_cache->start_page && page <= pixbuf_cache->end_page) ||
+	    request->rotation != ev_document_model_get_rotation (pixbuf_cache->model) ||
+	    request->inverted != pixbuf_cache->inverted_colors) {
+		compress_request_free (request);
+		return;
+	}
+
+	size = (gsize)cairo_image_surface_get_stride (job_info->surface) *
+		cairo_image_surface_get_height (job_info->surface);
+	compressed_size = ev_surface_cache_add_compressed_finish (pixbuf_cache->document, page,
+								  request->rotation,
+								  job_info->device_scale,
+								  request->inverted,
+								  result);
+	compress_request_free (request);
+
+	/* Pages that don't compress well count as they are */
+	pixbuf_cache->uncompressed_size += size;
+	pixbuf_cache->compressed_size += compressed_size > 0 ? compressed_size : size;
+	if (compressed_size == 0) {
+		job_info->incompressible = TRUE;
+		return;
+	}
+
+	g_clear_pointer (&job_info->surface, cairo_surface_destroy);
+	job_info->compressed = TRUE;
+}
+
+/* Moves the surface of a preloaded page to the surface cache in
+ * compressed form, once it's compressed in a worker thread. Pages with
+ * a selection are left alone, since it's drawn on top of the surface. */
+static void
+compress_job_info_surface (EvPixbufCache *pixbuf_cache,
+			   CacheJobInfo  *job_info,
+			   gint           page)
+{
+	CompressRequest *request;
+
+	if (!pixbuf_cache->compress_preloaded || job_info->incompressible ||
+	    job_info->compressing || !job_info->surface || job_info->points_set)
+		return;
+
+	request = g_slice_new (CompressRequest);
+	request->surface = cairo_surface_reference (job_info->surface);
+	request->page = page;
+	request->rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	request->inverted = pixbuf_cache->inverted_colors;
+
+	job_info->compressing = TRUE;
+	ev_surface_cache_compress_async (G_OBJECT (pixbuf_cache),
+					 job_info->surface,
+					 compress_finished_cb,
+					 request);
 }
 
 static void
@@ -308,6 +486,7 @@ job_finished_cb (EvJob         *job,
 {
 	CacheJobInfo *job_info;
 	EvJobRender *job_render = EV_JOB_RENDER (job);
+	gint page = job_render->page;
 
 	/* If the job is outside of our interest, we silently discard it */
 	if ((job_render->page < (pixbuf_cache->start_page - pixbuf_cache->preload_cache_size)) ||
@@ -325,6 +504,10 @@ job_finished_cb (EvJob         *job,
 
 	copy_job_to_job_info (job_render, job_info, pixbuf_cache);
 	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+	g_signal_emit (pixbuf_cache, signals[PAGE_READY], 0, page);
+
+	if (page < pixbuf_cache->start_page || page > pixbuf_cache->end_page)
+		compress_job_info_surface (pixbuf_cache, job_info, page);
 }
 
 /* This checks a job to see if the job would generate the right sized pixbuf
@@ -430,6 +613,46 @@ ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 	return height * cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
 }
 
+/* The number of pages preloaded on each side when not scrolling */
+static gint
+ev_pixbuf_cache_get_base_preload_depth (EvPixbufCache *pixbuf_cache)
+{
+	return pixbuf_cache->compress_preloaded ?
+		MAX_COMPRESSED_PRELOADED_PAGES : MAX_PRELOADED_PAGES;
+}
+
+/* The number of pages to preload in the scroll direction: the pages the
+ * view will scroll through while rendering a few of them */
+static gint
+ev_pixbuf_cache_get_scroll_preload_depth (EvPixbufCache *pixbuf_cache)
+{
+	gint    base_depth = ev_pixbuf_cache_get_base_preload_depth (pixbuf_cache);
+	gdouble depth;
+
+	if (g_get_monotonic_time () - pixbuf_cache->scroll_time > SCROLL_VELOCITY_TIMEOUT)
+		return base_depth;
+
+	depth = ceil (pixbuf_cache->scroll_velocity * pixbuf_cache->render_time *
+		      PRELOAD_RENDER_LOOKAHEAD);
+
+	return CLAMP ((gint)MIN (depth, MAX_ADAPTIVE_PRELOADED_PAGES),
+		      base_depth, MAX_ADAPTIVE_PRELOADED_PAGES);
+}
+
+/* The number of pages preloaded before or after the visible ones, which
+ * is lower than the preload cache size on the side the view is scrolling
+ * away from */
+static gint
+ev_pixbuf_cache_get_preload_depth (EvPixbufCache   *pixbuf_cache,
+				   ScrollDirection  direction)
+{
+	if (direction == pixbuf_cache->scroll_direction)
+		return pixbuf_cache->preload_cache_size;
+
+	return MIN (pixbuf_cache->preload_cache_size,
+		    ev_pixbuf_cache_get_base_preload_depth (pixbuf_cache));
+}
+
 static gint
 ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 				  gint           start_page,
@@ -438,7 +661,9 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 				  gint           rotation)
 {
 	gsize range_size = 0;
+	gsize max_size;
 	gint  new_preload_cache_size = 0;
+	gint  prev_depth, next_depth;
 	gint  i;
 	guint n_pages = ev_document_get_n_pages (pixbuf_cache->document);
 
@@ -447,19 +672,33 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		range_size += ev_pixbuf_cache_get_page_size (pixbuf_cache, i, scale, rotation);
 	}
 
-	if (range_size >= pixbuf_cache->max_size)
+	/* The pages of other views count against the same limit */
+	max_size = ev_surface_cache_get_view_budget ();
+	if (range_size >= max_size)
 		return new_preload_cache_size;
 
+	/* Preloaded pages take what they were compressed to so far */
+	if (pixbuf_cache->compress_preloaded && pixbuf_cache->uncompressed_size > 0) {
+		max_size = range_size + (max_size - range_size) *
+			(pixbuf_cache->uncompressed_size / MAX (pixbuf_cache->compressed_size, 1));
+	}
+
+	prev_depth = next_depth = ev_pixbuf_cache_get_base_preload_depth (pixbuf_cache);
+	if (pixbuf_cache->scroll_direction == SCROLL_DIRECTION_UP)
+		prev_depth = ev_pixbuf_cache_get_scroll_preload_depth (pixbuf_cache);
+	else
+		next_depth = ev_pixbuf_cache_get_scroll_preload_depth (pixbuf_cache);
+
 	i = 1;
-	while (((start_page - i > 0) || (end_page + i < n_pages)) &&
-	       new_preload_cache_size < MAX_PRELOADED_PAGES) {
+	while (((start_page - i > 0) && i <= prev_depth) ||
+	       ((end_page + i < n_pages) && i <= next_depth)) {
 		gsize    page_size;
 		gboolean updated = FALSE;
 
-		if (end_page + i < n_pages) {
+		if (end_page + i < n_pages && i <= next_depth) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, end_page + i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				new_preload_cache_size++;
 				updated = TRUE;
@@ -468,10 +707,10 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 			}
 		}
 
-		if (start_page - i > 0) {
+		if (start_page - i > 0 && i <= prev_depth) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, start_page - i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				if (!updated)
 					new_preload_cache_size++;
@@ -660,6 +899,9 @@ add_job (EvPixbufCache  *pixbuf_cache,
 {
 	job_info->device_scale = get_device_scale (pixbuf_cache);
 	job_info->page_ready = FALSE;
+	job_info->compressed = FALSE;
+	job_info->compressing = FALSE;
+	job_info->incompressible = FALSE;
 
 	if (job_info->region)
 		cairo_region_destroy (job_info->region);
@@ -690,6 +932,35 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	ev_job_scheduler_push_job (job_info->job, priority);
 }
 
+static gboolean
+use_cached_surface (EvPixbufCache *pixbuf_cache,
+		    CacheJobInfo  *job_info,
+		    gint           page,
+		    gint           rotation,
+		    gint           width,
+		    gint           height)
+{
+	cairo_surface_t *surface;
+	gint             device_scale = get_device_scale (pixbuf_cache);
+
+	surface = ev_surface_cache_lookup (pixbuf_cache->document,
+					   page, rotation, width, height,
+					   device_scale,
+					   pixbuf_cache->inverted_colors);
+	if (!surface)
+		return FALSE;
+
+	g_clear_pointer (&job_info->surface, cairo_surface_destroy);
+	job_info->surface = surface;
+	job_info->device_scale = device_scale;
+	job_info->page_ready = TRUE;
+	job_info->compressed = FALSE;
+	job_info->compressing = FALSE;
+	job_info->incompressible = FALSE;
+
+	return TRUE;
+}
+
 static void
 add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   CacheJobInfo  *job_info,
@@ -711,8 +982,29 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 	if (job_info->surface &&
 	    job_info->device_scale == device_scale &&
 	    cairo_image_surface_get_width (job_info->surface) == width * device_scale &&
-	    cairo_image_surface_get_height (job_info->surface) == height * device_scale)
+	    cairo_image_surface_get_height (job_info->surface) == height * device_scale) {
+		if (priority == EV_JOB_PRIORITY_LOW)
+			compress_job_info_surface (pixbuf_cache, job_info, page);
+		return;
+	}
+
+	/* Preloaded pages stay compressed until they become visible */
+	if (job_info->compressed && priority == EV_JOB_PRIORITY_LOW &&
+	    pixbuf_cache->compress_preloaded &&
+	    ev_surface_cache_contains (pixbuf_cache->document, page, rotation,
+				       width * device_scale, height * device_scale,
+				       device_scale, pixbuf_cache->inverted_colors))
+		return;
+	job_info->compressed = FALSE;
+
+	/* Another view may have rendered the page already */
+	if (!new_selection_surface_needed (pixbuf_cache, job_info, page, scale) &&
+	    use_cached_surface (pixbuf_cache, job_info, page, rotation,
+				width * device_scale, height * device_scale)) {
+		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+		g_signal_emit (pixbuf_cache, signals[PAGE_READY], 0, page);
 		return;
+	}
 
 	/* Free old surfaces for non visible pages */
 	if (priority == EV_JOB_PRIORITY_LOW) {
@@ -734,10 +1026,18 @@ add_prev_jobs_if_needed (EvPixbufCache *pixbuf_cache,
         int page;
         int i;
 
+        gint depth = ev_pixbuf_cache_get_preload_depth (pixbuf_cache, SCROLL_DIRECTION_UP);
+
         for (i = pixbuf_cache->preload_cache_size - 1; i >= FIRST_VISIBLE_PREV(pixbuf_cache); i--) {
                 job_info = (pixbuf_cache->prev_job + i);
                 page = pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i;
 
+                /* The view scrolled past these pages */
+                if (pixbuf_cache->preload_cache_size - i > depth) {
+                        dispose_cache_job_info (job_info, pixbuf_cache);
+                        continue;
+                }
+
                 add_job_if_needed (pixbuf_cache, job_info,
                                    page, rotation, scale,
                                    EV_JOB_PRIORITY_LOW);
@@ -753,10 +1053,18 @@ add_next_jobs_if_needed (EvPixbufCache *pixbuf_cache,
         int page;
         int i;
 
+        gint depth = ev_pixbuf_cache_get_preload_depth (pixbuf_cache, SCROLL_DIRECTION_DOWN);
+
         for (i = 0; i < VISIBLE_NEXT_LEN(pixbuf_cache); i++) {
                 job_info = (pixbuf_cache->next_job + i);
                 page = pixbuf_cache->end_page + 1 + i;
 
+                /* The view scrolled past these pages */
+                if (i + 1 > depth) {
+                        dispose_cache_job_info (job_info, pixbuf_cache);
+                        continue;
+                }
+
                 add_job_if_needed (pixbuf_cache, job_info,
                                    page, rotation, scale,
                                    EV_JOB_PRIORITY_LOW);
@@ -810,6 +1118,53 @@ ev_pixbuf_cache_get_scroll_direction (EvPixbufCache *pixbuf_cache,
         return pixbuf_cache->scroll_direction;
 }
 
+static void
+ev_pixbuf_cache_update_scroll_velocity (EvPixbufCache *pixbuf_cache,
+					gint           start_page)
+{
+	gint64 now = g_get_monotonic_time ();
+	gint64 elapsed = now - pixbuf_cache->scroll_time;
+	gdouble velocity;
+
+	if (pixbuf_cache->start_page == -1 || start_page == pixbuf_cache->start_page)
+		return;
+
+	velocity = ABS (start_page - pixbuf_cache->start_page) * (gdouble)G_USEC_PER_SEC / MAX (elapsed, 1);
+	if (elapsed > SCROLL_VELOCITY_TIMEOUT)
+		pixbuf_cache->scroll_velocity = velocity;
+	else
+		pixbuf_cache->scroll_velocity = (pixbuf_cache->scroll_velocity + velocity) / 2;
+	pixbuf_cache->scroll_time = now;
+}
+
+static void
+ev_pixbuf_cache_update_render_time (EvPixbufCache *pixbuf_cache)
+{
+	EvJobSchedulerStats stats;
+	gdouble             render_time;
+
+	ev_job_scheduler_get_stats (EV_JOB_CATEGORY_VIEW, &stats);
+
+	/* The stats were reset */
+	if (stats.n_jobs < pixbuf_cache->n_jobs ||
+	    stats.total_run_time < pixbuf_cache->total_run_time) {
+		pixbuf_cache->n_jobs = 0;
+		pixbuf_cache->total_run_time = 0;
+	}
+
+	if (stats.n_jobs > pixbuf_cache->n_jobs) {
+		render_time = (stats.total_run_time - pixbuf_cache->total_run_time) /
+			((gdouble)(stats.n_jobs - pixbuf_cache->n_jobs) * G_USEC_PER_SEC);
+		if (pixbuf_cache->render_time > 0)
+			pixbuf_cache->render_time = (pixbuf_cache->render_time + render_time) / 2;
+		else
+			pixbuf_cache->render_time = render_time;
+	}
+
+	pixbuf_cache->n_jobs = stats.n_jobs;
+	pixbuf_cache->total_run_time = stats.total_run_time;
+}
+
 void
 ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 				gint            start_page,
@@ -826,6 +1181,8 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	g_return_if_fail (end_page >= start_page);
 
         pixbuf_cache->scroll_direction = ev_pixbuf_cache_get_scroll_direction (pixbuf_cache, start_page, end_page);
+	ev_pixbuf_cache_update_scroll_velocity (pixbuf_cache, start_page);
+	ev_pixbuf_cache_update_render_time (pixbuf_cache);
 
 	/* First, resize the page_range as needed.  We cull old pages
 	 * mercilessly. */
@@ -843,6 +1200,40 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
 }
 
+/* Surfaces are shared with the other views through the surface cache,
+ * so they are replaced with an inverted copy instead of being inverted
+ * in place */
+static void
+invert_job_info_surface (EvPixbufCache *pixbuf_cache,
+			 CacheJobInfo  *job_info,
+			 gint           page)
+{
+	cairo_surface_t *surface;
+	gint             rotation;
+
+	if (!job_info->surface)
+		return;
+
+	rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+	surface = ev_surface_cache_lookup (pixbuf_cache->document, page, rotation,
+					   cairo_image_surface_get_width (job_info->surface),
+					   cairo_image_surface_get_height (job_info->surface),
+					   job_info->device_scale,
+					   pixbuf_cache->inverted_colors);
+	if (!surface) {
+		surface = ev_surface_cache_copy_surface (job_info->surface, TRUE);
+		set_device_scale_on_surface (surface, job_info->device_scale);
+
+		ev_surface_cache_add (pixbuf_cache->document, page, rotation,
+				      job_info->device_scale,
+				      pixbuf_cache->inverted_colors,
+				      surface);
+	}
+
+	cairo_surface_destroy (job_info->surface);
+	job_info->surface = surface;
+}
+
 void
 ev_pixbuf_cache_set_inverted_colors (EvPixbufCache *pixbuf_cache,
 				     gboolean       inverted_colors)
@@ -855,26 +1246,30 @@ ev_pixbuf_cache_set_inverted_colors (EvPixbufCache *pixbuf_cache,
 	pixbuf_cache->inverted_colors = inverted_colors;
 
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
-		CacheJobInfo *job_info;
-
-		job_info = pixbuf_cache->prev_job + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
-
-		job_info = pixbuf_cache->next_job + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+		invert_job_info_surface (pixbuf_cache, pixbuf_cache->prev_job + i,
+					 pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i);
+		invert_job_info_surface (pixbuf_cache, pixbuf_cache->next_job + i,
+					 pixbuf_cache->end_page + 1 + i);
 	}
 
 	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		CacheJobInfo *job_info;
-
-		job_info = pixbuf_cache->job_list + i;
-		if (job_info && job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+		invert_job_info_surface (pixbuf_cache, pixbuf_cache->job_list + i,
+					 pixbuf_cache->start_page + i);
 	}
 }
 
+/* Keeps the surfaces of the preloaded pages compressed, which allows to
+ * preload more pages within the same memory limit, at the cost of
+ * decompressing them when they become visible */
+void
+ev_pixbuf_cache_set_compress_preloaded (EvPixbufCache *pixbuf_cache,
+					gboolean       compress_preloaded)
+{
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	pixbuf_cache->compress_preloaded = compress_preloaded;
+}
+
 cairo_surface_t *
 ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 			     gint           page)
@@ -885,6 +1280,22 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	if (job_info == NULL)
 		return NULL;
 
+	/* Decompress preloaded pages on demand */
+	if (job_info->compressed) {
+		gint rotation = ev_document_model_get_rotation (pixbuf_cache->model);
+		gint device_scale = get_device_scale (pixbuf_cache);
+		gint width, height;
+
+		_get_page_size_for_scale_and_rotation (pixbuf_cache->document, page,
+						       ev_document_model_get_scale (pixbuf_cache->model),
+						       rotation, &width, &height);
+		if (!use_cached_surface (pixbuf_cache, job_info, page, rotation,
+					 width * device_scale, height * device_scale)) {
+			job_info->compressed = FALSE;
+			job_info->page_ready = FALSE;
+		}
+	}
+
 	if (job_info->page_ready)
 		return job_info->surface;
 
@@ -893,6 +1304,7 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	    EV_JOB_RENDER (job_info->job)->page_ready) {
 		copy_job_to_job_info (EV_JOB_RENDER (job_info->job), job_info, pixbuf_cache);
 		g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+		g_signal_emit (pixbuf_cache, signals[PAGE_READY], 0, page);
 	}
 
 	return job_info->surface;
@@ -1327,6 +1739,8 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 	CacheJobInfo *job_info;
         gint width, height;
 
+	ev_surface_cache_remove_page (pixbuf_cache->document, page);
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return;
@@ -57,10 +57,7 @@ typedef struct _EvPixbufCacheClass  EvPixbufCacheClass;
 
 GType          ev_pixbuf_cache_get_type             (void) G_GNUC_CONST;
 EvPixbufCache *ev_pixbuf_cache_new                  (GtkWidget     *view,
-						     EvDocumentModel *model,
-						     gsize            max_size);
-void           ev_pixbuf_cache_set_max_size         (EvPixbufCache   *pixbuf_cache,
-						     gsize            max_size);
+						     EvDocumentModel *model);
 void           ev_pixbuf_cache_set_page_range       (EvPixbufCache *pixbuf_cache,
 						     gint           start_page,
 						     gint           end_page,
@@ -76,6 +73,12 @@ void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache  *pixbuf_cache,
 						     gdouble         scale);
 void           ev_pixbuf_cache_set_inverted_colors  (EvPixbufCache *pixbuf_cache,
 						     gboolean       inverted_colors);
+void           ev_pixbuf_cache_set_compress_preloaded (EvPixbufCache *pixbuf_cache,
+						       gboolean       compress_preloaded);
+#if GLIB_CHECK_VERSION (2, 64, 0)
+void           ev_pixbuf_cache_handle_low_memory    (EvPixbufCache *pixbuf_cache,
+						     GMemoryMonitorWarningLevel level);
+#endif
 /* Selection */
 cairo_surface_t *ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 							gint             page,
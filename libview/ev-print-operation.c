@@ -382,6 +382,9 @@ static GType    ev_print_operation_export_get_type (void) G_GNUC_CONST;
 
 static void     ev_print_operation_export_begin    (EvPrintOperationExport *export);
 static gboolean export_print_page                  (EvPrintOperationExport *export);
+static void     export_job_append_step             (EvPrintOperationExport *export,
+						    EvJobExportStepType     type,
+						    gint                    page);
 static void     export_cancel                      (EvPrintOperationExport *export);
 
 struct _EvPrintOperationExport {
@@ -404,7 +407,7 @@ struct _EvPrintOperationExport {
 	gchar *job_name;
 	gboolean embed_page_setup;
 
-	guint idle_id;
+	guint progress_id;
 
 	/* Context */
 	EvFileExporterContext fc;
@@ -746,9 +749,6 @@ export_print_inc_page (EvPrintOperationExport *export)
 				if (export->pages_per_sheet > 1 && export->collate == 1 &&
 				    (export->page_count - 1) % export->pages_per_sheet != 0) {
 
-					EvPrintOperation *op = EV_PRINT_OPERATION (export);
-					ev_document_doc_mutex_lock ();
-
 					/* keep track of all blanks but only actualise those
 					 * which are in the current odd / even sheet set */
 
@@ -756,9 +756,8 @@ export_print_inc_page (EvPrintOperationExport *export)
 					if (export->page_set == GTK_PAGE_SET_ALL ||
 						(export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 						(export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1) ) {
-						ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
+						export_job_append_step (export, EV_JOB_EXPORT_STEP_END_PAGE, -1);
 					}
-					ev_document_doc_mutex_unlock ();
 					export->sheet = 1 + (export->page_count - 1) / export->pages_per_sheet;
 				}
 
@@ -863,33 +862,41 @@ export_print_done (EvPrintOperationExport *export)
 }
 
 static void
-export_print_page_idle_finished (EvPrintOperationExport *export)
+update_progress (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	EvJobExport      *job = EV_JOB_EXPORT (export->job_export);
+	gint              n_pages, n_exported;
+
+	n_pages = ev_job_export_get_n_pages (job);
+	n_exported = ev_job_export_get_n_exported_pages (job);
+
+	ev_print_operation_update_status (op,
+					  ev_job_is_finished (export->job_export) ?
+					  n_pages + 1 : MIN (n_exported + 1, n_pages),
+					  n_pages,
+					  n_pages > 0 ? n_exported / (gdouble)n_pages : 1.0);
+}
+
+static gboolean
+export_progress_timeout_cb (EvPrintOperationExport *export)
 {
-	export->idle_id = 0;
+	update_progress (export);
+
+	return G_SOURCE_CONTINUE;
 }
 
 static void
 export_job_finished (EvJobExport            *job,
 		     EvPrintOperationExport *export)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
-	if (export->pages_per_sheet == 1 ||
-	   ( export->page_count % export->pages_per_sheet == 0 &&
-	   ( export->page_set == GTK_PAGE_SET_ALL ||
-	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
-	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
-
-		ev_document_doc_mutex_lock ();
-		ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+	if (export->progress_id > 0) {
+		g_source_remove (export->progress_id);
+		export->progress_id = 0;
 	}
 
-	/* Reschedule */
-	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-					   (GSourceFunc)export_print_page,
-					   export,
-					   (GDestroyNotify)export_print_page_idle_finished);
+	update_progress (export);
+	export_print_done (export);
 }
 
 static void
@@ -904,9 +911,9 @@ export_cancel (EvPrintOperationExport *export)
 {
 	EvPrintOperation *op = EV_PRINT_OPERATION (export);
 
-	if (export->idle_id > 0)
-		g_source_remove (export->idle_id);
-	export->idle_id = 0;
+	if (export->progress_id > 0)
+		g_source_remove (export->progress_id);
+	export->progress_id = 0;
 
 	if (export->job_export) {
 		g_signal_handlers_disconnect_by_func (export->job_export,
@@ -931,23 +938,18 @@ export_cancel (EvPrintOperationExport *export)
 }
 
 static void
-update_progress (EvPrintOperationExport *export)
+export_job_append_step (EvPrintOperationExport *export,
+			EvJobExportStepType     type,
+			gint                    page)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
-	ev_print_operation_update_status (op, export->total,
-					  export->n_pages_to_print,
-					  export->total / (gdouble)export->n_pages_to_print);
+	ev_job_export_append_step (EV_JOB_EXPORT (export->job_export), type, page);
 }
 
+/* Appends the steps to export the next page to the export job. Returns
+ * %FALSE when there are no more pages to export */
 static gboolean
 export_print_page (EvPrintOperationExport *export)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
-	if (!export->temp_file)
-		return G_SOURCE_REMOVE; /* cancelled */
-
 	export->total++;
 	export->collated++;
 
@@ -960,14 +962,9 @@ export_print_page (EvPrintOperationExport *export)
 	if (export->collated == export->collated_copies) {
 		export->collated = 0;
 		if (!export_print_inc_page (export)) {
-			ev_document_doc_mutex_lock ();
-			ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-			ev_document_doc_mutex_unlock ();
+			export_job_append_step (export, EV_JOB_EXPORT_STEP_END, -1);
 
-			update_progress (export);
-			export_print_done (export);
-
-			return G_SOURCE_REMOVE;
+			return FALSE;
 		}
 	}
 
@@ -985,14 +982,9 @@ export_print_page (EvPrintOperationExport *export)
 				export->collated = 0;
 
 				if (!export_print_inc_page (export)) {
-					ev_document_doc_mutex_lock ();
-					ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-					ev_document_doc_mutex_unlock ();
-
-					update_progress (export);
+					export_job_append_step (export, EV_JOB_EXPORT_STEP_END, -1);
 
-					export_print_done (export);
-					return G_SOURCE_REMOVE;
+					return FALSE;
 				}
 			}
 
@@ -1006,27 +998,20 @@ export_print_page (EvPrintOperationExport *export)
 	    (export->page_set == GTK_PAGE_SET_ALL ||
 	    (export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 	    (export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1)))) {
-		ev_document_doc_mutex_lock ();
-		ev_file_exporter_begin_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		export_job_append_step (export, EV_JOB_EXPORT_STEP_BEGIN_PAGE, -1);
 	}
 
-	if (!export->job_export) {
-		export->job_export = ev_job_export_new (op->document);
-		g_signal_connect (export->job_export, "finished",
-				  G_CALLBACK (export_job_finished),
-				  (gpointer)export);
-		g_signal_connect (export->job_export, "cancelled",
-				  G_CALLBACK (export_job_cancelled),
-				  (gpointer)export);
-	}
-
-	ev_job_export_set_page (EV_JOB_EXPORT (export->job_export), export->page);
-	ev_job_scheduler_push_job (export->job_export, EV_JOB_PRIORITY_NONE);
+	export_job_append_step (export, EV_JOB_EXPORT_STEP_PAGE, export->page);
 
-	update_progress (export);
+	if (export->pages_per_sheet == 1 ||
+	   ( export->page_count % export->pages_per_sheet == 0 &&
+	   ( export->page_set == GTK_PAGE_SET_ALL ||
+	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
+	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
+		export_job_append_step (export, EV_JOB_EXPORT_STEP_END_PAGE, -1);
+	}
 
-	return G_SOURCE_REMOVE;
+	return TRUE;
 }
 
 static void
@@ -1041,10 +1026,25 @@ ev_print_operation_export_begin (EvPrintOperationExport *export)
 	ev_file_exporter_begin (EV_FILE_EXPORTER (op->document), &export->fc);
 	ev_document_doc_mutex_unlock ();
 
-	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-					   (GSourceFunc)export_print_page,
-					   export,
-					   (GDestroyNotify)export_print_page_idle_finished);
+	/* The whole sequence of exporter calls is computed here, and then
+	 * run by a single job in the worker thread, instead of scheduling a
+	 * job and going back to the main loop for every page */
+	export->job_export = ev_job_export_new (op->document);
+	g_signal_connect (export->job_export, "finished",
+			  G_CALLBACK (export_job_finished),
+			  (gpointer)export);
+	g_signal_connect (export->job_export, "cancelled",
+			  G_CALLBACK (export_job_cancelled),
+			  (gpointer)export);
+
+	while (export_print_page (export));
+
+	ev_job_scheduler_push_job (export->job_export, EV_JOB_PRIORITY_NONE);
+
+	update_progress (export);
+	export->progress_id = g_timeout_add (100,
+					     (GSourceFunc)export_progress_timeout_cb,
+					     export);
 }
 
 static EvFileExporterFormat
@@ -1246,6 +1246,7 @@ ev_print_operation_export_prepare (EvPrintOperationExport *export,
         export->fc.paper_height = height;
         export->fc.duplex = FALSE;
         export->fc.pages_per_sheet = export->pages_per_sheet;
+        export->fc.page_copies = export->collated_copies;
 
         if (ev_print_queue_is_empty (op->document))
                 ev_print_operation_export_begin (export);
@@ -1260,9 +1261,9 @@ ev_print_operation_export_finalize (GObject *object)
 {
 	EvPrintOperationExport *export = EV_PRINT_OPERATION_EXPORT (object);
 
-	if (export->idle_id > 0) {
-		g_source_remove (export->idle_id);
-		export->idle_id = 0;
+	if (export->progress_id > 0) {
+		g_source_remove (export->progress_id);
+		export->progress_id = 0;
 	}
 
 	if (export->fd != -1) {
@@ -0,0 +1,844 @@
+/* ev-surface-cache.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-debug.h"
+#include "ev-pixel-ops.h"
+#include "ev-surface-cache.h"
+
+#define DEFAULT_MAX_SIZE 52428800 /* 50MB */
+
+/* On low memory warnings the limit is halved, down to an eighth of the
+ * configured one, and doubled back every RECOVER_INTERVAL seconds
+ * without warnings */
+#define MAX_BUDGET_SHIFT 3
+#define RECOVER_INTERVAL 60
+
+typedef struct {
+	EvDocument *document;
+	gint        page;
+	gint        rotation;
+	gint        width;
+	gint        height;
+	gint        device_scale;
+	gboolean    inverted;
+} CacheKey;
+
+/* Off-screen pages can be kept compressed, which for text and scanned
+ * pages takes a fraction of the memory. Pixels are replaced by indices
+ * into a palette when a page has few enough colors, and runs of the
+ * same index or pixel are then packed like in PackBits: a header byte
+ * n < 128 is followed by n + 1 literal elements, and n >= 128 by one
+ * element repeated n - 126 times. */
+#define MAX_PALETTE_COLORS 256
+#define PALETTE_HASH_SIZE  1024
+#define MAX_LITERAL_LEN    128
+#define MAX_RUN_LEN        129
+
+/* Compressing is only worth it if it saves at least half the memory */
+#define MIN_COMPRESSION_RATIO 2
+
+typedef struct {
+	cairo_format_t format;
+	gint           width;
+	gint           height;
+	guint32       *palette;
+	guint          n_colors; /* 0 when the pixels are not indexed */
+	guchar        *data;
+	gsize          length;
+} CompressedSurface;
+
+typedef struct {
+	CacheKey           key;
+	cairo_surface_t   *surface;
+	CompressedSurface *compressed;
+	gsize              size;
+	GList              link;
+} CacheEntry;
+
+/* Entries by key, and the same entries from the most recently used */
+static GHashTable *entries = NULL;
+static GQueue      lru = G_QUEUE_INIT;
+static gsize       cache_size = 0;
+static gsize       max_size = DEFAULT_MAX_SIZE;
+static guint       budget_shift = 0;
+static guint       n_views = 0;
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static guint       recover_id = 0;
+#endif
+
+/* Documents we hold entries for, to drop them when they are finalized */
+static GHashTable *documents = NULL;
+
+static guint
+cache_key_hash (gconstpointer data)
+{
+	const CacheKey *key = data;
+	guint           hash;
+
+	hash = g_direct_hash (key->document);
+	hash = hash * 31 + key->page;
+	hash = hash * 31 + key->rotation;
+	hash = hash * 31 + key->width;
+	hash = hash * 31 + key->height;
+	hash = hash * 31 + key->device_scale;
+	hash = hash * 31 + (key->inverted ? 1 : 0);
+
+	return hash;
+}
+
+static gboolean
+cache_key_equal (gconstpointer a,
+		 gconstpointer b)
+{
+	const CacheKey *ka = a;
+	const CacheKey *kb = b;
+
+	return ka->document == kb->document &&
+		ka->page == kb->page &&
+		ka->rotation == kb->rotation &&
+		ka->width == kb->width &&
+		ka->height == kb->height &&
+		ka->device_scale == kb->device_scale &&
+		!ka->inverted == !kb->inverted;
+}
+
+static void
+compressed_surface_free (CompressedSurface *compressed)
+{
+	g_free (compressed->palette);
+	g_free (compressed->data);
+	g_slice_free (CompressedSurface, compressed);
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	g_clear_pointer (&entry->surface, cairo_surface_destroy);
+	g_clear_pointer (&entry->compressed, compressed_surface_free);
+	g_slice_free (CacheEntry, entry);
+}
+
+static inline gboolean
+elements_equal (const guchar *data,
+		guint         element_size,
+		gsize         a,
+		gsize         b)
+{
+	if (element_size == 1)
+		return data[a] == data[b];
+
+	return ((const guint32 *)data)[a] == ((const guint32 *)data)[b];
+}
+
+/* Packs @n_elements elements of @element_size bytes, giving up when the
+ * output would be longer than @max_length */
+static gboolean
+pack_elements (GByteArray   *output,
+	       const guchar *data,
+	       gsize         n_elements,
+	       guint         element_size,
+	       gsize         max_length)
+{
+	gsize i = 0;
+
+	while (i < n_elements) {
+		gsize  len = 1;
+		guint8 header;
+
+		while (i + len < n_elements && len < MAX_RUN_LEN &&
+		       elements_equal (data, element_size, i, i + len))
+			len++;
+
+		if (len > 1) {
+			header = len + 126;
+			g_byte_array_append (output, &header, 1);
+			g_byte_array_append (output, data + i * element_size, element_size);
+		} else {
+			/* Stop the literal where a run starts */
+			while (i + len < n_elements && len < MAX_LITERAL_LEN &&
+			       !(i + len + 1 < n_elements &&
+				 elements_equal (data, element_size, i + len, i + len + 1)))
+				len++;
+
+			header = len - 1;
+			g_byte_array_append (output, &header, 1);
+			g_byte_array_append (output, data + i * element_size, len * element_size);
+		}
+
+		if (output->len > max_length)
+			return FALSE;
+
+		i += len;
+	}
+
+	return TRUE;
+}
+
+/* Fills @palette with the colors of @pixels and @indices with the index
+ * of every pixel. Returns the number of colors, or 0 if there are too
+ * many of them. */
+static guint
+build_palette (const guint32 *pixels,
+	       gsize          n_pixels,
+	       guint32       *palette,
+	       guint8        *indices)
+{
+	guint32 keys[PALETTE_HASH_SIZE];
+	gint16  values[PALETTE_HASH_SIZE];
+	guint   n_colors = 0;
+	gsize   i;
+
+	memset (values, -1, sizeof (values));
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32 pixel = pixels[i];
+		guint   slot;
+
+		if (i > 0 && pixel == pixels[i - 1]) {
+			indices[i] = indices[i - 1];
+			continue;
+		}
+
+		slot = (pixel * 2654435761u) >> 22;
+		while (values[slot] != -1 && keys[slot] != pixel)
+			slot = (slot + 1) % PALETTE_HASH_SIZE;
+
+		if (values[slot] == -1) {
+			if (n_colors == MAX_PALETTE_COLORS)
+				return 0;
+
+			keys[slot] = pixel;
+			values[slot] = n_colors;
+			palette[n_colors++] = pixel;
+		}
+
+		indices[i] = values[slot];
+	}
+
+	return n_colors;
+}
+
+static CompressedSurface *
+compress_surface (cairo_surface_t *surface)
+{
+	CompressedSurface *compressed;
+	cairo_format_t     format;
+	const guint32     *pixels;
+	guint32            palette[MAX_PALETTE_COLORS];
+	guint8            *indices;
+	GByteArray        *output;
+	gsize              n_pixels, max_length;
+	guint              n_colors;
+	gint               width, height;
+	gboolean           packed;
+
+	format = cairo_image_surface_get_format (surface);
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	if ((format != CAIRO_FORMAT_ARGB32 && format != CAIRO_FORMAT_RGB24) ||
+	    cairo_image_surface_get_stride (surface) != width * 4)
+		return NULL;
+
+	/* Runs in a worker thread, the surface was flushed before */
+	pixels = (const guint32 *)cairo_image_surface_get_data (surface);
+	n_pixels = (gsize)width * height;
+	max_length = n_pixels * 4 / MIN_COMPRESSION_RATIO;
+
+	output = g_byte_array_new ();
+	indices = g_malloc (n_pixels);
+	n_colors = build_palette (pixels, n_pixels, palette, indices);
+	if (n_colors > 0)
+		packed = pack_elements (output, indices, n_pixels, 1, max_length);
+	else
+		packed = pack_elements (output, (const guchar *)pixels, n_pixels, 4, max_length);
+	g_free (indices);
+
+	if (!packed) {
+		g_byte_array_free (output, TRUE);
+		return NULL;
+	}
+
+	compressed = g_slice_new0 (CompressedSurface);
+	compressed->format = format;
+	compressed->width = width;
+	compressed->height = height;
+	compressed->n_colors = n_colors;
+	if (n_colors > 0) {
+		compressed->palette = g_new (guint32, n_colors);
+		memcpy (compressed->palette, palette, n_colors * sizeof (guint32));
+	}
+	compressed->length = output->len;
+	compressed->data = g_byte_array_free (output, FALSE);
+
+	return compressed;
+}
+
+static cairo_surface_t *
+decompress_surface (CompressedSurface *compressed)
+{
+	cairo_surface_t *surface;
+	guint32         *pixels;
+	const guchar    *data = compressed->data;
+	const guchar    *end = compressed->data + compressed->length;
+	gsize            n_pixels, i = 0;
+
+	surface = cairo_image_surface_create (compressed->format,
+					      compressed->width,
+					      compressed->height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+	cairo_surface_flush (surface);
+	pixels = (guint32 *)cairo_image_surface_get_data (surface);
+	n_pixels = (gsize)compressed->width * compressed->height;
+
+	while (data < end && i < n_pixels) {
+		guint8 header = *data++;
+		gsize  len, j;
+
+		if (header < MAX_LITERAL_LEN) {
+			len = MIN ((gsize)header + 1, n_pixels - i);
+			for (j = 0; j < len; j++) {
+				if (compressed->n_colors > 0) {
+					pixels[i++] = compressed->palette[*data++];
+				} else {
+					memcpy (pixels + i++, data, 4);
+					data += 4;
+				}
+			}
+		} else {
+			guint32 pixel;
+
+			len = MIN ((gsize)header - 126, n_pixels - i);
+			if (compressed->n_colors > 0) {
+				pixel = compressed->palette[*data++];
+			} else {
+				memcpy (&pixel, data, 4);
+				data += 4;
+			}
+			ev_pixel_ops_fill (pixels + i, pixel, len);
+			i += len;
+		}
+	}
+
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+static void
+cache_entry_remove (CacheEntry *entry)
+{
+	g_queue_unlink (&lru, &entry->link);
+	cache_size -= entry->size;
+	g_hash_table_remove (entries, &entry->key);
+}
+
+static void
+trim_cache (gsize size)
+{
+	while (cache_size > size && lru.tail) {
+		CacheEntry *entry = lru.tail->data;
+
+		ev_debug_message (DEBUG_JOBS, "evicting page %d (%p)",
+				  entry->key.page, entry->key.document);
+		cache_entry_remove (entry);
+	}
+}
+
+static gsize
+get_budget (void)
+{
+	return max_size >> budget_shift;
+}
+
+static void
+remove_entries (EvDocument *document,
+		gint        page)
+{
+	GList *l, *next;
+
+	for (l = lru.head; l; l = next) {
+		CacheEntry *entry = l->data;
+
+		next = l->next;
+		if (entry->key.document == document &&
+		    (page == -1 || entry->key.page == page))
+			cache_entry_remove (entry);
+	}
+}
+
+static void
+document_finalized (gpointer data,
+		    GObject *document)
+{
+	remove_entries ((EvDocument *)document, -1);
+	g_hash_table_remove (documents, document);
+}
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+/* Drops the surfaces no view is using, like the ones rendered at a
+ * previous scale, and the compressed ones */
+static void
+remove_unused_entries (void)
+{
+	GList *l, *next;
+
+	for (l = lru.head; l; l = next) {
+		CacheEntry *entry = l->data;
+
+		next = l->next;
+		if (!entry->surface ||
+		    cairo_surface_get_reference_count (entry->surface) == 1)
+			cache_entry_remove (entry);
+	}
+}
+
+static gboolean
+recover_budget (gpointer data)
+{
+	if (ev_surface_cache_recover_budget ())
+		return G_SOURCE_CONTINUE;
+
+	recover_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+low_memory_warning_cb (GMemoryMonitor            *monitor,
+		       GMemoryMonitorWarningLevel level,
+		       gpointer                   data)
+{
+	ev_surface_cache_handle_low_memory (level);
+
+	/* Restart the recovery after every warning */
+	if (recover_id > 0)
+		g_source_remove (recover_id);
+	recover_id = g_timeout_add_seconds (RECOVER_INTERVAL, recover_budget, NULL);
+}
+
+/* Lowers the memory limit on a low memory warning, down to the minimum
+ * on critical ones, and from the medium level on drops the surfaces no
+ * view is using. The limit is raised back by
+ * ev_surface_cache_recover_budget(). */
+void
+ev_surface_cache_handle_low_memory (GMemoryMonitorWarningLevel level)
+{
+	if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+		budget_shift = MAX_BUDGET_SHIFT;
+	else
+		budget_shift = MIN (budget_shift + 1, MAX_BUDGET_SHIFT);
+
+	if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM && entries)
+		remove_unused_entries ();
+	trim_cache (get_budget ());
+
+	ev_debug_message (DEBUG_JOBS, "low memory warning %d: using %" G_GSIZE_FORMAT
+			  " of %" G_GSIZE_FORMAT, level, cache_size, get_budget ());
+}
+#endif
+
+/* Doubles the memory limit lowered by low memory warnings, which is
+ * done every RECOVER_INTERVAL seconds without warnings. Returns %TRUE
+ * while the limit is still lower than the configured one. */
+gboolean
+ev_surface_cache_recover_budget (void)
+{
+	if (budget_shift == 0)
+		return FALSE;
+
+	budget_shift--;
+	ev_debug_message (DEBUG_JOBS, "budget back to %" G_GSIZE_FORMAT, get_budget ());
+
+	return budget_shift > 0;
+}
+
+static void
+ensure_cache (void)
+{
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor *monitor;
+#endif
+
+	if (entries)
+		return;
+
+	entries = g_hash_table_new_full (cache_key_hash, cache_key_equal,
+					 NULL, (GDestroyNotify)cache_entry_free);
+	documents = g_hash_table_new (NULL, NULL);
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	/* The cache lives as long as the process, so does the monitor */
+	monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb), NULL);
+#endif
+}
+
+static void
+init_cache_key (CacheKey   *key,
+		EvDocument *document,
+		gint        page,
+		gint        rotation,
+		gint        width,
+		gint        height,
+		gint        device_scale,
+		gboolean    inverted)
+{
+	key->document = document;
+	key->page = page;
+	key->rotation = rotation;
+	key->width = width;
+	key->height = height;
+	key->device_scale = device_scale;
+	key->inverted = inverted;
+}
+
+static CacheEntry *
+lookup_entry (EvDocument *document,
+	      gint        page,
+	      gint        rotation,
+	      gint        width,
+	      gint        height,
+	      gint        device_scale,
+	      gboolean    inverted)
+{
+	CacheEntry *entry;
+	CacheKey    key;
+
+	if (!entries)
+		return NULL;
+
+	init_cache_key (&key, document, page, rotation, width, height,
+			device_scale, inverted);
+	entry = g_hash_table_lookup (entries, &key);
+	if (!entry)
+		return NULL;
+
+	g_queue_unlink (&lru, &entry->link);
+	g_queue_push_head_link (&lru, &entry->link);
+
+	return entry;
+}
+
+/* Returns a new reference to the cached surface, or %NULL. Compressed
+ * surfaces are decompressed into a new surface every time. */
+cairo_surface_t *
+ev_surface_cache_lookup (EvDocument *document,
+			 gint        page,
+			 gint        rotation,
+			 gint        width,
+			 gint        height,
+			 gint        device_scale,
+			 gboolean    inverted)
+{
+	CacheEntry      *entry;
+	cairo_surface_t *surface;
+
+	entry = lookup_entry (document, page, rotation, width, height,
+			      device_scale, inverted);
+	if (!entry)
+		return NULL;
+
+	if (entry->surface)
+		return cairo_surface_reference (entry->surface);
+
+	/* Without memory for the pixels, the page is rendered again */
+	surface = decompress_surface (entry->compressed);
+	if (!surface) {
+		cache_entry_remove (entry);
+		return NULL;
+	}
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_set_device_scale (surface, device_scale, device_scale);
+#endif
+	return surface;
+}
+
+/* Returns whether the page is cached, compressed or not, without
+ * decompressing it */
+gboolean
+ev_surface_cache_contains (EvDocument *document,
+			   gint        page,
+			   gint        rotation,
+			   gint        width,
+			   gint        height,
+			   gint        device_scale,
+			   gboolean    inverted)
+{
+	return lookup_entry (document, page, rotation, width, height,
+			     device_scale, inverted) != NULL;
+}
+
+static void
+insert_entry (CacheEntry *entry)
+{
+	CacheEntry *old;
+	EvDocument *document = entry->key.document;
+
+	ensure_cache ();
+
+	old = g_hash_table_lookup (entries, &entry->key);
+	if (old)
+		cache_entry_remove (old);
+
+	if (!g_hash_table_contains (documents, document)) {
+		g_object_weak_ref (G_OBJECT (document), document_finalized, NULL);
+		g_hash_table_add (documents, document);
+	}
+
+	g_hash_table_insert (entries, &entry->key, entry);
+	g_queue_push_head_link (&lru, &entry->link);
+	cache_size += entry->size;
+
+	trim_cache (get_budget ());
+}
+
+void
+ev_surface_cache_add (EvDocument      *document,
+		      gint             page,
+		      gint             rotation,
+		      gint             device_scale,
+		      gboolean         inverted,
+		      cairo_surface_t *surface)
+{
+	CacheEntry *entry;
+	gsize       size;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (!surface || cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return;
+
+	size = (gsize)cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+	if (size > get_budget ())
+		return;
+
+	entry = g_slice_new0 (CacheEntry);
+	init_cache_key (&entry->key, document, page, rotation,
+			cairo_image_surface_get_width (surface),
+			cairo_image_surface_get_height (surface),
+			device_scale, inverted);
+	entry->surface = cairo_surface_reference (surface);
+	entry->size = size;
+	entry->link.data = entry;
+
+	insert_entry (entry);
+}
+
+static void
+compress_surface_thread (GTask        *task,
+			 gpointer      source_object,
+			 gpointer      task_data,
+			 GCancellable *cancellable)
+{
+	g_task_return_pointer (task, compress_surface (task_data),
+			       (GDestroyNotify) compressed_surface_free);
+}
+
+/* Compresses @surface in a worker thread, so the main thread doesn't
+ * wait for it. The surface must not be modified until @callback is
+ * called, which as usual for the cached surfaces is never. */
+void
+ev_surface_cache_compress_async (GObject            *source_object,
+				 cairo_surface_t    *surface,
+				 GAsyncReadyCallback callback,
+				 gpointer            user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (surface != NULL);
+
+	task = g_task_new (source_object, NULL, callback, user_data);
+	g_task_set_source_tag (task, ev_surface_cache_compress_async);
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+		g_task_return_pointer (task, NULL, NULL);
+		g_object_unref (task);
+		return;
+	}
+
+	cairo_surface_flush (surface);
+	g_task_set_task_data (task, cairo_surface_reference (surface),
+			      (GDestroyNotify) cairo_surface_destroy);
+	g_task_run_in_thread (task, compress_surface_thread);
+	g_object_unref (task);
+}
+
+/* Like ev_surface_cache_add(), but adds the surface compressed by
+ * ev_surface_cache_compress_async(), replacing the uncompressed entry
+ * if any. Returns the size of the compressed data, or 0 if the surface
+ * doesn't compress well and was not added. The caller can then drop
+ * its reference to the surface and look it up again when it's needed.
+ * Callers that are no longer interested in the surface can just not
+ * call this. */
+gsize
+ev_surface_cache_add_compressed_finish (EvDocument   *document,
+					gint          page,
+					gint          rotation,
+					gint          device_scale,
+					gboolean      inverted,
+					GAsyncResult *result)
+{
+	CompressedSurface *compressed;
+	CacheEntry        *entry;
+	gsize              size;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), 0);
+	g_return_val_if_fail (g_task_is_valid (result, NULL), 0);
+
+	compressed = g_task_propagate_pointer (G_TASK (result), NULL);
+	if (!compressed)
+		return 0;
+
+	size = compressed->length + compressed->n_colors * sizeof (guint32);
+	if (size > get_budget ()) {
+		compressed_surface_free (compressed);
+		return 0;
+	}
+
+	ev_debug_message (DEBUG_JOBS, "page %d compressed from %d to %" G_GSIZE_FORMAT " bytes",
+			  page, compressed->width * compressed->height * 4, size);
+
+	entry = g_slice_new0 (CacheEntry);
+	init_cache_key (&entry->key, document, page, rotation,
+			compressed->width, compressed->height,
+			device_scale, inverted);
+	entry->compressed = compressed;
+	entry->size = size;
+	entry->link.data = entry;
+
+	insert_entry (entry);
+
+	return size;
+}
+
+/* Drops the cached renders of @page, when its contents changed */
+void
+ev_surface_cache_remove_page (EvDocument *document,
+			      gint        page)
+{
+	if (entries)
+		remove_entries (document, page);
+}
+
+/* Drops all the cached renders of @document */
+void
+ev_surface_cache_remove_document (EvDocument *document)
+{
+	if (entries)
+		remove_entries (document, -1);
+}
+
+/* Returns a copy of @surface, with its colors inverted if @invert is
+ * %TRUE. Shared surfaces must be copied instead of modified in place.
+ * The pixels are copied as they are, whatever the device scale of
+ * @surface is. */
+cairo_surface_t *
+ev_surface_cache_copy_surface (cairo_surface_t *surface,
+			       gboolean         invert)
+{
+	cairo_surface_t *copy;
+	const guchar    *src;
+	guchar          *dest;
+	gint             height, src_stride, dest_stride, y;
+
+	if (!surface)
+		return NULL;
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return cairo_surface_reference (surface);
+
+	cairo_surface_flush (surface);
+
+	height = cairo_image_surface_get_height (surface);
+	copy = cairo_image_surface_create (cairo_image_surface_get_format (surface),
+					   cairo_image_surface_get_width (surface),
+					   height);
+
+	src = cairo_image_surface_get_data (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	dest = cairo_image_surface_get_data (copy);
+	dest_stride = cairo_image_surface_get_stride (copy);
+	for (y = 0; y < height; y++)
+		memcpy (dest + y * dest_stride, src + y * src_stride, MIN (src_stride, dest_stride));
+
+	cairo_surface_mark_dirty (copy);
+
+	if (invert)
+		ev_document_misc_invert_surface (copy);
+
+	return copy;
+}
+
+/* Sets the memory limit of the cache, in bytes, for all the views.
+ * Use 0 to disable caching rendered pages. */
+void
+ev_surface_cache_set_max_size (gsize size)
+{
+	if (max_size == size)
+		return;
+
+	max_size = size;
+	trim_cache (get_budget ());
+}
+
+/* Returns the memory limit currently applied, which is lower than the
+ * one set while the system is low on memory */
+gsize
+ev_surface_cache_get_max_size (void)
+{
+	return get_budget ();
+}
+
+/* Views register while they are alive, so that the pages each of them
+ * keeps around don't add up to more than the limit */
+void
+ev_surface_cache_add_view (void)
+{
+	n_views++;
+}
+
+void
+ev_surface_cache_remove_view (void)
+{
+	g_return_if_fail (n_views > 0);
+
+	n_views--;
+}
+
+/* Returns the share of the memory limit currently applied that each of
+ * the live views can use for the pages it keeps */
+gsize
+ev_surface_cache_get_view_budget (void)
+{
+	return get_budget () / MAX (n_views, 1);
+}
+
+/* Returns the memory used by the cached surfaces, in bytes */
+gsize
+ev_surface_cache_get_size (void)
+{
+	return cache_size;
+}
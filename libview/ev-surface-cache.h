@@ -0,0 +1,92 @@
+/* ev-surface-cache.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#include <cairo.h>
+
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+/* A cache of rendered pages shared by all the views in the process, so
+ * that several windows or views on the same document don't keep the
+ * same page twice. Surfaces are looked up by document, page, rotation,
+ * size in device pixels, device scale and whether their colors are
+ * inverted; the render scale is implied by the size. The surfaces are
+ * shared, so they must not be modified once added. Pages that are not
+ * visible can be stored compressed, and are decompressed on lookup.
+ * Compression runs in a worker thread, but the cache itself must only
+ * be used from the main thread.
+ */
+
+cairo_surface_t *ev_surface_cache_lookup          (EvDocument      *document,
+						   gint             page,
+						   gint             rotation,
+						   gint             width,
+						   gint             height,
+						   gint             device_scale,
+						   gboolean         inverted);
+void             ev_surface_cache_add             (EvDocument      *document,
+						   gint             page,
+						   gint             rotation,
+						   gint             device_scale,
+						   gboolean         inverted,
+						   cairo_surface_t *surface);
+void             ev_surface_cache_compress_async  (GObject            *source_object,
+						   cairo_surface_t    *surface,
+						   GAsyncReadyCallback callback,
+						   gpointer            user_data);
+gsize            ev_surface_cache_add_compressed_finish (EvDocument   *document,
+							 gint          page,
+							 gint          rotation,
+							 gint          device_scale,
+							 gboolean      inverted,
+							 GAsyncResult *result);
+gboolean         ev_surface_cache_contains        (EvDocument      *document,
+						   gint             page,
+						   gint             rotation,
+						   gint             width,
+						   gint             height,
+						   gint             device_scale,
+						   gboolean         inverted);
+void             ev_surface_cache_remove_page     (EvDocument      *document,
+						   gint             page);
+void             ev_surface_cache_remove_document (EvDocument      *document);
+
+cairo_surface_t *ev_surface_cache_copy_surface    (cairo_surface_t *surface,
+						   gboolean         invert);
+
+void             ev_surface_cache_set_max_size    (gsize            max_size);
+gsize            ev_surface_cache_get_max_size    (void);
+gsize            ev_surface_cache_get_size        (void);
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+void             ev_surface_cache_handle_low_memory (GMemoryMonitorWarningLevel level);
+#endif
+gboolean         ev_surface_cache_recover_budget  (void);
+
+void             ev_surface_cache_add_view        (void);
+void             ev_surface_cache_remove_view     (void);
+gsize            ev_surface_cache_get_view_budget (void);
+
+G_END_DECLS
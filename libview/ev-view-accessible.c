@@ -64,10 +64,28 @@ struct _EvViewAccessiblePrivate {
 	gint start_page;
 	gint end_page;
 	AtkObject *focused_element;
+	gint focused_element_page;
 
+	/* One slot per page, filled on demand */
 	GPtrArray *children;
+	guint      n_cached_children;
+	/* Pages handed out through ref_child */
+	gboolean  *exposed;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor *memory_monitor;
+#endif
 };
 
+/* Page accessibles are created lazily, as most of them are never
+ * requested for large documents. Once more than this number are alive,
+ * the ones outside the visible range that were never handed out to an
+ * assistive technology are released again. The index of a page never
+ * changes, a released page is simply created again the next time it's
+ * requested.
+ */
+#define MAX_CACHED_CHILDREN 64
+
 G_DEFINE_TYPE_WITH_CODE (EvViewAccessible, ev_view_accessible, GTK_TYPE_CONTAINER_ACCESSIBLE,
 			 G_ADD_PRIVATE (EvViewAccessible)
 			 G_IMPLEMENT_INTERFACE (ATK_TYPE_ACTION, ev_view_accessible_action_iface_init)
@@ -91,10 +109,102 @@ clear_children (EvViewAccessible *self)
 
 	for (i = 0; i < self->priv->children->len; i++) {
 		child = g_ptr_array_index (self->priv->children, i);
-		atk_object_notify_state_change (child, ATK_STATE_DEFUNCT, TRUE);
+		if (child)
+			atk_object_notify_state_change (child, ATK_STATE_DEFUNCT, TRUE);
 	}
 
 	g_clear_pointer (&self->priv->children, g_ptr_array_unref);
+	g_clear_pointer (&self->priv->exposed, g_free);
+	self->priv->n_cached_children = 0;
+	self->priv->focused_element = NULL;
+	self->priv->focused_element_page = -1;
+}
+
+static gboolean
+page_is_pinned (EvViewAccessible *self,
+		gint              page)
+{
+	EvViewAccessiblePrivate *priv = self->priv;
+
+	return (page >= priv->start_page && page <= priv->end_page) ||
+		page == priv->previous_cursor_page ||
+		page == priv->focused_element_page;
+}
+
+static void
+release_child (EvViewAccessible *self,
+	       gint              page)
+{
+	EvViewAccessiblePrivate *priv = self->priv;
+	AtkObject *child = g_ptr_array_index (priv->children, page);
+
+	/* Events may have reached assistive technologies that still
+	 * hold it, tell them to drop it as when the document changes */
+	atk_object_notify_state_change (child, ATK_STATE_DEFUNCT, TRUE);
+
+	priv->children->pdata[page] = NULL;
+	priv->exposed[page] = FALSE;
+	priv->n_cached_children--;
+	g_object_unref (child);
+}
+
+static void
+trim_children (EvViewAccessible *self)
+{
+	EvViewAccessiblePrivate *priv = self->priv;
+	gint i;
+
+	if (priv->children == NULL || priv->n_cached_children <= MAX_CACHED_CHILDREN)
+		return;
+
+	for (i = 0; i < priv->children->len; i++) {
+		if (g_ptr_array_index (priv->children, i) == NULL ||
+		    priv->exposed[i] || page_is_pinned (self, i))
+			continue;
+
+		release_child (self, i);
+
+		if (priv->n_cached_children <= MAX_CACHED_CHILDREN / 2)
+			break;
+	}
+}
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+/* When the system is low on memory, the pages that were created for
+ * events beyond the limit are released without waiting for the next
+ * ref_child. The pages handed out to assistive technologies are kept,
+ * they may still be holding them. */
+static void
+low_memory_warning_cb (GMemoryMonitor            *monitor,
+		       GMemoryMonitorWarningLevel level,
+		       EvViewAccessible          *self)
+{
+	if (level < G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+		return;
+
+	trim_children (self);
+}
+#endif
+
+static EvPageAccessible *
+get_page_accessible (EvViewAccessible *self,
+		     gint              page)
+{
+	EvViewAccessiblePrivate *priv = self->priv;
+	EvPageAccessible *child;
+
+	if (priv->children == NULL || page < 0 || page >= priv->children->len)
+		return NULL;
+
+	child = g_ptr_array_index (priv->children, page);
+	if (child)
+		return child;
+
+	child = ev_page_accessible_new (self, page);
+	priv->children->pdata[page] = child;
+	priv->n_cached_children++;
+
+	return child;
 }
 
 static void
@@ -107,6 +217,12 @@ ev_view_accessible_finalize (GObject *object)
 		g_signal_handlers_disconnect_by_data (priv->model, object);
 		g_clear_object (&priv->model);
 	}
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	if (priv->memory_monitor) {
+		g_signal_handlers_disconnect_by_data (priv->memory_monitor, object);
+		g_clear_object (&priv->memory_monitor);
+	}
+#endif
 	if (priv->action_idle_handler)
 		g_source_remove (priv->action_idle_handler);
 	for (i = 0; i < LAST_ACTION; i++)
@@ -135,6 +251,7 @@ ev_view_accessible_initialize (AtkObject *obj,
 	priv->previous_cursor_page = -1;
 	priv->start_page = 0;
 	priv->end_page = -1;
+	priv->focused_element_page = -1;
 }
 
 gint
@@ -149,10 +266,11 @@ ev_view_accessible_ref_child (AtkObject *obj,
 {
 	EvViewAccessible *self;
 	EvView *view;
+	EvPageAccessible *child;
 
 	g_return_val_if_fail (EV_IS_VIEW_ACCESSIBLE (obj), NULL);
 	self = EV_VIEW_ACCESSIBLE (obj);
-	g_return_val_if_fail (i >= 0 || i < ev_view_accessible_get_n_pages (self), NULL);
+	g_return_val_if_fail (i >= 0 && i < ev_view_accessible_get_n_pages (self), NULL);
 
 	view = EV_VIEW (gtk_accessible_get_widget (GTK_ACCESSIBLE (obj)));
 	if (view == NULL)
@@ -163,7 +281,11 @@ ev_view_accessible_ref_child (AtkObject *obj,
 	if (view->page_cache)
 		ev_page_cache_ensure_page (view->page_cache, i);
 
-	return g_object_ref (g_ptr_array_index (self->priv->children, i));
+	child = g_object_ref (get_page_accessible (self, i));
+	self->priv->exposed[i] = TRUE;
+	trim_children (self);
+
+	return ATK_OBJECT (child);
 }
 
 static gint
@@ -188,6 +310,12 @@ static void
 ev_view_accessible_init (EvViewAccessible *accessible)
 {
 	accessible->priv = ev_view_accessible_get_instance_private (accessible);
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	accessible->priv->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (accessible->priv->memory_monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb), accessible);
+#endif
 }
 
 #if ATK_CHECK_VERSION (2, 11, 3)
@@ -336,13 +464,15 @@ ev_view_accessible_cursor_moved (EvView *view,
 
 		if (priv->previous_cursor_page >= 0) {
 			AtkObject *previous_page = NULL;
+			/* Nobody can be listening to a page that was never created */
 			previous_page = g_ptr_array_index (priv->children,
 							   priv->previous_cursor_page);
-			atk_object_notify_state_change (previous_page, ATK_STATE_FOCUSED, FALSE);
+			if (previous_page)
+				atk_object_notify_state_change (previous_page, ATK_STATE_FOCUSED, FALSE);
 		}
 
 		priv->previous_cursor_page = page;
-		current_page = g_ptr_array_index (priv->children, page);
+		current_page = ATK_OBJECT (get_page_accessible (accessible, page));
 		atk_object_notify_state_change (current_page, ATK_STATE_FOCUSED, TRUE);
 
 #if ATK_CHECK_VERSION (2, 11, 2)
@@ -351,8 +481,9 @@ ev_view_accessible_cursor_moved (EvView *view,
 #endif
 	}
 
-	page_accessible = g_ptr_array_index (priv->children, page);
+	page_accessible = get_page_accessible (accessible, page);
 	g_signal_emit_by_name (page_accessible, "text-caret-moved", offset);
+	trim_children (accessible);
 }
 
 static void
@@ -361,9 +492,10 @@ ev_view_accessible_selection_changed (EvView *view,
 {
 	AtkObject *page_accessible;
 
-	page_accessible = g_ptr_array_index (view_accessible->priv->children,
-					     get_relevant_page (view));
-	g_signal_emit_by_name (page_accessible, "text-selection-changed");
+	page_accessible = ATK_OBJECT (get_page_accessible (view_accessible,
+							   get_relevant_page (view)));
+	if (page_accessible)
+		g_signal_emit_by_name (page_accessible, "text-selection-changed");
 }
 
 static void
@@ -384,19 +516,16 @@ page_changed_cb (EvDocumentModel  *model,
 static void
 initialize_children (EvViewAccessible *self)
 {
-	gint i;
-	EvPageAccessible *child;
 	gint n_pages;
 	EvDocument *ev_document;
 
 	ev_document = ev_document_model_get_document (self->priv->model);
 	n_pages = ev_document_get_n_pages (ev_document);
 
+	/* Page accessibles are created on demand, see get_page_accessible() */
 	self->priv->children = g_ptr_array_new_full (n_pages, (GDestroyNotify) g_object_unref);
-	for (i = 0; i < n_pages; i++) {
-		child = ev_page_accessible_new (self, i);
-		g_ptr_array_add (self->priv->children, child);
-	}
+	g_ptr_array_set_size (self->priv->children, n_pages);
+	self->priv->exposed = g_new0 (gboolean, n_pages);
 
         /* When a document is reloaded, it may have less pages.
          * We need to update the end page accordingly to avoid
@@ -469,8 +598,11 @@ ev_view_accessible_focus_changed (GtkWidget        *widget,
 	if (self->priv->children == NULL || self->priv->children->len == 0)
 		return FALSE;
 
-	page_accessible = g_ptr_array_index (self->priv->children,
-					     get_relevant_page (EV_VIEW (widget)));
+	page_accessible = ATK_OBJECT (get_page_accessible (self,
+							   get_relevant_page (EV_VIEW (widget))));
+	if (page_accessible == NULL)
+		return FALSE;
+
 	atk_object_notify_state_change (page_accessible,
 					ATK_STATE_FOCUSED, event->in);
 
@@ -596,19 +728,23 @@ ev_view_accessible_set_page_range (EvViewAccessible *accessible,
 	for (i = accessible->priv->start_page; i <= accessible->priv->end_page; i++) {
 		if (i < start || i > end) {
 			page = g_ptr_array_index (accessible->priv->children, i);
-			atk_object_notify_state_change (page, ATK_STATE_SHOWING, FALSE);
+			if (page)
+				atk_object_notify_state_change (page, ATK_STATE_SHOWING, FALSE);
 		}
 	}
 
 	for (i = start; i <= end; i++) {
 		if (i < accessible->priv->start_page || i > accessible->priv->end_page) {
-			page = g_ptr_array_index (accessible->priv->children, i);
-			atk_object_notify_state_change (page, ATK_STATE_SHOWING, TRUE);
+			page = ATK_OBJECT (get_page_accessible (accessible, i));
+			if (page)
+				atk_object_notify_state_change (page, ATK_STATE_SHOWING, TRUE);
 		}
 	}
 
 	accessible->priv->start_page = start;
 	accessible->priv->end_page = end;
+
+	trim_children (accessible);
 }
 
 void
@@ -622,11 +758,16 @@ ev_view_accessible_set_focused_element (EvViewAccessible *accessible,
 		atk_object_notify_state_change (accessible->priv->focused_element, ATK_STATE_FOCUSED, FALSE);
 		accessible->priv->focused_element = NULL;
 	}
+	accessible->priv->focused_element_page = -1;
 
 	if (!new_focus || new_focus_page == -1)
 		return;
 
-	page = g_ptr_array_index (accessible->priv->children, new_focus_page);
+	page = get_page_accessible (accessible, new_focus_page);
+	if (page == NULL)
+		return;
+
+	accessible->priv->focused_element_page = new_focus_page;
 	accessible->priv->focused_element = ev_page_accessible_get_accessible_for_mapping (page, new_focus);
 	if (accessible->priv->focused_element)
 		atk_object_notify_state_change (accessible->priv->focused_element, ATK_STATE_FOCUSED, TRUE);
@@ -639,6 +780,8 @@ ev_view_accessible_update_element_state (EvViewAccessible *accessible,
 {
 	EvPageAccessible *page;
 
+	/* Pages that were never created have no element state to update */
 	page = g_ptr_array_index (accessible->priv->children, element_page);
-	ev_page_accessible_update_element_state (page, element);
+	if (page)
+		ev_page_accessible_update_element_state (page, element);
 }
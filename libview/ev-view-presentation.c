@@ -30,6 +30,7 @@
 #include "ev-transition-animation.h"
 #include "ev-view-cursor.h"
 #include "ev-page-cache.h"
+#include "ev-surface-cache.h"
 #ifdef GDK_WINDOWING_WAYLAND
 #include <gdk/gdkwayland.h>
 #endif
@@ -275,16 +276,42 @@ ev_view_presentation_transition_animation_frame (EvViewPresentation *pview,
 	gtk_widget_queue_draw (GTK_WIDGET (pview));
 }
 
+static gint
+get_device_scale (EvViewPresentation *pview)
+{
+#ifdef HAVE_HIDPI_SUPPORT
+	return gtk_widget_get_scale_factor (GTK_WIDGET (pview));
+#else
+	return 1;
+#endif
+}
+
+/* The surface of a render job may be shared with other requesters, so
+ * the one we draw, with the colors inverted or taken from the surface
+ * cache, is attached to the job instead */
+#define JOB_SURFACE_KEY "ev-presentation-surface"
+
+static cairo_surface_t *
+get_job_surface (EvJob *job)
+{
+	return job ? g_object_get_data (G_OBJECT (job), JOB_SURFACE_KEY) : NULL;
+}
+
+static void
+set_job_surface (EvJob           *job,
+		 cairo_surface_t *surface)
+{
+	g_object_set_data_full (G_OBJECT (job), JOB_SURFACE_KEY, surface,
+				(GDestroyNotify)cairo_surface_destroy);
+}
+
 static cairo_surface_t *
 get_surface_from_job (EvViewPresentation *pview,
                       EvJob              *job)
 {
         cairo_surface_t *surface;
 
-        if (!job)
-                return NULL;
-
-        surface = EV_JOB_RENDER(job)->surface;
+        surface = get_job_surface (job);
         if (!surface)
                 return NULL;
 
@@ -320,7 +347,7 @@ ev_view_presentation_animation_start (EvViewPresentation *pview,
 
 	pview->animation = ev_transition_animation_new (effect);
 
-	surface = pview->curr_job ? EV_JOB_RENDER (pview->curr_job)->surface : NULL;
+	surface = get_job_surface (pview->curr_job);
 	ev_transition_animation_set_origin_surface (pview->animation,
 						    surface != NULL ?
 						    surface : pview->current_surface);
@@ -351,8 +378,19 @@ job_finished_cb (EvJob              *job,
 {
 	EvJobRender *job_render = EV_JOB_RENDER (job);
 
-	if (pview->inverted_colors)
-		ev_document_misc_invert_surface (job_render->surface);
+	if (!get_job_surface (job) && !ev_job_is_failed (job)) {
+		cairo_surface_t *surface;
+
+		if (pview->inverted_colors)
+			surface = ev_surface_cache_copy_surface (job_render->surface, TRUE);
+		else
+			surface = cairo_surface_reference (job_render->surface);
+		ev_surface_cache_add (pview->document, job_render->page,
+				      job_render->rotation,
+				      get_device_scale (pview),
+				      pview->inverted_colors, surface);
+		set_job_surface (job, surface);
+	}
 
 	if (job != pview->curr_job)
 		return;
@@ -371,26 +409,35 @@ ev_view_presentation_schedule_new_job (EvViewPresentation *pview,
 				       gint                page,
 				       EvJobPriority       priority)
 {
-	EvJob *job;
-        int    view_width, view_height;
+	EvJob           *job;
+	cairo_surface_t *surface;
+        int              view_width, view_height;
+	gint             device_scale;
 
 	if (page < 0 || page >= ev_document_get_n_pages (pview->document))
 		return NULL;
 
         ev_view_presentation_get_view_size (pview, page, &view_width, &view_height);
-#ifdef HAVE_HIDPI_SUPPORT
-	{
-		gint device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (pview));
-		view_width *= device_scale;
-		view_height *= device_scale;
-	}
-#endif
+	device_scale = get_device_scale (pview);
+	view_width *= device_scale;
+	view_height *= device_scale;
+
         job = ev_job_render_new (pview->document, page, pview->rotation, 0.,
                                  view_width, view_height);
 	g_signal_connect (job, "finished",
 			  G_CALLBACK (job_finished_cb),
 			  pview);
-	ev_job_scheduler_push_job (job, priority);
+
+	/* Pages already rendered by another view don't need a job */
+	surface = ev_surface_cache_lookup (pview->document, page, pview->rotation,
+					   view_width, view_height, device_scale,
+					   pview->inverted_colors);
+	if (surface) {
+		set_job_surface (job, surface);
+		ev_job_succeeded (job);
+	} else {
+		ev_job_scheduler_push_job (job, priority);
+	}
 
 	return job;
 }
@@ -518,7 +565,7 @@ ev_view_presentation_update_current_page (EvViewPresentation *pview,
 		ev_view_presentation_set_cursor_for_location (pview, x, y);
 	}
 
-	if (EV_JOB_RENDER (pview->curr_job)->surface)
+	if (get_job_surface (pview->curr_job))
 		gtk_widget_queue_draw (GTK_WIDGET (pview));
 }
 
@@ -209,6 +209,7 @@ struct _EvView {
 	GtkWidget *loading_window;
 	guint loading_timeout;
 	gboolean allow_links_change_zoom;
+	gboolean compress_preloaded_pages;
 
 	/* Common for button press handling */
 	int pressed_button;
@@ -306,6 +307,8 @@ struct _EvViewClass {
 				       gint            count,
 				       gboolean        extend_selection);
 	void     (*activate)          (EvView         *view);
+	void     (*page_rendered)     (EvView         *view,
+				       gint            page);
 };
 
 void _get_page_size_for_scale_and_rotation (EvDocument *document,
@@ -38,6 +38,7 @@
 #include "ev-form-field-private.h"
 #include "ev-pixbuf-cache.h"
 #include "ev-page-cache.h"
+#include "ev-surface-cache.h"
 #include "ev-view-marshal.h"
 #include "ev-document-annotations.h"
 #include "ev-annotation-window.h"
@@ -66,6 +67,7 @@ enum {
 	SIGNAL_MOVE_CURSOR,
 	SIGNAL_CURSOR_MOVED,
 	SIGNAL_ACTIVATE,
+	SIGNAL_PAGE_RENDERED,
 	N_SIGNALS
 };
 
@@ -157,10 +159,16 @@ static void       get_link_area                              (EvView
 							      gint                y,
 							      EvLink             *link,
 							      GdkRectangle       *area);
+static void       link_preview_get_area                      (EvView             *view,
+							      gint                pwidth,
+							      gint                pheight,
+							      GdkRectangle       *area);
 static void       link_preview_show_thumbnail                (cairo_surface_t    *page_surface,
 							      EvView             *view);
 static void       link_preview_job_finished_cb               (EvJobThumbnail     *job,
 							      EvView             *view);
+static void       link_preview_render_finished_cb            (EvJobRender        *job,
+							      EvView             *view);
 static gboolean   link_preview_popover_motion_notify         (EvView             *view,
 							      GdkEventMotion     *event);
 static gboolean   link_preview_delayed_show                  (EvView *view);
@@ -2289,17 +2297,10 @@ handle_cursor_over_link (EvView *view, EvLink *link, gint x, gint y)
 	gtk_container_add (GTK_CONTAINER (popover) , spinner);
 	gtk_widget_show (spinner);
 
-	/* Start thumbnailing job async */
 	link_dest_page = ev_link_dest_get_page (dest);
 #ifdef HAVE_HIDPI_SUPPORT
 	device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (view));
 #endif
-	view->link_preview.job = ev_job_thumbnail_new (view->document,
-						       link_dest_page,
-						       view->rotation,
-						       view->scale * device_scale);
-	ev_job_thumbnail_set_output_format (EV_JOB_THUMBNAIL (view->link_preview.job),
-					    EV_JOB_THUMBNAIL_SURFACE);
 
 	link_dest_doc.x = ev_link_dest_get_left (dest, NULL);
 	link_dest_doc.y = ev_link_dest_get_top (dest, NULL);
@@ -2311,13 +2312,42 @@ handle_cursor_over_link (EvView *view, EvLink *link, gint x, gint y)
 
 	page_surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, link_dest_page);
 
-	if (page_surface)
+	if (page_surface) {
 		link_preview_show_thumbnail (page_surface, view);
-	else {
+	} else if (ev_document_can_render_region (view->document)) {
+		GdkRectangle area;
+		gint         pwidth, pheight;
+
+		/* Only render the part of the page shown in the popover */
+		ev_view_get_page_size (view, link_dest_page, &pwidth, &pheight);
+		link_preview_get_area (view, pwidth, pheight, &area);
+		area.x *= device_scale;
+		area.y *= device_scale;
+		area.width *= device_scale;
+		area.height *= device_scale;
+
+		view->link_preview.job = ev_job_render_new (view->document,
+							    link_dest_page,
+							    view->rotation,
+							    view->scale * device_scale,
+							    pwidth * device_scale,
+							    pheight * device_scale);
+		ev_job_render_set_area (EV_JOB_RENDER (view->link_preview.job), &area);
+		g_signal_connect (view->link_preview.job, "finished",
+				  G_CALLBACK (link_preview_render_finished_cb),
+				  view);
+		ev_job_scheduler_push_job (view->link_preview.job, EV_JOB_PRIORITY_URGENT);
+	} else {
+		view->link_preview.job = ev_job_thumbnail_new (view->document,
+							       link_dest_page,
+							       view->rotation,
+							       view->scale * device_scale);
+		ev_job_thumbnail_set_output_format (EV_JOB_THUMBNAIL (view->link_preview.job),
+						    EV_JOB_THUMBNAIL_SURFACE);
 		g_signal_connect (view->link_preview.job, "finished",
 				  G_CALLBACK (link_preview_job_finished_cb),
 				  view);
-		ev_job_scheduler_push_job (view->link_preview.job, EV_JOB_PRIORITY_LOW);
+		ev_job_scheduler_push_job (view->link_preview.job, EV_JOB_PRIORITY_URGENT);
 	}
 
 	if (type == EV_LINK_DEST_TYPE_NAMED)
@@ -5257,30 +5287,20 @@ get_field_area (EvView       *view,
 	ev_view_get_area_from_mapping (view, page, field_mapping, field, area);
 }
 
+/* Computes the part of the destination page, of @pwidth x @pheight
+ * pixels, that is shown in the link preview */
 static void
-link_preview_show_thumbnail (cairo_surface_t *page_surface,
-			     EvView *view)
+link_preview_get_area (EvView       *view,
+		       gint          pwidth,
+		       gint          pheight,
+		       GdkRectangle *area)
 {
-	GtkWidget       *popover = view->link_preview.popover;
-	GtkWidget       *image_view;
 	gdouble          x, y;   /* position of the link on destination page */
-	gint             pwidth, pheight;  /* dimensions of destination page */
 	gint             vwidth, vheight;  /* dimensions of main view */
-	gint             width, height;    /* dimensions of popup */
-	gint             left, top;
-	gdouble          device_scale_x = 1, device_scale_y = 1;
-	cairo_surface_t *thumbnail_slice;
-	cairo_t         *cr;
 
 	x = view->link_preview.left;
 	y = view->link_preview.top;
 
-#ifdef HAVE_HIDPI_SUPPORT
-	cairo_surface_get_device_scale (page_surface, &device_scale_x, &device_scale_y);
-#endif
-	pwidth = cairo_image_surface_get_width (page_surface) / device_scale_x;
-	pheight = cairo_image_surface_get_height (page_surface) / device_scale_y;
-
 	vwidth = gtk_widget_get_allocated_width (GTK_WIDGET (view));
 	vheight = gtk_widget_get_allocated_height (GTK_WIDGET (view));
 
@@ -5290,8 +5310,8 @@ link_preview_show_thumbnail (cairo_surface_t *page_surface,
 	 * of the main view. The idea is avoid the popup dominte the main view,
 	 * and the reader can see context both in the popup and the main page.
 	 */
-	width = MIN (pwidth, vwidth);
-	height = MIN (pheight, (int)(vheight * LINK_PREVIEW_PAGE_RATIO));
+	area->width = MAX (MIN (pwidth, vwidth), 1);
+	area->height = MAX (MIN (pheight, (int)(vheight * LINK_PREVIEW_PAGE_RATIO)), 1);
 
 	/* Position on the destination page that will be in the top left
 	 * corner of the popup. We choose the link destination to be centered
@@ -5305,27 +5325,56 @@ link_preview_show_thumbnail (cairo_surface_t *page_surface,
 	 * caption below the figure, so seeing a little of the figure above is
 	 * often enough to remind the reader of the rest of the figure.
 	 */
-	left = x - width * LINK_PREVIEW_HORIZONTAL_LINK_POS;
-	top = y - height * LINK_PREVIEW_VERTICAL_LINK_POS;
+	area->x = x - area->width * LINK_PREVIEW_HORIZONTAL_LINK_POS;
+	area->y = y - area->height * LINK_PREVIEW_VERTICAL_LINK_POS;
 
 	/* link preview destination should stay within the destination page: */
-	left = MIN (MAX (0, left), pwidth - width);
-	top = MIN (MAX (0, top), pheight - height);
+	area->x = MAX (MIN (area->x, pwidth - area->width), 0);
+	area->y = MAX (MIN (area->y, pheight - area->height), 0);
+}
 
-	/* paint out the part of the page we want to a separate cairo_surface_t */
-	thumbnail_slice = cairo_surface_create_similar (page_surface, CAIRO_CONTENT_COLOR, width, height);
-	cr = cairo_create (thumbnail_slice);
-	cairo_set_source_surface (cr, page_surface, -left, -top);
-	cairo_rectangle (cr, 0, 0, width, height);
-	cairo_fill (cr);
+static void
+link_preview_show_surface (cairo_surface_t *surface,
+			   EvView          *view)
+{
+	GtkWidget *popover = view->link_preview.popover;
+	GtkWidget *image_view;
 
-	image_view = gtk_image_new_from_surface (thumbnail_slice);
+	image_view = gtk_image_new_from_surface (surface);
 
 	gtk_widget_destroy (gtk_bin_get_child (GTK_BIN (popover)));
 	gtk_container_add (GTK_CONTAINER (popover), image_view);
 	gtk_widget_show (image_view);
+}
 
+static void
+link_preview_show_thumbnail (cairo_surface_t *page_surface,
+			     EvView *view)
+{
+	gint             pwidth, pheight;  /* dimensions of destination page */
+	GdkRectangle     area;
+	gdouble          device_scale_x = 1, device_scale_y = 1;
+	cairo_surface_t *thumbnail_slice;
+	cairo_t         *cr;
+
+#ifdef HAVE_HIDPI_SUPPORT
+	cairo_surface_get_device_scale (page_surface, &device_scale_x, &device_scale_y);
+#endif
+	pwidth = cairo_image_surface_get_width (page_surface) / device_scale_x;
+	pheight = cairo_image_surface_get_height (page_surface) / device_scale_y;
+
+	link_preview_get_area (view, pwidth, pheight, &area);
+
+	/* paint out the part of the page we want to a separate cairo_surface_t */
+	thumbnail_slice = cairo_surface_create_similar (page_surface, CAIRO_CONTENT_COLOR,
+							area.width, area.height);
+	cr = cairo_create (thumbnail_slice);
+	cairo_set_source_surface (cr, page_surface, -area.x, -area.y);
+	cairo_rectangle (cr, 0, 0, area.width, area.height);
+	cairo_fill (cr);
 	cairo_destroy (cr);
+
+	link_preview_show_surface (thumbnail_slice, view);
 	cairo_surface_destroy (thumbnail_slice);
 }
 
@@ -5351,8 +5400,9 @@ static void
 link_preview_job_finished_cb (EvJobThumbnail *job,
 			      EvView *view)
 {
-	GtkWidget *popover = view->link_preview.popover;
-	gint       device_scale = 1;
+	GtkWidget       *popover = view->link_preview.popover;
+	cairo_surface_t *surface;
+	gint             device_scale = 1;
 
 	if (ev_job_is_failed (EV_JOB (job))) {
 		gtk_widget_destroy (popover);
@@ -5363,15 +5413,54 @@ link_preview_job_finished_cb (EvJobThumbnail *job,
 		return;
 	}
 
+	/* The thumbnail may still be copied for other requesters */
+	if (ev_document_model_get_inverted_colors (view->model))
+		surface = ev_surface_cache_copy_surface (job->thumbnail_surface, TRUE);
+	else
+		surface = cairo_surface_reference (job->thumbnail_surface);
+
 #ifdef HAVE_HIDPI_SUPPORT
         device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (view));
-        cairo_surface_set_device_scale (job->thumbnail_surface, device_scale, device_scale);
+        cairo_surface_set_device_scale (surface, device_scale, device_scale);
 #endif
 
+	link_preview_show_thumbnail (surface, view);
+	cairo_surface_destroy (surface);
+
+	g_object_unref (job);
+	view->link_preview.job = NULL;
+}
+
+static void
+link_preview_render_finished_cb (EvJobRender *job,
+				 EvView      *view)
+{
+	GtkWidget       *popover = view->link_preview.popover;
+	cairo_surface_t *surface;
+	gint             device_scale = 1;
+
+	if (ev_job_is_failed (EV_JOB (job))) {
+		gtk_widget_destroy (popover);
+		view->link_preview.popover = NULL;
+		g_object_unref (job);
+		view->link_preview.job = NULL;
+
+		return;
+	}
+
 	if (ev_document_model_get_inverted_colors (view->model))
-		ev_document_misc_invert_surface (job->thumbnail_surface);
+		surface = ev_surface_cache_copy_surface (job->surface, TRUE);
+	else
+		surface = cairo_surface_reference (job->surface);
 
-	link_preview_show_thumbnail (job->thumbnail_surface, view);
+#ifdef HAVE_HIDPI_SUPPORT
+        device_scale = gtk_widget_get_scale_factor (GTK_WIDGET (view));
+        cairo_surface_set_device_scale (surface, device_scale, device_scale);
+#endif
+
+	/* Only the previewed area of the page was rendered */
+	link_preview_show_surface (surface, view);
+	cairo_surface_destroy (surface);
 
 	g_object_unref (job);
 	view->link_preview.job = NULL;
@@ -8472,6 +8561,25 @@ ev_view_class_init (EvViewClass *class)
 			 G_TYPE_NONE);
 	widget_class->activate_signal = signals[SIGNAL_ACTIVATE];
 
+	/**
+	 * EvView::page-rendered:
+	 * @view: the #EvView
+	 * @page: the page index
+	 *
+	 * Emitted when a rendered surface for @page is available, which
+	 * can then be retrieved with ev_view_get_page_surface().
+	 *
+	 * Since: 46.0
+	 */
+	signals[SIGNAL_PAGE_RENDERED] = g_signal_new ("page-rendered",
+			 G_TYPE_FROM_CLASS (object_class),
+			 G_SIGNAL_RUN_LAST,
+			 G_STRUCT_OFFSET (EvViewClass, page_rendered),
+			 NULL, NULL,
+			 g_cclosure_marshal_VOID__INT,
+			 G_TYPE_NONE, 1,
+			 G_TYPE_INT);
+
 	binding_set = gtk_binding_set_by_class (class);
 
 	add_move_binding_keypad (binding_set, GDK_KEY_Left,  0, GTK_MOVEMENT_VISUAL_POSITIONS, -1);
@@ -8691,6 +8799,14 @@ job_finished_cb (EvPixbufCache  *pixbuf_cache,
 	}
 }
 
+static void
+page_ready_cb (EvPixbufCache *pixbuf_cache,
+	       gint           page,
+	       EvView        *view)
+{
+	g_signal_emit (view, signals[SIGNAL_PAGE_RENDERED], 0, page);
+}
+
 static void
 ev_view_page_changed_cb (EvDocumentModel *model,
 			 gint             old_page,
@@ -8826,7 +8942,7 @@ setup_caches (EvView *view)
 	gboolean inverted_colors;
 
 	view->height_to_page_cache = ev_view_get_height_to_page_cache (view);
-	view->pixbuf_cache = ev_pixbuf_cache_new (GTK_WIDGET (view), view->model, view->pixbuf_cache_size);
+	view->pixbuf_cache = ev_pixbuf_cache_new (GTK_WIDGET (view), view->model);
 	view->page_cache = ev_page_cache_new (view->document);
 
 	ev_page_cache_set_flags (view->page_cache,
@@ -8838,7 +8954,10 @@ setup_caches (EvView *view)
 
 	inverted_colors = ev_document_model_get_inverted_colors (view->model);
 	ev_pixbuf_cache_set_inverted_colors (view->pixbuf_cache, inverted_colors);
+	ev_pixbuf_cache_set_compress_preloaded (view->pixbuf_cache,
+						view->compress_preloaded_pages);
 	g_signal_connect (view->pixbuf_cache, "job-finished", G_CALLBACK (job_finished_cb), view);
+	g_signal_connect (view->pixbuf_cache, "page-ready", G_CALLBACK (page_ready_cb), view);
 }
 
 static void
@@ -8855,6 +8974,8 @@ clear_caches (EvView *view)
  *
  * Sets the maximum size in bytes that will be used to cache
  * rendered pages. Use 0 to disable caching rendered pages.
+ * Rendered pages are shared by all the views in the process, so
+ * the limit applies to all of them.
  *
  * Note that this limit doesn't affect the current visible page range,
  * which will always be rendered. In order to limit the total memory used
@@ -8869,12 +8990,101 @@ ev_view_set_page_cache_size (EvView *view,
 		return;
 
 	view->pixbuf_cache_size = cache_size;
-	if (view->pixbuf_cache)
-		ev_pixbuf_cache_set_max_size (view->pixbuf_cache, cache_size);
+	ev_surface_cache_set_max_size (cache_size);
 
 	view_update_scale_limits (view);
 }
 
+/**
+ * ev_view_get_page_cache_usage:
+ * @view: #EvView instance
+ * @max_size: (out) (optional): return location for the current limit, or %NULL
+ *
+ * Gets the memory used to cache rendered pages, for diagnostics. The
+ * cache is shared by all the views. While the system is low on memory,
+ * the limit in @max_size is lower than the one set with
+ * ev_view_set_page_cache_size().
+ *
+ * Returns: the size in bytes of the cached rendered pages
+ *
+ * Since: 46.0
+ */
+gsize
+ev_view_get_page_cache_usage (EvView *view,
+			      gsize  *max_size)
+{
+	g_return_val_if_fail (EV_IS_VIEW (view), 0);
+
+	if (max_size)
+		*max_size = ev_surface_cache_get_max_size ();
+
+	return ev_surface_cache_get_size ();
+}
+
+/**
+ * ev_view_set_compress_preloaded_pages:
+ * @view: #EvView instance
+ * @compress: whether to compress the preloaded pages
+ *
+ * Sets whether the rendered pages preloaded around the visible ones are
+ * kept compressed in memory. They are decompressed when they become
+ * visible. Text and scanned pages usually compress very well, so more
+ * of them can be preloaded within the size set with
+ * ev_view_set_page_cache_size().
+ *
+ * Since: 46.0
+ */
+void
+ev_view_set_compress_preloaded_pages (EvView  *view,
+				      gboolean compress)
+{
+	g_return_if_fail (EV_IS_VIEW (view));
+
+	compress = !!compress;
+	if (view->compress_preloaded_pages == compress)
+		return;
+
+	view->compress_preloaded_pages = compress;
+	if (view->pixbuf_cache) {
+		ev_pixbuf_cache_set_compress_preloaded (view->pixbuf_cache, compress);
+		view_update_range_and_current_page (view);
+	}
+}
+
+/**
+ * ev_view_get_page_surface:
+ * @view: #EvView instance
+ * @page: the page index
+ *
+ * Returns the surface currently cached by @view for @page, if any. The
+ * surface is rendered with the rotation of the view's #EvDocumentModel,
+ * and has the colors inverted when the model has inverted colors. Its
+ * size corresponds to the scale the page was last rendered at, which
+ * might not be the current one.
+ *
+ * Returns: (transfer full) (nullable): a #cairo_surface_t, or %NULL
+ *
+ * Since: 46.0
+ */
+cairo_surface_t *
+ev_view_get_page_surface (EvView *view,
+			  gint    page)
+{
+	cairo_surface_t *surface;
+
+	g_return_val_if_fail (EV_IS_VIEW (view), NULL);
+
+	if (!view->pixbuf_cache || !view->document)
+		return NULL;
+
+	if (page < 0 || page >= ev_document_get_n_pages (view->document))
+		return NULL;
+
+	surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
+
+	return surface ? cairo_surface_reference (surface) : NULL;
+}
+
 /**
  * ev_view_set_loading:
  * @view:
@@ -9258,6 +9468,7 @@ ev_view_reload_page (EvView         *view,
 void
 ev_view_reload (EvView *view)
 {
+	ev_surface_cache_remove_document (view->document);
 	ev_pixbuf_cache_clear (view->pixbuf_cache);
 	view_update_range_and_current_page (view);
 }
@@ -61,8 +61,17 @@ void            ev_view_reload              (EvView          *view);
 EV_PUBLIC
 void            ev_view_set_page_cache_size (EvView          *view,
 					     gsize            cache_size);
+EV_PUBLIC
+gsize           ev_view_get_page_cache_usage (EvView         *view,
+					      gsize          *max_size);
+EV_PUBLIC
+void            ev_view_set_compress_preloaded_pages (EvView *view,
+						      gboolean compress);
 
 EV_PUBLIC
+cairo_surface_t *ev_view_get_page_surface   (EvView          *view,
+					     gint             page);
+EV_PUBLIC
 void            ev_view_set_allow_links_change_zoom (EvView  *view,
                                                      gboolean allowed);
 EV_PUBLIC
@@ -0,0 +1,179 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "ev-jobs.h"
+#include "ev-job-scheduler.h"
+
+/* Longer than the time after which the scheduler runs a waiting job
+ * whatever its category is */
+#define AGING_WAIT 1200000 /* us */
+
+#define N_BACKGROUND_JOBS 100
+
+static GMutex    run_mutex;
+static GCond     run_cond;
+static gboolean  blocked;
+static GPtrArray *run_order;
+
+static void
+record_run (EvJob *job)
+{
+	g_mutex_lock (&run_mutex);
+	g_ptr_array_add (run_order, job);
+	g_mutex_unlock (&run_mutex);
+}
+
+/* A job of the background category, that keeps the worker thread busy
+ * while blocked is set when it's the first one */
+typedef struct {
+	EvJob parent;
+	gboolean blocker;
+} TestJob;
+
+typedef struct {
+	EvJobClass parent_class;
+} TestJobClass;
+
+GType test_job_get_type (void);
+G_DEFINE_TYPE (TestJob, test_job, EV_TYPE_JOB)
+
+static gboolean
+test_job_run (EvJob *job)
+{
+	if (((TestJob *)job)->blocker) {
+		g_mutex_lock (&run_mutex);
+		while (blocked)
+			g_cond_wait (&run_cond, &run_mutex);
+		g_mutex_unlock (&run_mutex);
+	}
+
+	record_run (job);
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+test_job_init (TestJob *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static void
+test_job_class_init (TestJobClass *klass)
+{
+	EV_JOB_CLASS (klass)->run = test_job_run;
+}
+
+/* A render of the view category that doesn't need a document */
+typedef struct {
+	EvJobRender parent;
+} TestRenderJob;
+
+typedef struct {
+	EvJobRenderClass parent_class;
+} TestRenderJobClass;
+
+GType test_render_job_get_type (void);
+G_DEFINE_TYPE (TestRenderJob, test_render_job, EV_TYPE_JOB_RENDER)
+
+static gboolean
+test_render_job_run (EvJob *job)
+{
+	record_run (job);
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+test_render_job_init (TestRenderJob *job)
+{
+}
+
+static void
+test_render_job_class_init (TestRenderJobClass *klass)
+{
+	EV_JOB_CLASS (klass)->run = test_render_job_run;
+}
+
+static void
+test_urgent_render_before_aged_jobs (void)
+{
+	EvJob *blocker;
+	EvJob *render;
+	EvJob *jobs[N_BACKGROUND_JOBS];
+	guint  i;
+
+	run_order = g_ptr_array_new ();
+	blocked = TRUE;
+
+	blocker = g_object_new (test_job_get_type (), NULL);
+	((TestJob *)blocker)->blocker = TRUE;
+	ev_job_scheduler_push_job (blocker, EV_JOB_PRIORITY_LOW);
+
+	for (i = 0; i < N_BACKGROUND_JOBS; i++) {
+		jobs[i] = g_object_new (test_job_get_type (), NULL);
+		g_assert_cmpint (ev_job_scheduler_get_job_category (jobs[i]), ==,
+				 EV_JOB_CATEGORY_BACKGROUND);
+		ev_job_scheduler_push_job (jobs[i], EV_JOB_PRIORITY_LOW);
+	}
+
+	/* All the background jobs are starving by now */
+	g_usleep (AGING_WAIT);
+
+	render = g_object_new (test_render_job_get_type (), NULL);
+	g_assert_cmpint (ev_job_scheduler_get_job_category (render), ==,
+			 EV_JOB_CATEGORY_VIEW);
+	ev_job_scheduler_push_job (render, EV_JOB_PRIORITY_URGENT);
+
+	g_mutex_lock (&run_mutex);
+	blocked = FALSE;
+	g_cond_broadcast (&run_cond);
+	g_mutex_unlock (&run_mutex);
+
+	ev_job_scheduler_wait ();
+
+	g_assert_cmpuint (run_order->len, ==, N_BACKGROUND_JOBS + 2);
+	g_assert_true (g_ptr_array_index (run_order, 0) == blocker);
+	g_assert_true (g_ptr_array_index (run_order, 1) == render);
+
+	/* The aged jobs still run in the order they were queued */
+	for (i = 0; i < N_BACKGROUND_JOBS; i++)
+		g_assert_true (g_ptr_array_index (run_order, i + 2) == jobs[i]);
+
+	for (i = 0; i < N_BACKGROUND_JOBS; i++)
+		g_object_unref (jobs[i]);
+	g_object_unref (render);
+	g_object_unref (blocker);
+	g_clear_pointer (&run_order, g_ptr_array_unref);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/job-scheduler/urgent-render-before-aged-jobs",
+			 test_urgent_render_before_aged_jobs);
+
+	return g_test_run ();
+}
@@ -0,0 +1,362 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+
+#include "ev-document-model.h"
+#include "ev-document-text.h"
+#include "ev-page-cache.h"
+#include "ev-pixbuf-cache.h"
+#include "ev-surface-cache.h"
+
+#define N_PAGES     10
+#define PAGE_WIDTH  100
+#define PAGE_HEIGHT 100
+#define PAGE_SIZE   (PAGE_WIDTH * PAGE_HEIGHT * 4)
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+
+static const GMemoryMonitorWarningLevel levels[] = {
+	G_MEMORY_MONITOR_WARNING_LEVEL_LOW,
+	G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM,
+	G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL
+};
+
+static gboolean has_display;
+
+/* A document of blank pages, with some text on each of them */
+typedef struct {
+	EvDocument parent;
+} TestDocument;
+
+typedef struct {
+	EvDocumentClass parent_class;
+} TestDocumentClass;
+
+static void test_document_text_iface_init (EvDocumentTextInterface *iface);
+
+GType test_document_get_type (void);
+G_DEFINE_TYPE_WITH_CODE (TestDocument, test_document, EV_TYPE_DOCUMENT,
+			 G_IMPLEMENT_INTERFACE (EV_TYPE_DOCUMENT_TEXT,
+						test_document_text_iface_init))
+
+static gboolean
+test_document_load (EvDocument  *document,
+		    const char  *uri,
+		    GError     **error)
+{
+	return TRUE;
+}
+
+static gint
+test_document_get_n_pages (EvDocument *document)
+{
+	return N_PAGES;
+}
+
+static void
+test_document_get_page_size (EvDocument *document,
+			     EvPage     *page,
+			     double     *width,
+			     double     *height)
+{
+	*width = PAGE_WIDTH;
+	*height = PAGE_HEIGHT;
+}
+
+static cairo_surface_t *
+test_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+	gint             width, height;
+
+	ev_render_context_compute_transformed_size (rc, PAGE_WIDTH, PAGE_HEIGHT,
+						    &width, &height);
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	cr = cairo_create (surface);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return surface;
+}
+
+static gchar *
+test_document_get_text (EvDocumentText *document_text,
+			EvPage         *page)
+{
+	return g_strdup_printf ("Page %d", page->index + 1);
+}
+
+static cairo_region_t *
+test_document_get_text_mapping (EvDocumentText *document_text,
+				EvPage         *page)
+{
+	cairo_rectangle_int_t area = { 10, 10, 80, 10 };
+
+	return cairo_region_create_rectangle (&area);
+}
+
+static void
+test_document_text_iface_init (EvDocumentTextInterface *iface)
+{
+	iface->get_text = test_document_get_text;
+	iface->get_text_mapping = test_document_get_text_mapping;
+}
+
+static void
+test_document_init (TestDocument *document)
+{
+}
+
+static void
+test_document_class_init (TestDocumentClass *klass)
+{
+	EvDocumentClass *document_class = EV_DOCUMENT_CLASS (klass);
+
+	document_class->load = test_document_load;
+	document_class->get_n_pages = test_document_get_n_pages;
+	document_class->get_page_size = test_document_get_page_size;
+	document_class->render = test_document_render;
+}
+
+static EvDocument *
+test_document_new (void)
+{
+	EvDocument *document;
+	GError     *error = NULL;
+
+	document = g_object_new (test_document_get_type (), NULL);
+	ev_document_load (document, "file:///nonexistent/test-document", &error);
+	g_assert_no_error (error);
+
+	return document;
+}
+
+static cairo_surface_t *
+create_page_surface (void)
+{
+	return cairo_image_surface_create (CAIRO_FORMAT_ARGB32, PAGE_WIDTH, PAGE_HEIGHT);
+}
+
+static gboolean
+surface_cache_contains (EvDocument *document,
+			gint        page)
+{
+	return ev_surface_cache_contains (document, page, 0,
+					  PAGE_WIDTH, PAGE_HEIGHT,
+					  1, FALSE);
+}
+
+/* Caches pages 0 and 1, which nobody else uses, and page 2, whose
+ * surface is kept by the caller like a view showing it does */
+static cairo_surface_t *
+fill_surface_cache (EvDocument *document)
+{
+	cairo_surface_t *used;
+	gint             i;
+
+	for (i = 0; i < 2; i++) {
+		cairo_surface_t *surface = create_page_surface ();
+
+		ev_surface_cache_add (document, i, 0, 1, FALSE, surface);
+		cairo_surface_destroy (surface);
+	}
+
+	used = create_page_surface ();
+	ev_surface_cache_add (document, 2, 0, 1, FALSE, used);
+
+	return used;
+}
+
+static void
+test_surface_cache (void)
+{
+	EvDocument      *document;
+	cairo_surface_t *used;
+	gsize            max_size = 100 * PAGE_SIZE;
+	guint            i;
+
+	document = test_document_new ();
+	ev_surface_cache_set_max_size (max_size);
+
+	/* Low warnings only halve the limit, which is enough for all */
+	used = fill_surface_cache (document);
+	ev_surface_cache_handle_low_memory (G_MEMORY_MONITOR_WARNING_LEVEL_LOW);
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size / 2);
+	for (i = 0; i < 3; i++)
+		g_assert_true (surface_cache_contains (document, i));
+
+	/* Medium warnings drop the surfaces nobody uses */
+	ev_surface_cache_handle_low_memory (G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM);
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size / 4);
+	g_assert_false (surface_cache_contains (document, 0));
+	g_assert_false (surface_cache_contains (document, 1));
+	g_assert_true (surface_cache_contains (document, 2));
+	cairo_surface_destroy (used);
+
+	/* Critical warnings go down to the minimum limit at once */
+	used = fill_surface_cache (document);
+	ev_surface_cache_handle_low_memory (G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL);
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size / 8);
+	g_assert_false (surface_cache_contains (document, 0));
+	g_assert_false (surface_cache_contains (document, 1));
+	g_assert_true (surface_cache_contains (document, 2));
+	g_assert_cmpuint (ev_surface_cache_get_size (), ==, PAGE_SIZE);
+	cairo_surface_destroy (used);
+
+	/* And the limit doubles back to the configured one */
+	g_assert_true (ev_surface_cache_recover_budget ());
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size / 4);
+	g_assert_true (ev_surface_cache_recover_budget ());
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size / 2);
+	g_assert_false (ev_surface_cache_recover_budget ());
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size);
+	g_assert_false (ev_surface_cache_recover_budget ());
+	g_assert_cmpuint (ev_surface_cache_get_max_size (), ==, max_size);
+
+	ev_surface_cache_remove_document (document);
+	g_assert_cmpuint (ev_surface_cache_get_size (), ==, 0);
+	g_object_unref (document);
+}
+
+static void
+cache_all_pages (EvPageCache *cache)
+{
+	gint i;
+
+	for (i = 0; i < N_PAGES; i++)
+		ev_page_cache_ensure_page (cache, i);
+
+	for (i = 0; i < N_PAGES; i++) {
+		while (!ev_page_cache_is_page_cached (cache, i))
+			g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+test_page_cache (void)
+{
+	EvDocument  *document;
+	EvPageCache *cache;
+	guint        i;
+	gint         page;
+
+	document = test_document_new ();
+	cache = ev_page_cache_new (document);
+	ev_page_cache_set_flags (cache,
+				 EV_PAGE_DATA_INCLUDE_TEXT |
+				 EV_PAGE_DATA_INCLUDE_TEXT_MAPPING);
+
+	/* Pages 3 to 5 are in the range, page 8 is held */
+	ev_page_cache_set_page_range (cache, 4, 4);
+	ev_page_cache_hold_page (cache, 8);
+
+	for (i = 0; i < G_N_ELEMENTS (levels); i++) {
+		cache_all_pages (cache);
+
+		ev_page_cache_handle_low_memory (cache, levels[i]);
+
+		for (page = 0; page < N_PAGES; page++) {
+			gboolean kept;
+
+			/* Low warnings keep everything */
+			kept = levels[i] < G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM ||
+				(page >= 3 && page <= 5) || page == 8;
+
+			g_assert_cmpint (ev_page_cache_is_page_cached (cache, page), ==, kept);
+			g_assert_cmpint (ev_page_cache_get_text (cache, page) != NULL, ==, kept);
+			g_assert_cmpint (ev_page_cache_get_text_mapping (cache, page) != NULL, ==, kept);
+		}
+	}
+
+	ev_page_cache_release_page (cache, 8);
+	g_object_unref (cache);
+	g_object_unref (document);
+}
+
+static void
+wait_for_pages (EvPixbufCache *pixbuf_cache,
+		gint           start_page,
+		gint           end_page)
+{
+	gint page;
+
+	for (page = start_page; page <= end_page; page++) {
+		while (!ev_pixbuf_cache_get_surface (pixbuf_cache, page))
+			g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+test_pixbuf_cache (void)
+{
+	EvDocument      *document;
+	EvDocumentModel *model;
+	EvPixbufCache   *pixbuf_cache;
+	GtkWidget       *view;
+	guint            i;
+
+	if (!has_display) {
+		g_test_skip ("The pixbuf cache needs a display");
+		return;
+	}
+
+	document = test_document_new ();
+	model = ev_document_model_new_with_document (document);
+	view = g_object_ref_sink (gtk_drawing_area_new ());
+	pixbuf_cache = ev_pixbuf_cache_new (view, model);
+
+	for (i = 0; i < G_N_ELEMENTS (levels); i++) {
+		/* Page 4 is visible, pages 3 and 5 are preloaded */
+		ev_pixbuf_cache_set_page_range (pixbuf_cache, 4, 4, NULL);
+		wait_for_pages (pixbuf_cache, 3, 5);
+
+		/* Preloaded pages go at any level */
+		ev_pixbuf_cache_handle_low_memory (pixbuf_cache, levels[i]);
+		g_assert_null (ev_pixbuf_cache_get_surface (pixbuf_cache, 3));
+		g_assert_nonnull (ev_pixbuf_cache_get_surface (pixbuf_cache, 4));
+		g_assert_null (ev_pixbuf_cache_get_surface (pixbuf_cache, 5));
+	}
+
+	g_object_unref (pixbuf_cache);
+	g_object_unref (view);
+	g_object_unref (model);
+	ev_surface_cache_remove_document (document);
+	g_object_unref (document);
+}
+#endif
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	has_display = gtk_init_check (&argc, &argv);
+
+	g_test_add_func ("/low-memory/surface-cache", test_surface_cache);
+	g_test_add_func ("/low-memory/page-cache", test_page_cache);
+	g_test_add_func ("/low-memory/pixbuf-cache", test_pixbuf_cache);
+#endif
+
+	return g_test_run ();
+}
@@ -29,6 +29,10 @@ struct _EvMetadata {
 
 	GFile      *file;
 	GHashTable *items;
+
+	/* Changes not written to the file yet */
+	GFileInfo  *pending;
+	guint       flush_id;
 };
 
 struct _EvMetadataClass {
@@ -39,11 +43,17 @@ G_DEFINE_TYPE (EvMetadata, ev_metadata, G_TYPE_OBJECT)
 
 #define EV_METADATA_NAMESPACE "metadata::evince"
 
+/* Delay before writing the changed keys, so that keys changed in a row,
+ * like the page while scrolling, are written once */
+#define EV_METADATA_FLUSH_DELAY 2000 /* ms */
+
 static void
 ev_metadata_finalize (GObject *object)
 {
 	EvMetadata *metadata = EV_METADATA (object);
 
+	ev_metadata_flush (metadata);
+
 	g_clear_pointer (&metadata->items, g_hash_table_destroy);
 	g_clear_object (&metadata->file);
 
@@ -68,26 +78,14 @@ ev_metadata_class_init (EvMetadataClass *klass)
 }
 
 static void
-ev_metadata_load (EvMetadata *metadata)
+ev_metadata_load_info (EvMetadata *metadata,
+		       GFileInfo  *info)
 {
-	GFileInfo *info;
-	gchar    **attrs;
-	gint       i;
-	GError    *error = NULL;
-
-	info = g_file_query_info (metadata->file, "metadata::*", 0, NULL, &error);
-	if (!info) {
-		g_warning ("%s", error->message);
-		g_error_free (error);
+	gchar **attrs;
+	gint    i;
 
+	if (!g_file_info_has_namespace (info, "metadata"))
 		return;
-	}
-
-	if (!g_file_info_has_namespace (info, "metadata")) {
-		g_object_unref (info);
-
-		return;
-	}
 
 	attrs = g_file_info_list_attributes (info, "metadata");
 	for (i = 0; attrs[i]; i++) {
@@ -112,23 +110,92 @@ ev_metadata_load (EvMetadata *metadata)
 		}
 	}
 	g_strfreev (attrs);
+}
+
+static void
+ev_metadata_load (EvMetadata   *metadata,
+		  GCancellable *cancellable)
+{
+	GFileInfo *info;
+	GError    *error = NULL;
+
+	info = g_file_query_info (metadata->file, "metadata::*", 0, cancellable, &error);
+	if (!info) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s", error->message);
+		g_error_free (error);
+
+		return;
+	}
+
+	ev_metadata_load_info (metadata, info);
 	g_object_unref (info);
 }
 
-EvMetadata *
-ev_metadata_new (GFile *file)
+static void
+ev_metadata_new_thread (GTask        *task,
+			GFile        *file,
+			gpointer      task_data,
+			GCancellable *cancellable)
 {
 	EvMetadata *metadata;
 
-	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	if (!ev_is_metadata_supported_for_file (file)) {
+		g_task_return_pointer (task, NULL, NULL);
+		return;
+	}
 
 	metadata = EV_METADATA (g_object_new (EV_TYPE_METADATA, NULL));
-        if (!ev_file_is_temp (file)) {
-                metadata->file = g_object_ref (file);
-                ev_metadata_load (metadata);
-        }
+	if (!ev_file_is_temp (file)) {
+		metadata->file = g_object_ref (file);
+		ev_metadata_load (metadata, cancellable);
+	}
+
+	g_task_return_pointer (task, metadata, g_object_unref);
+}
+
+/**
+ * ev_metadata_new_async:
+ * @file: a #GFile
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: the callback to call when the metadata has been loaded
+ * @user_data: the data to pass to @callback
+ *
+ * Checks whether metadata is supported for @file, and loads it, in a
+ * thread, so that the main loop isn't blocked while querying the file.
+ * @file is the source object passed to @callback.
+ */
+void
+ev_metadata_new_async (GFile              *file,
+		       GCancellable       *cancellable,
+		       GAsyncReadyCallback callback,
+		       gpointer            user_data)
+{
+	GTask *task;
 
-	return metadata;
+	g_return_if_fail (G_IS_FILE (file));
+
+	task = g_task_new (file, cancellable, callback, user_data);
+	g_task_set_source_tag (task, ev_metadata_new_async);
+	g_task_run_in_thread (task, (GTaskThreadFunc)ev_metadata_new_thread);
+	g_object_unref (task);
+}
+
+/**
+ * ev_metadata_new_finish:
+ * @result: the #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full) (nullable): the #EvMetadata, or %NULL if
+ *   metadata is not supported for the file or the operation was cancelled
+ */
+EvMetadata *
+ev_metadata_new_finish (GAsyncResult *result,
+			GError      **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 gboolean
@@ -165,38 +232,99 @@ metadata_set_callback (GObject      *file,
 	}
 }
 
+static void
+ev_metadata_write_pending (EvMetadata *metadata,
+			   gboolean    async)
+{
+	GFileInfo *info;
+	GError    *error = NULL;
+
+	info = g_steal_pointer (&metadata->pending);
+	if (!info)
+		return;
+
+	if (async) {
+		g_file_set_attributes_async (metadata->file,
+					     info,
+					     0,
+					     G_PRIORITY_DEFAULT,
+					     NULL,
+					     (GAsyncReadyCallback)metadata_set_callback,
+					     metadata);
+	} else if (!g_file_set_attributes_from_info (metadata->file, info, 0, NULL, &error)) {
+		g_warning ("%s", error->message);
+		g_error_free (error);
+	}
+
+	g_object_unref (info);
+}
+
+static gboolean
+ev_metadata_flush_timeout_cb (EvMetadata *metadata)
+{
+	metadata->flush_id = 0;
+	ev_metadata_write_pending (metadata, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * ev_metadata_flush:
+ * @metadata: an #EvMetadata
+ *
+ * Writes the keys changed since the last write. Changes are usually
+ * written in the background after a short delay; this writes them
+ * synchronously, and it's meant to be used when the document is closed.
+ */
+void
+ev_metadata_flush (EvMetadata *metadata)
+{
+	g_return_if_fail (EV_IS_METADATA (metadata));
+
+	if (metadata->flush_id > 0) {
+		g_source_remove (metadata->flush_id);
+		metadata->flush_id = 0;
+	}
+
+	ev_metadata_write_pending (metadata, FALSE);
+}
+
 gboolean
 ev_metadata_set_string (EvMetadata  *metadata,
 			const gchar *key,
 			const gchar *value)
 {
-	GFileInfo *info;
-	gchar     *gio_key;
+	gchar *gio_key;
+
+	if (g_strcmp0 (g_hash_table_lookup (metadata->items, key), value) == 0)
+		return TRUE;
 
         g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
         if (!metadata->file)
                 return TRUE;
 
-	info = g_file_info_new ();
+	/* Keys changed before the pending ones are written are merged, so
+	 * that only the last value is written */
+	if (!metadata->pending)
+		metadata->pending = g_file_info_new ();
 
 	gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
 	if (value) {
-		g_file_info_set_attribute_string (info, gio_key, value);
+		g_file_info_set_attribute_string (metadata->pending, gio_key, value);
 	} else {
-		g_file_info_set_attribute (info, gio_key,
+		g_file_info_set_attribute (metadata->pending, gio_key,
 					   G_FILE_ATTRIBUTE_TYPE_INVALID,
 					   NULL);
 	}
 	g_free (gio_key);
 
-	g_file_set_attributes_async (metadata->file,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     (GAsyncReadyCallback)metadata_set_callback,
-				     metadata);
-	g_object_unref (info);
+	if (metadata->flush_id == 0) {
+		metadata->flush_id = g_timeout_add_full (G_PRIORITY_LOW,
+							 EV_METADATA_FLUSH_DELAY,
+							 (GSourceFunc)ev_metadata_flush_timeout_cb,
+							 metadata,
+							 NULL);
+	}
 
 	return TRUE;
 }
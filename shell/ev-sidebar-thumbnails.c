@@ -39,11 +39,17 @@
 #include "ev-sidebar.h"
 #include "ev-sidebar-page.h"
 #include "ev-sidebar-thumbnails.h"
+#include "ev-thumbnails-model.h"
 #include "ev-utils.h"
+#include "ev-view.h"
 #include "ev-window.h"
 
 #define THUMBNAIL_WIDTH 100
 
+/* GtkIconView lays out every item, so documents with more pages than
+ * this are shown in a list, which only measures the visible rows */
+#define MAX_ICON_VIEW_PAGE_COUNT 1500
+
 typedef struct _EvThumbsSize
 {
 	gint width;
@@ -60,11 +66,13 @@ typedef struct _EvThumbsSizeCache {
 struct _EvSidebarThumbnailsPrivate {
 	GtkWidget *swindow;
 	GtkWidget *icon_view;
+	GtkWidget *tree_view;
 	GtkAdjustment *vadjustment;
-	GtkListStore *list_store;
+	EvThumbnailsModel *store;
 	GHashTable *loading_icons;
 	EvDocument *document;
 	EvDocumentModel *model;
+	EvView *view;
 	EvThumbsSizeCache *size_cache;
         gint width;
 
@@ -76,14 +84,17 @@ struct _EvSidebarThumbnailsPrivate {
 					 * for dual mode with !odd_left preference. Issue #30 */
 	/* Visible pages */
 	gint start_page, end_page;
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	GMemoryMonitor *memory_monitor;
+#endif
 };
 
 enum {
-	COLUMN_PAGE_STRING,
-	COLUMN_SURFACE,
-	COLUMN_THUMBNAIL_SET,
-	COLUMN_JOB,
-	NUM_COLUMNS
+	COLUMN_PAGE_STRING = EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING,
+	COLUMN_SURFACE = EV_THUMBNAILS_MODEL_COLUMN_SURFACE,
+	COLUMN_THUMBNAIL_SET = EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET,
+	COLUMN_JOB = EV_THUMBNAILS_MODEL_COLUMN_JOB
 };
 
 enum {
@@ -216,6 +227,58 @@ ev_thumbnails_size_cache_get (EvDocument *document)
 	return cache;
 }
 
+static GtkWidget *
+ev_sidebar_thumbnails_get_main_widget (EvSidebarThumbnails *sidebar)
+{
+	return sidebar->priv->icon_view ? sidebar->priv->icon_view : sidebar->priv->tree_view;
+}
+
+static gboolean
+ev_sidebar_thumbnails_get_visible_range (EvSidebarThumbnails *sidebar,
+					 GtkTreePath        **start,
+					 GtkTreePath        **end)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar->priv;
+
+	if (priv->icon_view)
+		return gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), start, end);
+	if (priv->tree_view)
+		return gtk_tree_view_get_visible_range (GTK_TREE_VIEW (priv->tree_view), start, end);
+
+	return FALSE;
+}
+
+static GtkTreePath *
+ev_sidebar_thumbnails_get_selected_path (EvSidebarThumbnails *sidebar)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar->priv;
+	GtkTreePath *path = NULL;
+
+	if (priv->icon_view) {
+		GList *selection;
+
+		selection = gtk_icon_view_get_selected_items (GTK_ICON_VIEW (priv->icon_view));
+		if (!selection)
+			return NULL;
+
+		path = (GtkTreePath *)selection->data;
+
+		/* We don't handle or expect multiple selection. */
+		g_assert (selection->next == NULL);
+		g_list_free (selection);
+	} else if (priv->tree_view) {
+		GtkTreeSelection *selection;
+		GtkTreeModel     *tree_model;
+		GtkTreeIter       iter;
+
+		selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
+		if (gtk_tree_selection_get_selected (selection, &tree_model, &iter))
+			path = gtk_tree_model_get_path (tree_model, &iter);
+	}
+
+	return path;
+}
+
 static gboolean
 ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
                                                 guint                page)
@@ -223,19 +286,12 @@ ev_sidebar_thumbnails_page_is_in_visible_range (EvSidebarThumbnails *sidebar,
         GtkTreePath *path;
         GtkTreePath *start, *end;
         gboolean     retval;
-        GList *selection;
 
-        selection = gtk_icon_view_get_selected_items (GTK_ICON_VIEW (sidebar->priv->icon_view));
-        if (!selection)
+        path = ev_sidebar_thumbnails_get_selected_path (sidebar);
+        if (!path)
                 return FALSE;
 
-        path = (GtkTreePath *)selection->data;
-
-        /* We don't handle or expect multiple selection. */
-        g_assert (selection->next == NULL);
-        g_list_free (selection);
-
-        if (!gtk_icon_view_get_visible_range (GTK_ICON_VIEW (sidebar->priv->icon_view), &start, &end)) {
+        if (!ev_sidebar_thumbnails_get_visible_range (sidebar, &start, &end)) {
                 gtk_tree_path_free (path);
                 return FALSE;
         }
@@ -256,9 +312,23 @@ ev_sidebar_thumbnails_dispose (GObject *object)
 	g_clear_pointer (&sidebar_thumbnails->priv->loading_icons,
 			 g_hash_table_destroy);
 
-	if (sidebar_thumbnails->priv->list_store) {
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	if (sidebar_thumbnails->priv->memory_monitor) {
+		g_signal_handlers_disconnect_by_data (sidebar_thumbnails->priv->memory_monitor,
+						      sidebar_thumbnails);
+		g_clear_object (&sidebar_thumbnails->priv->memory_monitor);
+	}
+#endif
+
+	if (sidebar_thumbnails->priv->view) {
+		g_object_remove_weak_pointer (G_OBJECT (sidebar_thumbnails->priv->view),
+					      (gpointer)&sidebar_thumbnails->priv->view);
+		sidebar_thumbnails->priv->view = NULL;
+	}
+
+	if (sidebar_thumbnails->priv->store) {
 		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-		g_clear_object (&sidebar_thumbnails->priv->list_store);
+		g_clear_object (&sidebar_thumbnails->priv->store);
 	}
 
 	G_OBJECT_CLASS (ev_sidebar_thumbnails_parent_class)->dispose (object);
@@ -274,7 +344,7 @@ ev_sidebar_thumbnails_get_property (GObject    *object,
 
 	switch (prop_id) {
 	case PROP_WIDGET:
-		g_value_set_object (value, sidebar->priv->icon_view);
+		g_value_set_object (value, ev_sidebar_thumbnails_get_main_widget (sidebar));
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -419,13 +489,13 @@ cancel_running_jobs (EvSidebarThumbnails *sidebar_thumbnails,
 	g_assert (start_page <= end_page);
 
 	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
+	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), &iter, path);
 	     result && start_page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), start_page ++) {
+	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->store), &iter), start_page ++) {
 		EvJobThumbnail *job;
 		gboolean thumbnail_set;
 
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store),
+		gtk_tree_model_get (GTK_TREE_MODEL (priv->store),
 				    &iter,
 				    COLUMN_JOB, &job,
 				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
@@ -442,10 +512,7 @@ cancel_running_jobs (EvSidebarThumbnails *sidebar_thumbnails,
 			g_object_unref (job);
 		}
 
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_JOB, NULL,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
+		ev_thumbnails_model_set_job (priv->store, &iter, NULL);
 	}
 	gtk_tree_path_free (path);
 }
@@ -476,6 +543,73 @@ get_size_for_page (EvSidebarThumbnails *sidebar_thumbnails,
         }
 }
 
+static void
+ev_sidebar_thumbnails_set_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+				     GtkTreeIter         *iter,
+				     cairo_surface_t     *thumbnail,
+				     gboolean             invert)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GtkWidget                  *widget = GTK_WIDGET (sidebar_thumbnails);
+	cairo_surface_t            *surface;
+#ifdef HAVE_HIDPI_SUPPORT
+	gint                        device_scale;
+
+	device_scale = gtk_widget_get_scale_factor (widget);
+	cairo_surface_set_device_scale (thumbnail, device_scale, device_scale);
+#endif
+
+	surface = ev_document_misc_render_thumbnail_surface_with_frame (widget,
+									thumbnail,
+									-1, -1);
+	if (invert)
+		ev_document_misc_invert_surface (surface);
+	ev_thumbnails_model_set_thumbnail (priv->store, iter, surface);
+	cairo_surface_destroy (surface);
+}
+
+/* Builds the thumbnail for @page out of the surface already rendered by
+ * the main view, if there's one large enough, so that we don't need to
+ * ask the backend to render the same page again. Surfaces owned by the
+ * view already have the colors inverted when needed. */
+static gboolean
+ev_sidebar_thumbnails_set_thumbnail_from_view (EvSidebarThumbnails *sidebar_thumbnails,
+					       GtkTreeIter         *iter,
+					       gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	cairo_surface_t *source;
+	cairo_surface_t *thumbnail;
+	gint             source_width, source_height;
+	gint             width, height;
+
+	if (!priv->view)
+		return FALSE;
+
+	source = ev_view_get_page_surface (priv->view, page);
+	if (!source)
+		return FALSE;
+
+	get_size_for_page (sidebar_thumbnails, page, &width, &height);
+	source_width = cairo_image_surface_get_width (source);
+	source_height = cairo_image_surface_get_height (source);
+
+	/* Never upscale, and discard surfaces rendered with another rotation */
+	if (source_width < width || source_height < height ||
+	    ABS ((gdouble)source_width / source_height - (gdouble)width / height) > 0.05) {
+		cairo_surface_destroy (source);
+		return FALSE;
+	}
+
+	thumbnail = ev_document_misc_surface_downsample (source, width, height);
+	cairo_surface_destroy (source);
+
+	ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, iter, thumbnail, FALSE);
+	cairo_surface_destroy (thumbnail);
+
+	return TRUE;
+}
+
 static void
 add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 start_page,
@@ -493,19 +627,23 @@ add_range (EvSidebarThumbnails *sidebar_thumbnails,
 		page--;
 
 	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
+	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), &iter, path);
 	     result && page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page ++) {
+	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->store), &iter), page ++) {
 		EvJob *job;
 		gboolean thumbnail_set;
 
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
+		gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
 				    COLUMN_JOB, &job,
 				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
 				    -1);
 
 		if (job == NULL && !thumbnail_set) {
 			gint thumbnail_width, thumbnail_height;
+
+			if (ev_sidebar_thumbnails_set_thumbnail_from_view (sidebar_thumbnails, &iter, page))
+				continue;
+
 			get_size_for_page (sidebar_thumbnails, page, &thumbnail_width, &thumbnail_height);
 
 			job = ev_job_thumbnail_new_with_target_size (priv->document,
@@ -519,9 +657,7 @@ add_range (EvSidebarThumbnails *sidebar_thumbnails,
 			g_signal_connect (job, "finished",
 					  G_CALLBACK (thumbnail_job_completed_callback),
 					  sidebar_thumbnails);
-			gtk_list_store_set (priv->list_store, &iter,
-					    COLUMN_JOB, job,
-					    -1);
+			ev_thumbnails_model_set_job (priv->store, &iter, job);
 			ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
 
 			/* The queue and the list own a ref to the job now */
@@ -566,6 +702,13 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 
 	add_range (sidebar_thumbnails, start_page, end_page);
 
+	/* Keep the thumbnails of a range of the same size on each side, and
+	 * release the rest, so that memory doesn't grow with the number of
+	 * pages scrolled through */
+	ev_thumbnails_model_prune (priv->store,
+				   start_page - n_pages_in_visible_range,
+				   end_page + n_pages_in_visible_range);
+
 	priv->start_page = start_page;
 	priv->end_page = end_page;
 }
@@ -574,6 +717,7 @@ static void
 adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GtkWidget *widget;
 	GtkTreePath *path = NULL;
 	GtkTreePath *path2 = NULL;
 	gdouble page_size;
@@ -587,14 +731,11 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	if (page_size == 0)
 		return;
 
-	if (priv->icon_view) {
-		if (! gtk_widget_get_realized (priv->icon_view))
-			return;
-		if (! gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), &path, &path2))
-			return;
-	} else {
+	widget = ev_sidebar_thumbnails_get_main_widget (sidebar_thumbnails);
+	if (! widget || ! gtk_widget_get_realized (widget))
+		return;
+	if (! ev_sidebar_thumbnails_get_visible_range (sidebar_thumbnails, &path, &path2))
 		return;
-	}
 
 	if (path && path2) {
 		update_visible_range (sidebar_thumbnails,
@@ -606,44 +747,46 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	gtk_tree_path_free (path2);
 }
 
+static cairo_surface_t *
+ev_sidebar_thumbnails_get_loading_icon_for_page (EvThumbnailsModel   *store,
+						 gint                 page,
+						 EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	gint width, height;
+
+	if (!priv->size_cache || !priv->loading_icons)
+		return NULL;
+
+	ev_thumbnails_size_cache_get_size (priv->size_cache, page,
+					   priv->rotation,
+					   &width, &height);
+
+	return ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails, width, height);
+}
+
 static void
 ev_sidebar_thumbnails_fill_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter iter;
-	int i;
-	gint prev_width = -1;
-	gint prev_height = -1;
-
-	for (i = 0; i < sidebar_thumbnails->priv->n_pages; i++) {
-		gchar     *page_label;
-		gchar     *page_string;
-		cairo_surface_t *loading_icon = NULL;
-		gint       width, height;
-
-		page_label = ev_document_get_page_label (priv->document, i);
-		page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
-		ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, i,
-						  sidebar_thumbnails->priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
 
-		prev_width = width;
-		prev_height = height;
-
-		gtk_list_store_append (priv->list_store, &iter);
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_PAGE_STRING, page_string,
-				    COLUMN_SURFACE, loading_icon,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
-		g_free (page_label);
-		g_free (page_string);
-	}
+	/* Rows are virtual, only the loaded thumbnails are stored. Detach
+	 * the model while the number of rows changes, so that the view
+	 * builds its items at once when it's attached again, instead of
+	 * handling a row-inserted signal per page */
+	if (priv->icon_view)
+		gtk_icon_view_set_model (GTK_ICON_VIEW (priv->icon_view), NULL);
+	if (priv->tree_view)
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), NULL);
+
+	ev_thumbnails_model_set_document (priv->store, priv->document);
+
+	if (priv->icon_view)
+		gtk_icon_view_set_model (GTK_ICON_VIEW (priv->icon_view),
+					 GTK_TREE_MODEL (priv->store));
+	if (priv->tree_view)
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+					 GTK_TREE_MODEL (priv->store));
 }
 
 static void
@@ -682,6 +825,63 @@ ev_sidebar_icon_selection_changed (GtkIconView         *icon_view,
 	ev_document_model_set_page (priv->model, page);
 }
 
+static void
+ev_sidebar_tree_selection_changed (GtkTreeSelection    *selection,
+				   EvSidebarThumbnails *ev_sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = ev_sidebar_thumbnails->priv;
+	GtkTreeIter iter;
+	int page;
+
+	if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
+		return;
+
+	/* There's no blank row in the list */
+	page = ev_thumbnails_model_get_page (priv->store, &iter);
+
+	ev_document_model_set_page (priv->model, page);
+}
+
+static void
+ev_sidebar_init_tree_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv;
+	GtkTreeViewColumn *column;
+	GtkTreeSelection *selection;
+	GtkCellRenderer *renderer;
+
+	priv = ev_sidebar_thumbnails->priv;
+
+	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->store));
+	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (priv->tree_view), FALSE);
+
+	/* Fixed sizing, so that the rows can have a fixed height */
+	column = gtk_tree_view_column_new ();
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_expand (column, TRUE);
+
+	renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
+				 "xpad", 2,
+				 "ypad", 2,
+				 NULL);
+	gtk_tree_view_column_pack_start (column, renderer, FALSE);
+	gtk_tree_view_column_set_attributes (column, renderer,
+					     "surface", COLUMN_SURFACE, NULL);
+
+	renderer = gtk_cell_renderer_text_new ();
+	gtk_tree_view_column_pack_start (column, renderer, TRUE);
+	gtk_tree_view_column_set_attributes (column, renderer,
+					     "markup", COLUMN_PAGE_STRING, NULL);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (priv->tree_view), column);
+
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
+	g_signal_connect (selection, "changed",
+			  G_CALLBACK (ev_sidebar_tree_selection_changed), ev_sidebar_thumbnails);
+
+	gtk_container_add (GTK_CONTAINER (priv->swindow), priv->tree_view);
+	gtk_widget_show (priv->tree_view);
+}
+
 static void
 ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
@@ -690,7 +890,7 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv;
 
-	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
+	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->store));
 
         renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
                                  "xalign", 0.5,
@@ -754,6 +954,22 @@ ev_sidebar_thumbnails_row_changed (GtkTreeModel *model,
 	g_signal_stop_emission (model, signal_id, 0);
 }
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+static void
+low_memory_warning_cb (GMemoryMonitor            *monitor,
+		       GMemoryMonitorWarningLevel level,
+		       EvSidebarThumbnails       *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (priv->start_page < 0)
+		return;
+
+	ev_thumbnails_model_handle_low_memory (priv->store, level,
+					       priv->start_page, priv->end_page);
+}
+#endif
+
 static void
 ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
@@ -763,14 +979,11 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	priv = ev_sidebar_thumbnails->priv = ev_sidebar_thumbnails_get_instance_private (ev_sidebar_thumbnails);
 	priv->blank_first_dual_mode = FALSE;
 
-	priv->list_store = gtk_list_store_new (NUM_COLUMNS,
-					       G_TYPE_STRING,
-					       CAIRO_GOBJECT_TYPE_SURFACE,
-					       G_TYPE_BOOLEAN,
-					       EV_TYPE_JOB_THUMBNAIL);
+	priv->store = ev_thumbnails_model_new ((EvThumbnailsModelLoadingIconFunc)ev_sidebar_thumbnails_get_loading_icon_for_page,
+					       ev_sidebar_thumbnails);
 
 	signal_id = g_signal_lookup ("row-changed", GTK_TYPE_TREE_MODEL);
-	g_signal_connect (GTK_TREE_MODEL (priv->list_store), "row-changed",
+	g_signal_connect (GTK_TREE_MODEL (priv->store), "row-changed",
 			  G_CALLBACK (ev_sidebar_thumbnails_row_changed),
 			  GUINT_TO_POINTER (signal_id));
 
@@ -791,6 +1004,12 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	g_signal_connect (ev_sidebar_thumbnails, "notify::scale-factor",
 			  G_CALLBACK (ev_sidebar_thumbnails_device_scale_factor_changed_cb), NULL);
 
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	priv->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (priv->memory_monitor, "low-memory-warning",
+			  G_CALLBACK (low_memory_warning_cb), ev_sidebar_thumbnails);
+#endif
+
 	/* Put it all together */
 	gtk_widget_show_all (priv->swindow);
 }
@@ -819,6 +1038,22 @@ ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails *sidebar,
 			 G_CALLBACK (ev_sidebar_icon_selection_changed), sidebar);
 
 		gtk_icon_view_scroll_to_path (GTK_ICON_VIEW (sidebar->priv->icon_view), path, FALSE, 0.0, 0.0);
+	} else if (sidebar->priv->tree_view) {
+		GtkTreeSelection *selection;
+
+		selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (sidebar->priv->tree_view));
+
+		g_signal_handlers_block_by_func
+			(selection,
+			 G_CALLBACK (ev_sidebar_tree_selection_changed), sidebar);
+
+		gtk_tree_selection_select_path (selection, path);
+
+		g_signal_handlers_unblock_by_func
+			(selection,
+			 G_CALLBACK (ev_sidebar_tree_selection_changed), sidebar);
+
+		gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (sidebar->priv->tree_view), path, NULL, FALSE, 0.0, 0.0);
 	}
 
 	gtk_tree_path_free (path);
@@ -890,38 +1125,58 @@ static void
 thumbnail_job_completed_callback (EvJobThumbnail      *job,
 				  EvSidebarThumbnails *sidebar_thumbnails)
 {
-        GtkWidget                  *widget = GTK_WIDGET (sidebar_thumbnails);
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 	GtkTreeIter                *iter;
-        cairo_surface_t            *surface;
-#ifdef HAVE_HIDPI_SUPPORT
-        gint                        device_scale;
-#endif
 
         if (ev_job_is_failed (EV_JOB (job)))
           return;
 
-#ifdef HAVE_HIDPI_SUPPORT
-        device_scale = gtk_widget_get_scale_factor (widget);
-        cairo_surface_set_device_scale (job->thumbnail_surface, device_scale, device_scale);
-#endif
+	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
+	ev_sidebar_thumbnails_set_thumbnail (sidebar_thumbnails, iter,
+					     job->thumbnail_surface,
+					     priv->inverted_colors);
 
-        surface = ev_document_misc_render_thumbnail_surface_with_frame (widget,
-                                                                        job->thumbnail_surface,
-                                                                        -1, -1);
+	gtk_widget_queue_draw (ev_sidebar_thumbnails_get_main_widget (sidebar_thumbnails));
+}
 
-	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
-	if (priv->inverted_colors)
-		ev_document_misc_invert_surface (surface);
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_SURFACE, surface,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
+static void
+view_page_rendered_cb (EvView              *view,
+		       gint                 page,
+		       EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+	EvJob       *job;
+	gboolean     thumbnail_set;
+	gboolean     result;
+
+	if (!priv->document || page >= priv->n_pages)
+		return;
+
+	path = gtk_tree_path_new_from_indices (priv->blank_first_dual_mode ? page + 1 : page, -1);
+	result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), &iter, path);
+	gtk_tree_path_free (path);
+	if (!result)
+		return;
+
+	gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
+			    COLUMN_JOB, &job,
+			    COLUMN_THUMBNAIL_SET, &thumbnail_set,
 			    -1);
-        cairo_surface_destroy (surface);
 
-	gtk_widget_queue_draw (priv->icon_view);
+	if (!thumbnail_set &&
+	    ev_sidebar_thumbnails_set_thumbnail_from_view (sidebar_thumbnails, &iter, page)) {
+		/* The pending backend job is no longer needed */
+		if (job) {
+			g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
+			ev_job_cancel (job);
+		}
+
+		gtk_widget_queue_draw (ev_sidebar_thumbnails_get_main_widget (sidebar_thumbnails));
+	}
+
+	g_clear_object (&job);
 }
 
 static void
@@ -954,11 +1209,37 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 	ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
 	ev_sidebar_thumbnails_fill_model (sidebar_thumbnails);
 
-	if (! priv->icon_view) {
-		ev_sidebar_init_icon_view (sidebar_thumbnails);
-		g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
+	if (priv->n_pages <= MAX_ICON_VIEW_PAGE_COUNT) {
+		if (priv->tree_view) {
+			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->tree_view);
+			priv->tree_view = NULL;
+		}
+
+		if (! priv->icon_view) {
+			ev_sidebar_init_icon_view (sidebar_thumbnails);
+			g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
+		} else {
+			gtk_widget_queue_resize (priv->icon_view);
+		}
 	} else {
-		gtk_widget_queue_resize (priv->icon_view);
+		if (priv->icon_view) {
+			g_signal_handlers_disconnect_by_func (priv->model,
+							      check_toggle_blank_first_dual_mode,
+							      sidebar_thumbnails);
+			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->icon_view);
+			priv->icon_view = NULL;
+			priv->blank_first_dual_mode = FALSE;
+		}
+
+		if (! priv->tree_view) {
+			ev_sidebar_init_tree_view (sidebar_thumbnails);
+			g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
+		}
+
+		/* With pages of the same size, only the visible rows
+		 * are measured, instead of all of them in the background */
+		gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (priv->tree_view),
+						     priv->size_cache->uniform);
 	}
 
 	/* Connect to the signal and trigger a fake callback */
@@ -997,23 +1278,12 @@ ev_sidebar_thumbnails_set_model (EvSidebarPage   *sidebar_page,
 			  sidebar_page);
 }
 
-static gboolean
-ev_sidebar_thumbnails_clear_job (GtkTreeModel *model,
-			         GtkTreePath *path,
-			         GtkTreeIter *iter,
-				 gpointer data)
+static void
+ev_sidebar_thumbnails_clear_job (EvJob               *job,
+				 EvSidebarThumbnails *sidebar_thumbnails)
 {
-	EvJob *job;
-
-	gtk_tree_model_get (model, iter, COLUMN_JOB, &job, -1);
-
-	if (job != NULL) {
-		ev_job_cancel (job);
-		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, data);
-		g_object_unref (job);
-	}
-
-	return FALSE;
+	ev_job_cancel (job);
+	g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
 }
 
 static void
@@ -1021,8 +1291,44 @@ ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
-	gtk_list_store_clear (priv->list_store);
+	ev_thumbnails_model_foreach_job (priv->store,
+					 (GFunc)ev_sidebar_thumbnails_clear_job,
+					 sidebar_thumbnails);
+}
+
+/**
+ * ev_sidebar_thumbnails_set_view:
+ * @sidebar_thumbnails: a #EvSidebarThumbnails
+ * @view: the #EvView showing the same document
+ *
+ * Lets the sidebar build thumbnails out of the pages already rendered by
+ * @view instead of rendering them again.
+ */
+void
+ev_sidebar_thumbnails_set_view (EvSidebarThumbnails *sidebar_thumbnails,
+				EvView              *view)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	if (priv->view == view)
+		return;
+
+	if (priv->view) {
+		g_signal_handlers_disconnect_by_func (priv->view,
+						      view_page_rendered_cb,
+						      sidebar_thumbnails);
+		g_object_remove_weak_pointer (G_OBJECT (priv->view),
+					      (gpointer)&priv->view);
+	}
+
+	priv->view = view;
+	if (!view)
+		return;
+
+	g_object_add_weak_pointer (G_OBJECT (view), (gpointer)&priv->view);
+	g_signal_connect_object (view, "page-rendered",
+				 G_CALLBACK (view_page_rendered_cb),
+				 sidebar_thumbnails, 0);
 }
 
 static gboolean
@@ -1283,6 +1589,10 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 
 	priv = sidebar_thumbnails->priv;
 
+	/* The list has a single column */
+	if (!priv->icon_view)
+		return;
+
 	dual_mode = ev_document_model_get_dual_page (priv->model);
 	odd_pages_left = ev_document_model_get_dual_page_odd_pages_left (priv->model);
 	should_be_enabled = dual_mode && !odd_pages_left;
@@ -1294,7 +1604,7 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 
 	if (should_be_enabled && !priv->blank_first_dual_mode) {
 		/* Do enable it */
-		tree_model = GTK_TREE_MODEL (priv->list_store);
+		tree_model = GTK_TREE_MODEL (priv->store);
 
 		if (!gtk_tree_model_get_iter_first (tree_model, &first))
 			return;
@@ -1304,11 +1614,7 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 			if (iter_is_blank_thumbnail (tree_model, &first))
 				return; /* extra check */
 
-			gtk_list_store_insert_with_values (priv->list_store, &first, 0,
-							   COLUMN_SURFACE, NULL,
-							   COLUMN_THUMBNAIL_SET, TRUE,
-							   COLUMN_JOB, NULL,
-							   -1);
+			ev_thumbnails_model_set_blank_first (priv->store, TRUE);
 		}
 		if (resize_sidebar && is_one_column) {
 			sidebar = ev_sidebar_thumbnails_get_ev_sidebar (sidebar_thumbnails);
@@ -1319,7 +1625,7 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 		}
 	} else if (!should_be_enabled && priv->blank_first_dual_mode) {
 		/* Do disable it */
-		tree_model = GTK_TREE_MODEL (priv->list_store);
+		tree_model = GTK_TREE_MODEL (priv->store);
 
 		if (!gtk_tree_model_get_iter_first (tree_model, &first))
 			return;
@@ -1328,7 +1634,7 @@ check_toggle_blank_first_dual_mode_real (EvSidebarThumbnails *sidebar_thumbnails
 		if (!iter_is_blank_thumbnail (tree_model, &first))
 			return; /* extra check */
 
-		gtk_list_store_remove (priv->list_store, &first);
+		ev_thumbnails_model_set_blank_first (priv->store, FALSE);
 
 		if (resize_sidebar && is_two_columns) {
 			sidebar = ev_sidebar_thumbnails_get_ev_sidebar (sidebar_thumbnails);
@@ -25,6 +25,8 @@
 
 #include <gtk/gtk.h>
 
+#include "ev-view.h"
+
 G_BEGIN_DECLS
 
 typedef struct _EvSidebarThumbnails EvSidebarThumbnails;
@@ -50,5 +52,7 @@ struct _EvSidebarThumbnailsClass {
 
 GType      ev_sidebar_thumbnails_get_type     (void) G_GNUC_CONST;
 GtkWidget *ev_sidebar_thumbnails_new          (void);
+void       ev_sidebar_thumbnails_set_view     (EvSidebarThumbnails *sidebar_thumbnails,
+					       EvView              *view);
 
 G_END_DECLS
@@ -0,0 +1,549 @@
+/* ev-thumbnails-model.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* A list model with one row per page of a document, plus an optional
+ * blank row before the first page. Rows are virtual: the page label and
+ * the loading icon are computed when requested, and only the pages that
+ * have a thumbnail or a pending job use any memory, so the cost of the
+ * model doesn't depend on the number of pages of the document.
+ */
+
+#include "config.h"
+
+#include <cairo-gobject.h>
+
+#include "ev-thumbnails-model.h"
+
+typedef struct _EvThumbnailsEntry {
+	cairo_surface_t *surface;
+	gboolean         thumbnail_set;
+	EvJob           *job;
+} EvThumbnailsEntry;
+
+struct _EvThumbnailsModel {
+	GObject base;
+
+	EvDocument *document;
+	gint        n_pages;
+	gboolean    blank_first;
+	gint        stamp;
+
+	/* page index -> EvThumbnailsEntry */
+	GHashTable *entries;
+
+	EvThumbnailsModelLoadingIconFunc loading_icon_func;
+	gpointer                         user_data;
+};
+
+struct _EvThumbnailsModelClass {
+	GObjectClass base_class;
+};
+
+/* The page index is stored in the iter shifted by one, so that the
+ * blank row, which has page index -1, is stored as 0 */
+#define ITER_GET_PAGE(iter) (GPOINTER_TO_INT ((iter)->user_data) - 1)
+
+static void ev_thumbnails_model_tree_model_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvThumbnailsModel, ev_thumbnails_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						ev_thumbnails_model_tree_model_init))
+
+static void
+ev_thumbnails_entry_free (EvThumbnailsEntry *entry)
+{
+	g_clear_pointer (&entry->surface, cairo_surface_destroy);
+	g_clear_object (&entry->job);
+	g_free (entry);
+}
+
+static gint
+ev_thumbnails_model_get_n_rows (EvThumbnailsModel *model)
+{
+	return model->n_pages + (model->blank_first ? 1 : 0);
+}
+
+static gint
+ev_thumbnails_model_get_row (EvThumbnailsModel *model,
+			     gint               page)
+{
+	return model->blank_first ? page + 1 : page;
+}
+
+static void
+ev_thumbnails_model_init_iter (EvThumbnailsModel *model,
+			       GtkTreeIter       *iter,
+			       gint               page)
+{
+	iter->stamp = model->stamp;
+	iter->user_data = GINT_TO_POINTER (page + 1);
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+static gboolean
+ev_thumbnails_model_iter_for_row (EvThumbnailsModel *model,
+				  GtkTreeIter       *iter,
+				  gint               row)
+{
+	if (row < 0 || row >= ev_thumbnails_model_get_n_rows (model))
+		return FALSE;
+
+	ev_thumbnails_model_init_iter (model, iter,
+				       model->blank_first ? row - 1 : row);
+	return TRUE;
+}
+
+static EvThumbnailsEntry *
+ev_thumbnails_model_ensure_entry (EvThumbnailsModel *model,
+				  gint               page)
+{
+	EvThumbnailsEntry *entry;
+
+	entry = g_hash_table_lookup (model->entries, GINT_TO_POINTER (page));
+	if (!entry) {
+		entry = g_new0 (EvThumbnailsEntry, 1);
+		g_hash_table_insert (model->entries, GINT_TO_POINTER (page), entry);
+	}
+
+	return entry;
+}
+
+static void
+ev_thumbnails_model_page_changed (EvThumbnailsModel *model,
+				  GtkTreeIter       *iter)
+{
+	GtkTreePath *path;
+
+	path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, iter);
+	gtk_tree_path_free (path);
+}
+
+static void
+ev_thumbnails_model_dispose (GObject *object)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (object);
+
+	g_clear_pointer (&model->entries, g_hash_table_destroy);
+	g_clear_object (&model->document);
+
+	G_OBJECT_CLASS (ev_thumbnails_model_parent_class)->dispose (object);
+}
+
+static void
+ev_thumbnails_model_init (EvThumbnailsModel *model)
+{
+	model->stamp = g_random_int ();
+	model->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						NULL,
+						(GDestroyNotify)ev_thumbnails_entry_free);
+}
+
+static void
+ev_thumbnails_model_class_init (EvThumbnailsModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = ev_thumbnails_model_dispose;
+}
+
+/* GtkTreeModelIface */
+static GtkTreeModelFlags
+ev_thumbnails_model_get_flags (GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+ev_thumbnails_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return EV_THUMBNAILS_MODEL_N_COLUMNS;
+}
+
+static GType
+ev_thumbnails_model_get_column_type (GtkTreeModel *tree_model,
+				     gint          index)
+{
+	switch (index) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING:
+		return G_TYPE_STRING;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE:
+		return CAIRO_GOBJECT_TYPE_SURFACE;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		return G_TYPE_BOOLEAN;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		return EV_TYPE_JOB_THUMBNAIL;
+	default:
+		g_assert_not_reached ();
+	}
+
+	return G_TYPE_INVALID;
+}
+
+static gboolean
+ev_thumbnails_model_get_iter (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter,
+			      GtkTreePath  *path)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	if (gtk_tree_path_get_depth (path) != 1)
+		return FALSE;
+
+	return ev_thumbnails_model_iter_for_row (model, iter,
+						 gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+ev_thumbnails_model_get_path (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices (ev_thumbnails_model_get_row (model, ITER_GET_PAGE (iter)), -1);
+}
+
+static void
+ev_thumbnails_model_get_value (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter,
+			       gint          column,
+			       GValue       *value)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	EvThumbnailsEntry *entry = NULL;
+	gint               page;
+
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	page = ITER_GET_PAGE (iter);
+	if (page >= 0)
+		entry = g_hash_table_lookup (model->entries, GINT_TO_POINTER (page));
+
+	g_value_init (value, ev_thumbnails_model_get_column_type (tree_model, column));
+
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING:
+		if (page >= 0) {
+			gchar *page_label;
+
+			page_label = ev_document_get_page_label (model->document, page);
+			g_value_take_string (value, g_markup_printf_escaped ("<i>%s</i>", page_label));
+			g_free (page_label);
+		}
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_SURFACE:
+		if (page < 0)
+			break;
+
+		if (entry && entry->thumbnail_set)
+			g_value_set_boxed (value, entry->surface);
+		else if (model->loading_icon_func)
+			g_value_set_boxed (value, model->loading_icon_func (model, page, model->user_data));
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		g_value_set_boolean (value, page < 0 || (entry && entry->thumbnail_set));
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		if (entry)
+			g_value_set_object (value, entry->job);
+		break;
+	}
+}
+
+static gboolean
+ev_thumbnails_model_iter_next (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	gint               page = ITER_GET_PAGE (iter);
+
+	if (page + 1 >= model->n_pages) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	ev_thumbnails_model_init_iter (model, iter, page + 1);
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_iter_previous (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+	gint               page = ITER_GET_PAGE (iter);
+
+	if (page - 1 < (model->blank_first ? -1 : 0)) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	ev_thumbnails_model_init_iter (model, iter, page - 1);
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_iter_nth_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    GtkTreeIter  *parent,
+				    gint          n)
+{
+	if (parent)
+		return FALSE;
+
+	return ev_thumbnails_model_iter_for_row (EV_THUMBNAILS_MODEL (tree_model), iter, n);
+}
+
+static gboolean
+ev_thumbnails_model_iter_children (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreeIter  *parent)
+{
+	return ev_thumbnails_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+ev_thumbnails_model_iter_has_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+ev_thumbnails_model_iter_n_children (GtkTreeModel *tree_model,
+				     GtkTreeIter  *iter)
+{
+	if (iter)
+		return 0;
+
+	return ev_thumbnails_model_get_n_rows (EV_THUMBNAILS_MODEL (tree_model));
+}
+
+static gboolean
+ev_thumbnails_model_iter_parent (GtkTreeModel *tree_model,
+				 GtkTreeIter  *iter,
+				 GtkTreeIter  *child)
+{
+	return FALSE;
+}
+
+static void
+ev_thumbnails_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = ev_thumbnails_model_get_flags;
+	iface->get_n_columns = ev_thumbnails_model_get_n_columns;
+	iface->get_column_type = ev_thumbnails_model_get_column_type;
+	iface->get_iter = ev_thumbnails_model_get_iter;
+	iface->get_path = ev_thumbnails_model_get_path;
+	iface->get_value = ev_thumbnails_model_get_value;
+	iface->iter_next = ev_thumbnails_model_iter_next;
+	iface->iter_previous = ev_thumbnails_model_iter_previous;
+	iface->iter_children = ev_thumbnails_model_iter_children;
+	iface->iter_has_child = ev_thumbnails_model_iter_has_child;
+	iface->iter_n_children = ev_thumbnails_model_iter_n_children;
+	iface->iter_nth_child = ev_thumbnails_model_iter_nth_child;
+	iface->iter_parent = ev_thumbnails_model_iter_parent;
+}
+
+EvThumbnailsModel *
+ev_thumbnails_model_new (EvThumbnailsModelLoadingIconFunc loading_icon_func,
+			 gpointer                         user_data)
+{
+	EvThumbnailsModel *model;
+
+	model = g_object_new (EV_TYPE_THUMBNAILS_MODEL, NULL);
+	model->loading_icon_func = loading_icon_func;
+	model->user_data = user_data;
+
+	return model;
+}
+
+/* Drops all the thumbnails and jobs, invalidates all the iters and sets
+ * the number of rows to the number of pages of @document. No signal is
+ * emitted, so the model must not be attached to any view when calling
+ * this; attaching it afterwards lets the view build all its items in one
+ * go, instead of processing a signal per page. */
+void
+ev_thumbnails_model_set_document (EvThumbnailsModel *model,
+				  EvDocument        *document)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	g_set_object (&model->document, document);
+	model->n_pages = document ? ev_document_get_n_pages (document) : 0;
+	model->blank_first = FALSE;
+	model->stamp++;
+	g_hash_table_remove_all (model->entries);
+}
+
+/* Returns the page index of the row, or -1 for the blank row */
+gint
+ev_thumbnails_model_get_page (EvThumbnailsModel *model,
+			      GtkTreeIter       *iter)
+{
+	g_return_val_if_fail (EV_IS_THUMBNAILS_MODEL (model), -1);
+	g_return_val_if_fail (iter->stamp == model->stamp, -1);
+
+	return ITER_GET_PAGE (iter);
+}
+
+gboolean
+ev_thumbnails_model_get_blank_first (EvThumbnailsModel *model)
+{
+	g_return_val_if_fail (EV_IS_THUMBNAILS_MODEL (model), FALSE);
+
+	return model->blank_first;
+}
+
+void
+ev_thumbnails_model_set_blank_first (EvThumbnailsModel *model,
+				     gboolean           blank_first)
+{
+	GtkTreePath *path;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	if (model->blank_first == blank_first)
+		return;
+
+	model->blank_first = blank_first;
+
+	path = gtk_tree_path_new_first ();
+	if (blank_first) {
+		GtkTreeIter iter;
+
+		ev_thumbnails_model_init_iter (model, &iter, -1);
+		gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+	} else {
+		gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+	}
+	gtk_tree_path_free (path);
+}
+
+void
+ev_thumbnails_model_set_job (EvThumbnailsModel *model,
+			     GtkTreeIter       *iter,
+			     EvJob             *job)
+{
+	EvThumbnailsEntry *entry;
+	gint               page;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	page = ITER_GET_PAGE (iter);
+	if (page < 0)
+		return;
+
+	entry = ev_thumbnails_model_ensure_entry (model, page);
+	g_set_object (&entry->job, job);
+
+	if (!entry->job && !entry->thumbnail_set)
+		g_hash_table_remove (model->entries, GINT_TO_POINTER (page));
+
+	ev_thumbnails_model_page_changed (model, iter);
+}
+
+void
+ev_thumbnails_model_set_thumbnail (EvThumbnailsModel *model,
+				   GtkTreeIter       *iter,
+				   cairo_surface_t   *surface)
+{
+	EvThumbnailsEntry *entry;
+	gint               page;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	page = ITER_GET_PAGE (iter);
+	if (page < 0)
+		return;
+
+	entry = ev_thumbnails_model_ensure_entry (model, page);
+	g_clear_pointer (&entry->surface, cairo_surface_destroy);
+	entry->surface = cairo_surface_reference (surface);
+	entry->thumbnail_set = TRUE;
+	g_clear_object (&entry->job);
+
+	ev_thumbnails_model_page_changed (model, iter);
+}
+
+/* Calls @func for every pending job, in no particular order */
+void
+ev_thumbnails_model_foreach_job (EvThumbnailsModel *model,
+				 GFunc              func,
+				 gpointer           user_data)
+{
+	GHashTableIter     iter;
+	EvThumbnailsEntry *entry;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	g_hash_table_iter_init (&iter, model->entries);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&entry)) {
+		if (entry->job)
+			func (entry->job, user_data);
+	}
+}
+
+/* Drops the thumbnails of the pages out of the given range, so that
+ * they're loaded again when they get close to the visible area. Pages
+ * with a pending job are kept. */
+void
+ev_thumbnails_model_prune (EvThumbnailsModel *model,
+			   gint               start_page,
+			   gint               end_page)
+{
+	GHashTableIter     iter;
+	gpointer           key;
+	EvThumbnailsEntry *entry;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	g_hash_table_iter_init (&iter, model->entries);
+	while (g_hash_table_iter_next (&iter, &key, (gpointer *)&entry)) {
+		gint page = GPOINTER_TO_INT (key);
+
+		if (entry->job || (page >= start_page && page <= end_page))
+			continue;
+
+		g_hash_table_iter_remove (&iter);
+	}
+}
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+/* Thumbnails are the last thing released when the system is low on
+ * memory, only on critical warnings: the ones out of the range, which
+ * includes the preloaded ones, are loaded again when needed */
+void
+ev_thumbnails_model_handle_low_memory (EvThumbnailsModel         *model,
+				       GMemoryMonitorWarningLevel level,
+				       gint                       start_page,
+				       gint                       end_page)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	if (level < G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL)
+		return;
+
+	ev_thumbnails_model_prune (model, start_page, end_page);
+}
+#endif
@@ -204,6 +204,7 @@ typedef struct {
 	EvWindowPageMode page_mode;
 	EvWindowTitle *title;
 	EvMetadata *metadata;
+	GCancellable *metadata_cancellable;
 	EvBookmarks *bookmarks;
 
 	/* Has the document been modified? */
@@ -259,6 +260,7 @@ typedef struct {
 #define GS_SCHEMA_NAME           "org.gnome.Evince"
 #define GS_OVERRIDE_RESTRICTIONS "override-restrictions"
 #define GS_PAGE_CACHE_SIZE       "page-cache-size"
+#define GS_COMPRESS_PRELOADED_PAGES "compress-preloaded-pages"
 #define GS_AUTO_RELOAD           "auto-reload"
 #define GS_LAST_DOCUMENT_DIRECTORY "document-directory"
 #define GS_LAST_PICTURES_DIRECTORY "pictures-directory"
@@ -376,6 +378,9 @@ static void     view_external_link_cb                   (EvWindow         *windo
 							 EvLinkAction     *action);
 static void     ev_window_load_file_remote              (EvWindow         *ev_window,
 							 GFile            *source_file);
+static void     ev_window_open_uri_metadata_cb          (GFile            *source_file,
+							 GAsyncResult     *result,
+							 EvWindow         *ev_window);
 static void     ev_window_media_player_key_pressed      (EvWindow         *window,
 							 const gchar      *key,
 							 gpointer          user_data);
@@ -1560,6 +1565,17 @@ page_cache_size_changed (GSettings *settings,
 				     (gsize) page_cache_mb * 1024 * 1024);
 }
 
+static void
+compress_preloaded_pages_changed (GSettings *settings,
+				  gchar     *key,
+				  EvWindow  *ev_window)
+{
+	EvWindowPrivate *priv = GET_PRIVATE (ev_window);
+
+	ev_view_set_compress_preloaded_pages (EV_VIEW (priv->view),
+					      g_settings_get_boolean (settings, GS_COMPRESS_PRELOADED_PAGES));
+}
+
 static void
 allow_links_change_zoom_changed (GSettings *settings,
 			 gchar     *key,
@@ -1647,6 +1663,10 @@ ev_window_ensure_settings (EvWindow *ev_window)
 			  "changed::"GS_PAGE_CACHE_SIZE,
 			  G_CALLBACK (page_cache_size_changed),
 			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_COMPRESS_PRELOADED_PAGES,
+			  G_CALLBACK (compress_preloaded_pages_changed),
+			  ev_window);
         g_signal_connect (priv->settings,
 			  "changed::"GS_ALLOW_LINKS_CHANGE_ZOOM,
 			  G_CALLBACK (allow_links_change_zoom_changed),
@@ -1814,6 +1834,13 @@ ev_window_clear_load_job (EvWindow *ev_window)
 {
 	EvWindowPrivate *priv = GET_PRIVATE (ev_window);
 
+	/* Loading starts by reading the metadata of the file, a late
+	 * result must not load it over the new document */
+	if (priv->metadata_cancellable) {
+		g_cancellable_cancel (priv->metadata_cancellable);
+		g_clear_object (&priv->metadata_cancellable);
+	}
+
 	if (priv->load_job != NULL) {
 		if (!ev_job_is_finished (priv->load_job))
 			ev_job_cancel (priv->load_job);
@@ -2398,8 +2425,11 @@ ev_window_open_uri (EvWindow       *ev_window,
 	priv->search_string = search_string ?
 		g_strdup (search_string) : NULL;
 
+	/* While the metadata is read there's neither a document
+	 * nor a load job yet, so there's nothing to reload */
 	if (priv->uri &&
 	    g_ascii_strcasecmp (priv->uri, uri) == 0 &&
+	    (priv->document || priv->load_job) &&
 	    !priv->password_view_cancelled) {
 		if (ev_window_check_document_modified (ev_window, EV_WINDOW_ACTION_RELOAD))
 			return;
@@ -2428,18 +2458,51 @@ ev_window_open_uri (EvWindow       *ev_window,
 	g_clear_object (&priv->metadata);
 	g_clear_object (&priv->bookmarks);
 
-	if (ev_is_metadata_supported_for_file (source_file)) {
-		priv->metadata = ev_metadata_new (source_file);
+	g_clear_object (&priv->dest);
+	priv->dest = dest ? g_object_ref (dest) : NULL;
+
+	/* The document is loaded once the metadata is available, since
+	 * it's used to set up the window and the model before loading.
+	 * ev_window_clear_load_job() cancelled any previous request. */
+	priv->metadata_cancellable = g_cancellable_new ();
+
+	ev_metadata_new_async (source_file,
+			       priv->metadata_cancellable,
+			       (GAsyncReadyCallback)ev_window_open_uri_metadata_cb,
+			       ev_window);
+	g_object_unref (source_file);
+}
+
+static void
+ev_window_open_uri_metadata_cb (GFile        *source_file,
+				GAsyncResult *result,
+				EvWindow     *ev_window)
+{
+	EvWindowPrivate *priv;
+	EvMetadata *metadata;
+	g_autofree char *path = NULL;
+	GError *error = NULL;
+
+	metadata = ev_metadata_new_finish (result, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The window was closed or another document is being opened */
+		g_error_free (error);
+		return;
+	}
+	g_clear_error (&error);
+
+	priv = GET_PRIVATE (ev_window);
+	g_clear_object (&priv->metadata_cancellable);
+
+	if (metadata) {
+		priv->metadata = metadata;
 		ev_window_init_metadata_with_default_values (ev_window);
-		if (priv->metadata) {
-			priv->bookmarks = ev_bookmarks_new (priv->metadata);
-			ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (priv->sidebar_bookmarks),
-							    priv->bookmarks);
-		}
+		priv->bookmarks = ev_bookmarks_new (priv->metadata);
+		ev_sidebar_bookmarks_set_bookmarks (EV_SIDEBAR_BOOKMARKS (priv->sidebar_bookmarks),
+						    priv->bookmarks);
 	}
 
-	g_clear_object (&priv->dest);
-	priv->dest = dest ? g_object_ref (dest) : NULL;
+	path = g_file_get_path (source_file);
 
 	set_filenames (ev_window, source_file);
 	setup_size_from_metadata (ev_window);
@@ -2451,11 +2514,12 @@ ev_window_open_uri (EvWindow       *ev_window,
 			  G_CALLBACK (ev_window_load_job_cb),
 			  ev_window);
 
+	/* source_file belongs to the metadata task, and loading takes
+	 * ownership of it */
 	if (path == NULL && !priv->local_uri) {
-		ev_window_load_file_remote (ev_window, source_file);
+		ev_window_load_file_remote (ev_window, g_object_ref (source_file));
 	} else {
 		ev_window_show_loading_message (ev_window);
-		g_object_unref (source_file);
 		ev_job_scheduler_push_job (priv->load_job, EV_JOB_PRIORITY_NONE);
 	}
 }
@@ -4137,6 +4201,9 @@ ev_window_close (EvWindow *ev_window)
 	if (!ev_window_is_recent_view (ev_window))
 		ev_window_save_settings (ev_window);
 
+	if (priv->metadata)
+		ev_metadata_flush (priv->metadata);
+
 	return TRUE;
 }
 
@@ -6108,6 +6175,10 @@ ev_window_dispose (GObject *object)
 	}
 #endif /* ENABLE_DBUS */
 
+	if (priv->metadata_cancellable) {
+		g_cancellable_cancel (priv->metadata_cancellable);
+		g_clear_object (&priv->metadata_cancellable);
+	}
 	g_clear_object (&priv->bookmarks);
 	g_clear_object (&priv->metadata);
 
@@ -7660,11 +7731,16 @@ ev_window_init (EvWindow *ev_window)
 					     GS_PAGE_CACHE_SIZE);
 	ev_view_set_page_cache_size (EV_VIEW (priv->view),
 				     (gsize) page_cache_mb * 1024 * 1024);
+	ev_view_set_compress_preloaded_pages (EV_VIEW (priv->view),
+					      g_settings_get_boolean (ev_window_ensure_settings (ev_window),
+								      GS_COMPRESS_PRELOADED_PAGES));
 	allow_links_change_zoom = g_settings_get_boolean (ev_window_ensure_settings (ev_window),
 				     GS_ALLOW_LINKS_CHANGE_ZOOM);
 	ev_view_set_allow_links_change_zoom (EV_VIEW (priv->view),
 				     allow_links_change_zoom);
 	ev_view_set_model (EV_VIEW (priv->view), priv->model);
+	ev_sidebar_thumbnails_set_view (EV_SIDEBAR_THUMBNAILS (priv->sidebar_thumbs),
+					EV_VIEW (priv->view));
 
 	priv->password_view_cancelled = FALSE;
 	priv->password_view = ev_password_view_new (GTK_WINDOW (ev_window));
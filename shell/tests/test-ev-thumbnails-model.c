@@ -0,0 +1,171 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "ev-thumbnails-model.h"
+
+#define N_PAGES 10
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+
+/* A document of blank pages */
+typedef struct {
+	EvDocument parent;
+} TestDocument;
+
+typedef struct {
+	EvDocumentClass parent_class;
+} TestDocumentClass;
+
+GType test_document_get_type (void);
+G_DEFINE_TYPE (TestDocument, test_document, EV_TYPE_DOCUMENT)
+
+static gboolean
+test_document_load (EvDocument  *document,
+		    const char  *uri,
+		    GError     **error)
+{
+	return TRUE;
+}
+
+static gint
+test_document_get_n_pages (EvDocument *document)
+{
+	return N_PAGES;
+}
+
+static void
+test_document_get_page_size (EvDocument *document,
+			     EvPage     *page,
+			     double     *width,
+			     double     *height)
+{
+	*width = 100;
+	*height = 100;
+}
+
+static void
+test_document_init (TestDocument *document)
+{
+}
+
+static void
+test_document_class_init (TestDocumentClass *klass)
+{
+	EvDocumentClass *document_class = EV_DOCUMENT_CLASS (klass);
+
+	document_class->load = test_document_load;
+	document_class->get_n_pages = test_document_get_n_pages;
+	document_class->get_page_size = test_document_get_page_size;
+}
+
+static cairo_surface_t *
+get_loading_icon (EvThumbnailsModel *model,
+		  gint               page,
+		  gpointer           user_data)
+{
+	return user_data;
+}
+
+static gboolean
+thumbnail_is_set (EvThumbnailsModel *model,
+		  gint               page)
+{
+	GtkTreeIter iter;
+	gboolean    thumbnail_set;
+
+	g_assert_true (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model),
+						      &iter, NULL, page));
+	gtk_tree_model_get (GTK_TREE_MODEL (model), &iter,
+			    EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET, &thumbnail_set,
+			    -1);
+
+	return thumbnail_set;
+}
+
+static void
+set_all_thumbnails (EvThumbnailsModel *model)
+{
+	cairo_surface_t *surface;
+	GtkTreeIter      iter;
+	gint             page;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 10, 10);
+	for (page = 0; page < N_PAGES; page++) {
+		g_assert_true (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model),
+							      &iter, NULL, page));
+		ev_thumbnails_model_set_thumbnail (model, &iter, surface);
+	}
+	cairo_surface_destroy (surface);
+}
+
+static void
+test_low_memory (void)
+{
+	static const GMemoryMonitorWarningLevel levels[] = {
+		G_MEMORY_MONITOR_WARNING_LEVEL_LOW,
+		G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM,
+		G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL
+	};
+	EvDocument        *document;
+	EvThumbnailsModel *model;
+	cairo_surface_t   *loading_icon;
+	GError            *error = NULL;
+	guint              i;
+	gint               page;
+
+	document = g_object_new (test_document_get_type (), NULL);
+	ev_document_load (document, "file:///nonexistent/test-document", &error);
+	g_assert_no_error (error);
+	loading_icon = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 10, 10);
+	model = ev_thumbnails_model_new (get_loading_icon, loading_icon);
+	ev_thumbnails_model_set_document (model, document);
+
+	for (i = 0; i < G_N_ELEMENTS (levels); i++) {
+		set_all_thumbnails (model);
+
+		/* Pages 3 to 5 are the visible range */
+		ev_thumbnails_model_handle_low_memory (model, levels[i], 3, 5);
+
+		/* Only critical warnings drop the thumbnails out of it */
+		for (page = 0; page < N_PAGES; page++) {
+			gboolean kept;
+
+			kept = levels[i] < G_MEMORY_MONITOR_WARNING_LEVEL_CRITICAL ||
+				(page >= 3 && page <= 5);
+			g_assert_cmpint (thumbnail_is_set (model, page), ==, kept);
+		}
+	}
+
+	g_object_unref (model);
+	cairo_surface_destroy (loading_icon);
+	g_object_unref (document);
+}
+#endif
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+#if GLIB_CHECK_VERSION (2, 64, 0)
+	g_test_add_func ("/thumbnails-model/low-memory", test_low_memory);
+#endif
+
+	return g_test_run ();
+}
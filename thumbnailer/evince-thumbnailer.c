@@ -22,7 +22,9 @@
 
 #include <gio/gio.h>
 
+#include <errno.h>
 #include <locale.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -43,10 +45,16 @@ static gboolean finished = TRUE;
 static gint size = THUMBNAIL_SIZE;
 static gboolean time_limit = TRUE;
 static const gchar **file_arguments;
+static gchar *batch_manifest = NULL;
+static gint batch_jobs = 0;
+static gboolean batch_worker = FALSE;
 
 static const GOptionEntry goption_options[] = {
 	{ "size", 's', 0, G_OPTION_ARG_INT, &size, NULL, "SIZE" },
         { "no-limit", 'l', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &time_limit, "Don't limit the thumbnailing time to 15 seconds", NULL },
+	{ "batch", 'b', 0, G_OPTION_ARG_FILENAME, &batch_manifest, "Create the thumbnails listed in MANIFEST, or in the standard input if MANIFEST is -", "MANIFEST" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &batch_jobs, "Number of documents processed in parallel in batch mode (default: number of processors)", "N" },
+	{ "batch-worker", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &batch_worker, NULL, NULL },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <output>" },
 	{ NULL }
 };
@@ -127,12 +135,13 @@ get_local_path (GFile *file)
 }
 
 static EvDocument *
-evince_thumbnailer_get_document (GFile *file)
+evince_thumbnailer_get_document (GFile   *file,
+				 GError **error)
 {
 	EvDocument *document = NULL;
 	gchar      *uri, *path;
 	GFile      *tmp_file = NULL;
-	GError     *error = NULL;
+	GError     *tmp_error = NULL;
 
 	path = get_local_path (file);
 
@@ -143,20 +152,20 @@ evince_thumbnailer_get_document (GFile *file)
 		template = g_strdup_printf ("document.XXXXXX-%s", base_name);
 		g_free (base_name);
 
-		tmp_file = ev_mkstemp_file (template, &error);
+		tmp_file = ev_mkstemp_file (template, &tmp_error);
 		g_free (template);
 		if (!tmp_file) {
-			g_printerr ("Error loading remote document: %s\n", error->message);
-			g_error_free (error);
+			g_propagate_prefixed_error (error, tmp_error,
+						    "Error loading remote document: ");
 
 			return NULL;
 		}
 
 		g_file_copy (file, tmp_file, G_FILE_COPY_OVERWRITE,
-			     NULL, NULL, NULL, &error);
-		if (error) {
-			g_printerr ("Error loading remote document: %s\n", error->message);
-			g_error_free (error);
+			     NULL, NULL, NULL, &tmp_error);
+		if (tmp_error) {
+			g_propagate_prefixed_error (error, tmp_error,
+						    "Error loading remote document: ");
 			g_object_unref (tmp_file);
 
 			return NULL;
@@ -167,7 +176,7 @@ evince_thumbnailer_get_document (GFile *file)
 		g_free (path);
 	}
 
-	document = ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NO_CACHE, &error);
+	document = ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NO_CACHE, &tmp_error);
 	if (tmp_file) {
 		if (document) {
 			g_object_weak_ref (G_OBJECT (document),
@@ -179,21 +188,28 @@ evince_thumbnailer_get_document (GFile *file)
 		}
 	}
 	g_free (uri);
-	if (error) {
-		if (error->domain == EV_DOCUMENT_ERROR &&
-		    error->code == EV_DOCUMENT_ERROR_ENCRYPTED) {
+	if (tmp_error) {
+		if (tmp_error->domain == EV_DOCUMENT_ERROR &&
+		    tmp_error->code == EV_DOCUMENT_ERROR_ENCRYPTED) {
 			/* FIXME: Create a thumb for cryp docs */
-			g_error_free (error);
+			g_propagate_error (error, tmp_error);
 			return NULL;
 		}
-		g_printerr ("Error loading document: %s\n", error->message);
-		g_error_free (error);
+		g_propagate_prefixed_error (error, tmp_error,
+					    "Error loading document: ");
 		return NULL;
 	}
 
 	return document;
 }
 
+static gboolean
+error_is_encrypted (const GError *error)
+{
+	return error->domain == EV_DOCUMENT_ERROR &&
+		error->code == EV_DOCUMENT_ERROR_ENCRYPTED;
+}
+
 static gboolean
 evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int size)
 {
@@ -237,6 +253,578 @@ evince_thumbnail_pngenc_get_async (struct AsyncData *data)
 	return NULL;
 }
 
+/* Batch mode
+ *
+ * Creating a thumbnail per process means loading the backends, sniffing
+ * the mime type and setting up the document for every file. In batch
+ * mode the jobs are read from a manifest, one per line:
+ *
+ *   INPUT<TAB>OUTPUT[<TAB>SIZE]
+ *
+ * Empty lines and lines starting with '#' are ignored, and SIZE defaults
+ * to the --size option. The jobs are handed out to a bounded pool of
+ * worker processes, each one running this same program with the hidden
+ * --batch-worker option, which keeps the backends loaded and processes
+ * the jobs it reads from its standard input one after another. Using
+ * processes rather than threads keeps the backends that aren't thread
+ * safe working, and allows killing a worker stuck on a document, or
+ * replacing one that crashed, without losing the rest of the batch.
+ *
+ * A result line is written to the standard output for every job:
+ *
+ *   STATUS<TAB>MILLISECONDS<TAB>INPUT<TAB>OUTPUT<TAB>MESSAGE
+ *
+ * where STATUS is one of ok, error, timeout or crash.
+ *
+ * The fields sent to the workers and read back from them are escaped
+ * with g_strescape(), so that tabs and newlines in file names or error
+ * messages don't break the protocol.
+ */
+
+typedef struct {
+	gchar *input;
+	gchar *output;
+	gint   size;
+} BatchJob;
+
+typedef struct {
+	GSubprocess      *process;
+	GOutputStream    *stdin_pipe;
+	GDataInputStream *stdout_pipe;
+	GCancellable     *cancellable;
+	BatchJob         *job;
+	gint64            start_time;
+	guint             timeout_id;
+} BatchWorker;
+
+static gchar       *worker_path;
+static GQueue       batch_queue = G_QUEUE_INIT;
+static GMainLoop   *batch_loop;
+static guint        n_batch_workers_running;
+static guint        n_batch_done;
+static guint        n_batch_failed;
+
+static void batch_worker_next_job (BatchWorker *worker);
+
+static void
+batch_job_free (BatchJob *job)
+{
+	g_free (job->input);
+	g_free (job->output);
+	g_free (job);
+}
+
+static gchar *
+read_line (FILE *stream)
+{
+	GString *line;
+	gchar    buffer[1024];
+
+	line = g_string_new (NULL);
+	while (fgets (buffer, sizeof (buffer), stream)) {
+		g_string_append (line, buffer);
+		if (line->str[line->len - 1] == '\n')
+			break;
+	}
+
+	if (line->len == 0) {
+		g_string_free (line, TRUE);
+		return NULL;
+	}
+
+	while (line->len > 0 &&
+	       (line->str[line->len - 1] == '\n' || line->str[line->len - 1] == '\r'))
+		g_string_truncate (line, line->len - 1);
+
+	return g_string_free (line, FALSE);
+}
+
+static gboolean
+parse_integer (const gchar *str,
+	       gint64       min,
+	       gint64       max,
+	       gint64      *value)
+{
+	gchar *end;
+
+	errno = 0;
+	*value = g_ascii_strtoll (str, &end, 10);
+
+	return errno == 0 && end != str && *end == '\0' &&
+		*value >= min && *value <= max;
+}
+
+/* Returns NULL for lines that aren't jobs. @error is only set when the
+ * line is not valid */
+static BatchJob *
+batch_job_parse (const gchar *line,
+		 gint         default_size,
+		 GError     **error)
+{
+	BatchJob *job;
+	gchar   **fields;
+	gint64    job_size = default_size;
+
+	if (line[0] == '\0' || line[0] == '#')
+		return NULL;
+
+	fields = g_strsplit (line, "\t", 3);
+	if (g_strv_length (fields) < 2 || fields[0][0] == '\0' || fields[1][0] == '\0') {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Expected <input> <output> [<size>] separated by tabs");
+		g_strfreev (fields);
+		return NULL;
+	}
+
+	if (fields[2] && !parse_integer (fields[2], 1, G_MAXINT, &job_size)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Invalid size '%s'", fields[2]);
+		g_strfreev (fields);
+		return NULL;
+	}
+
+	job = g_new (BatchJob, 1);
+	job->input = g_strdup (fields[0]);
+	job->output = g_strdup (fields[1]);
+	job->size = job_size;
+	g_strfreev (fields);
+
+	return job;
+}
+
+/* Escapes the control characters and backslashes of @str, but not the
+ * non ASCII characters that g_strescape() turns into octal by default */
+static gchar *
+batch_escape (const gchar *str)
+{
+	static gchar exceptions[129];
+	gint         i;
+
+	if (exceptions[0] == '\0') {
+		for (i = 0; i < 128; i++)
+			exceptions[i] = (gchar) (0x80 + i);
+	}
+
+	return g_strescape (str, exceptions);
+}
+
+static void
+batch_job_unescape (BatchJob *job)
+{
+	gchar *str;
+
+	str = g_strcompress (job->input);
+	g_free (job->input);
+	job->input = str;
+
+	str = g_strcompress (job->output);
+	g_free (job->output);
+	job->output = str;
+}
+
+static void
+batch_report (const gchar *status,
+	      gint64       elapsed_ms,
+	      BatchJob    *job,
+	      const gchar *message)
+{
+	gchar *escaped = NULL;
+
+	/* Keep the report one line per job, with a fixed number of fields */
+	if (message) {
+		escaped = g_strdup (message);
+		g_strdelimit (escaped, "\t\r\n", ' ');
+	}
+
+	g_print ("%s\t%" G_GINT64_FORMAT "\t%s\t%s\t%s\n",
+		 status, elapsed_ms, job->input, job->output,
+		 escaped ? escaped : "");
+	fflush (stdout);
+	g_free (escaped);
+
+	n_batch_done++;
+	if (strcmp (status, "ok") != 0)
+		n_batch_failed++;
+}
+
+static gboolean
+evince_thumbnailer_process (const gchar *input,
+			    const gchar *output,
+			    gint         thumbnail_size,
+			    GError     **error)
+{
+	EvDocument *document;
+	GFile      *file;
+	gboolean    retval;
+
+	file = g_file_new_for_commandline_arg (input);
+	document = evince_thumbnailer_get_document (file, error);
+	g_object_unref (file);
+
+	if (!document)
+		return FALSE;
+
+	retval = evince_thumbnail_pngenc_get (document, output, thumbnail_size);
+	g_object_unref (document);
+
+	if (!retval)
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "Error rendering thumbnail");
+
+	return retval;
+}
+
+/* Runs in the worker processes: backends are loaded once, then every job
+ * read from the standard input is processed, and its result is written
+ * to the standard output as STATUS<TAB>MILLISECONDS<TAB>MESSAGE */
+static int
+evince_thumbnailer_batch_worker (void)
+{
+	gchar *line;
+
+	if (!ev_init ())
+		return -1;
+
+	while ((line = read_line (stdin))) {
+		BatchJob *job;
+		GError   *error = NULL;
+		gint64    start_time;
+		gint64    elapsed_ms;
+
+		job = batch_job_parse (line, size, &error);
+		g_free (line);
+		if (!job) {
+			if (error) {
+				g_print ("error\t0\t%s\n", error->message);
+				fflush (stdout);
+				g_error_free (error);
+			}
+			continue;
+		}
+		batch_job_unescape (job);
+
+		start_time = g_get_monotonic_time ();
+		evince_thumbnailer_process (job->input, job->output, job->size, &error);
+		elapsed_ms = (g_get_monotonic_time () - start_time) / 1000;
+
+		if (error) {
+			gchar *message = batch_escape (error->message);
+
+			g_print ("error\t%" G_GINT64_FORMAT "\t%s\n", elapsed_ms, message);
+			g_free (message);
+			g_error_free (error);
+		} else {
+			g_print ("ok\t%" G_GINT64_FORMAT "\t\n", elapsed_ms);
+		}
+		fflush (stdout);
+
+		batch_job_free (job);
+	}
+
+	ev_shutdown ();
+
+	return 0;
+}
+
+static void
+batch_worker_stop (BatchWorker *worker)
+{
+	if (worker->timeout_id > 0) {
+		g_source_remove (worker->timeout_id);
+		worker->timeout_id = 0;
+	}
+	if (worker->cancellable) {
+		g_cancellable_cancel (worker->cancellable);
+		g_clear_object (&worker->cancellable);
+	}
+
+	if (worker->process) {
+		/* Closing the standard input makes the worker exit */
+		g_output_stream_close (worker->stdin_pipe, NULL, NULL);
+		g_clear_object (&worker->stdin_pipe);
+		g_clear_object (&worker->stdout_pipe);
+		g_clear_object (&worker->process);
+	}
+}
+
+static gboolean
+batch_worker_start (BatchWorker *worker)
+{
+	GError *error = NULL;
+
+	worker->process = g_subprocess_new (G_SUBPROCESS_FLAGS_STDIN_PIPE |
+					    G_SUBPROCESS_FLAGS_STDOUT_PIPE,
+					    &error,
+					    worker_path, "--batch-worker", NULL);
+	if (!worker->process) {
+		g_printerr ("Error starting thumbnailer worker: %s\n", error->message);
+		g_error_free (error);
+
+		return FALSE;
+	}
+
+	worker->stdin_pipe = g_object_ref (g_subprocess_get_stdin_pipe (worker->process));
+	worker->stdout_pipe = g_data_input_stream_new (g_subprocess_get_stdout_pipe (worker->process));
+
+	return TRUE;
+}
+
+static void
+batch_worker_finished (BatchWorker *worker)
+{
+	batch_worker_stop (worker);
+
+	if (--n_batch_workers_running == 0)
+		g_main_loop_quit (batch_loop);
+}
+
+/* Called when the worker is killed or crashes while processing a job */
+static void
+batch_worker_restart (BatchWorker *worker)
+{
+	if (worker->process)
+		g_subprocess_force_exit (worker->process);
+	batch_worker_stop (worker);
+
+	if (!batch_worker_start (worker)) {
+		batch_worker_finished (worker);
+		return;
+	}
+
+	batch_worker_next_job (worker);
+}
+
+static gboolean
+batch_worker_timeout_cb (BatchWorker *worker)
+{
+	BatchJob *job = worker->job;
+
+	worker->timeout_id = 0;
+	worker->job = NULL;
+
+	batch_report ("timeout",
+		      (g_get_monotonic_time () - worker->start_time) / 1000,
+		      job, "Took too much time to process");
+	batch_job_free (job);
+
+	batch_worker_restart (worker);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+batch_worker_read_cb (GDataInputStream *stream,
+		      GAsyncResult     *result,
+		      BatchWorker      *worker)
+{
+	BatchJob *job;
+	gchar    *line;
+	gchar   **fields;
+	gchar    *message = NULL;
+	guint     n_fields;
+	gint64    elapsed_ms;
+	GError   *error = NULL;
+
+	line = g_data_input_stream_read_line_finish (stream, result, NULL, &error);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		/* The job timed out, and it's already been reported */
+		g_error_free (error);
+		return;
+	}
+
+	if (worker->timeout_id > 0) {
+		g_source_remove (worker->timeout_id);
+		worker->timeout_id = 0;
+	}
+	job = worker->job;
+	worker->job = NULL;
+
+	if (!line) {
+		batch_report ("crash",
+			      (g_get_monotonic_time () - worker->start_time) / 1000,
+			      job, error ? error->message : "Thumbnailer worker exited unexpectedly");
+		g_clear_error (&error);
+		batch_job_free (job);
+
+		batch_worker_restart (worker);
+		return;
+	}
+
+	fields = g_strsplit (line, "\t", 3);
+	n_fields = g_strv_length (fields);
+	g_free (line);
+
+	if (n_fields < 2 ||
+	    !parse_integer (fields[1], 0, G_MAXINT64, &elapsed_ms))
+		elapsed_ms = (g_get_monotonic_time () - worker->start_time) / 1000;
+
+	if (n_fields > 2)
+		message = g_strcompress (fields[2]);
+
+	batch_report (n_fields > 0 && strcmp (fields[0], "ok") == 0 ? "ok" : "error",
+		      elapsed_ms, job, message);
+	g_free (message);
+	g_strfreev (fields);
+	batch_job_free (job);
+
+	batch_worker_next_job (worker);
+}
+
+static void
+batch_worker_next_job (BatchWorker *worker)
+{
+	BatchJob *job;
+	gchar    *line;
+	gchar    *input, *output;
+	GError   *error = NULL;
+
+	job = g_queue_pop_head (&batch_queue);
+	if (!job) {
+		batch_worker_finished (worker);
+		return;
+	}
+
+	input = batch_escape (job->input);
+	output = batch_escape (job->output);
+	line = g_strdup_printf ("%s\t%s\t%d\n", input, output, job->size);
+	g_free (input);
+	g_free (output);
+	worker->job = job;
+	worker->start_time = g_get_monotonic_time ();
+
+	if (!g_output_stream_write_all (worker->stdin_pipe, line, strlen (line),
+					NULL, NULL, &error) ||
+	    !g_output_stream_flush (worker->stdin_pipe, NULL, &error)) {
+		worker->job = NULL;
+		batch_report ("crash", 0, job, error->message);
+		g_error_free (error);
+		batch_job_free (job);
+		g_free (line);
+
+		batch_worker_restart (worker);
+		return;
+	}
+	g_free (line);
+
+	worker->cancellable = worker->cancellable ? worker->cancellable : g_cancellable_new ();
+	g_data_input_stream_read_line_async (worker->stdout_pipe,
+					     G_PRIORITY_DEFAULT,
+					     worker->cancellable,
+					     (GAsyncReadyCallback)batch_worker_read_cb,
+					     worker);
+
+	if (time_limit)
+		worker->timeout_id = g_timeout_add_seconds (DEFAULT_SLEEP_TIME / G_USEC_PER_SEC,
+							    (GSourceFunc)batch_worker_timeout_cb,
+							    worker);
+}
+
+static gboolean
+batch_read_manifest (const gchar *manifest)
+{
+	FILE  *stream;
+	gchar *line;
+	guint  line_number = 0;
+
+	if (g_strcmp0 (manifest, "-") == 0) {
+		stream = stdin;
+	} else {
+		stream = fopen (manifest, "r");
+		if (!stream) {
+			g_printerr ("Error opening manifest %s: %s\n",
+				    manifest, g_strerror (errno));
+			return FALSE;
+		}
+	}
+
+	while ((line = read_line (stream))) {
+		BatchJob *job;
+		GError   *error = NULL;
+
+		line_number++;
+		job = batch_job_parse (line, size, &error);
+		if (job) {
+			g_queue_push_tail (&batch_queue, job);
+		} else if (error) {
+			g_printerr ("%s:%u: %s\n",
+				    stream == stdin ? "<stdin>" : manifest,
+				    line_number, error->message);
+			g_error_free (error);
+		}
+		g_free (line);
+	}
+
+	if (stream != stdin)
+		fclose (stream);
+
+	return TRUE;
+}
+
+/* Returns the path of this program, for starting the workers: argv[0]
+ * may be a name looked up in a PATH where it isn't the same program */
+static gchar *
+get_worker_path (void)
+{
+	gchar *path;
+
+	path = g_file_read_link ("/proc/self/exe", NULL);
+	if (path)
+		return path;
+
+	return g_build_filename (BINDIR, "evince-thumbnailer", NULL);
+}
+
+static int
+evince_thumbnailer_batch (const gchar *manifest)
+{
+	BatchWorker *workers;
+	guint        n_jobs, n_workers, i;
+	gint64       start_time;
+
+	if (!batch_read_manifest (manifest))
+		return -1;
+
+	n_jobs = g_queue_get_length (&batch_queue);
+	if (n_jobs == 0)
+		return 0;
+
+	n_workers = batch_jobs > 0 ? batch_jobs : g_get_num_processors ();
+	n_workers = MIN (n_workers, n_jobs);
+	worker_path = get_worker_path ();
+
+	start_time = g_get_monotonic_time ();
+	batch_loop = g_main_loop_new (NULL, FALSE);
+	workers = g_new0 (BatchWorker, n_workers);
+
+	for (i = 0; i < n_workers; i++) {
+		if (!batch_worker_start (&workers[i]))
+			break;
+		n_batch_workers_running++;
+	}
+
+	if (n_batch_workers_running > 0) {
+		for (i = 0; i < n_batch_workers_running; i++)
+			batch_worker_next_job (&workers[i]);
+
+		g_main_loop_run (batch_loop);
+	}
+
+	for (i = 0; i < n_workers; i++)
+		batch_worker_stop (&workers[i]);
+	g_free (workers);
+	g_main_loop_unref (batch_loop);
+	g_clear_pointer (&worker_path, g_free);
+
+	g_queue_foreach (&batch_queue, (GFunc)batch_job_free, NULL);
+	g_queue_clear (&batch_queue);
+
+	g_printerr ("%u of %u thumbnails created, %u failed, in %.1f seconds\n",
+		    n_batch_done - n_batch_failed, n_jobs, n_batch_failed,
+		    (g_get_monotonic_time () - start_time) / (gdouble)G_USEC_PER_SEC);
+
+	return n_batch_done == n_jobs && n_batch_failed == 0 ? 0 : -2;
+}
+
 static void
 print_usage (GOptionContext *context)
 {
@@ -271,6 +859,22 @@ main (int argc, char *argv[])
 		return -1;
 	}
 
+	if (size < 1) {
+		g_printerr ("Size cannot be smaller than 1 pixel\n");
+		g_option_context_free (context);
+		return -1;
+	}
+
+	if (batch_worker) {
+		g_option_context_free (context);
+		return evince_thumbnailer_batch_worker ();
+	}
+
+	if (batch_manifest) {
+		g_option_context_free (context);
+		return evince_thumbnailer_batch (batch_manifest);
+	}
+
 	input = file_arguments ? file_arguments[0] : NULL;
 	output = input ? file_arguments[1] : NULL;
 	if (!input || !output) {
@@ -282,11 +886,6 @@ main (int argc, char *argv[])
 
 	g_option_context_free (context);
 
-	if (size < 1) {
-		g_printerr ("Size cannot be smaller than 1 pixel\n");
-		return -1;
-	}
-
 	input = file_arguments[0];
 	output = file_arguments[1];
 
@@ -294,10 +893,13 @@ main (int argc, char *argv[])
                 return -1;
 
 	file = g_file_new_for_commandline_arg (input);
-	document = evince_thumbnailer_get_document (file);
+	document = evince_thumbnailer_get_document (file, &error);
 	g_object_unref (file);
 
 	if (!document) {
+		if (!error_is_encrypted (error))
+			g_printerr ("%s\n", error->message);
+		g_error_free (error);
 		ev_shutdown ();
 		return -2;
 	}